@@ -0,0 +1,298 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 轻量级Actor
+*
+* 每个actor拥有一个状态对象和一个信箱，信箱是侵入式的多生产者单消费者(MPSC)无锁队列。
+* 信箱从空变为非空时，actor被调度到线程池上执行一次"激活"，
+* 每次激活最多连续处理_ctplActorBatch_条消息，以分摊调度开销。
+*
+* 主要功能和特点：
+* 1. 任意线程都可以调用send()向actor发送消息
+* 2. 同一个actor的消息按发送顺序逐条处理，处理函数之间不会重叠，状态无需加锁
+* 3. 空闲的actor只占用状态对象和几个指针的内存，不占用信箱缓冲区，也不占用线程池任务
+* 4. 适用于ctpl.h和ctpl_stl.h中的thread_pool，激活是嵌入在actor中的任务节点，通过Pool的post方法提交
+*
+* 线程安全考量：
+* - 信箱使用Vyukov的侵入式MPSC队列：入队只需一次原子交换，出队不需要CAS
+* - 使用原子计数器记录未处理的消息数，只有从0变为1的那次send()负责调度，
+*   因此同一时刻最多只有一次激活在线程池中，保证消息处理互不重叠；
+*   激活节点同一时刻最多在线程池队列中出现一次，侵入式队列（mpsc_queue）也可以使用
+* - 线程池stop(false)、clear_queue()或丢弃pop()的结果时，激活被丢弃：
+*   actor释放此时已发送的消息并扣除计数，之后的send()会重新调度
+* - 销毁actor之前必须确保信箱为空（idle()返回true），否则排队中的激活会访问已销毁的对象
+*
+* 性能考量：
+* - 每条消息只有一次节点分配，消息直接构造在节点中；激活节点是actor的成员，调度不分配内存
+* - 几百万个大部分时间空闲的actor不会给线程池带来任何负担
+*********************************************************/
+
+#ifndef __ctpl_actor_H__
+#define __ctpl_actor_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#include <atomic>      // 用于std::atomic原子操作，实现无锁信箱
+#include <thread>      // 用于std::this_thread::yield
+#include <utility>     // 用于std::move和std::forward
+
+#ifndef _ctplActorBatch_
+#define _ctplActorBatch_  32  // 每次激活最多连续处理的消息数
+#endif
+
+namespace ctpl {
+
+    namespace detail {
+        /**
+         * @brief 侵入式队列节点的链接部分
+         */
+        struct mailbox_link {
+            mailbox_link() : next(nullptr) {}
+
+            std::atomic<mailbox_link *> next;  // 下一个节点
+        };
+
+        /**
+         * @brief 信箱中的消息节点，消息直接存放在节点内部
+         */
+        template <typename Msg>
+        struct mailbox_node : mailbox_link {
+            template<typename... Args>
+            mailbox_node(Args&&... args) : msg(std::forward<Args>(args)...) {}
+
+            Msg msg;  // 消息内容
+        };
+    }
+
+    /**
+     * @brief 轻量级actor，按顺序处理发送给它的消息
+     *
+     * @tparam State 状态类型，需要可以调用 state(int id, Msg & msg)，
+     *               其中id是处理消息的工作线程索引；lambda也可以作为State
+     * @tparam Msg 消息类型
+     * @tparam Pool 线程池类型，默认为ctpl::thread_pool
+     *
+     * actor不可拷贝或移动，因为已调度的激活持有指向它的指针。
+     * 处理函数抛出的异常会被丢弃，不影响后续消息的处理。
+     */
+    template <typename State, typename Msg, typename Pool = thread_pool>
+    class actor {
+
+    public:
+
+        /**
+         * @brief 构造函数
+         *
+         * @param pool 执行消息处理的线程池，其生命周期必须长于actor
+         * @param state 初始状态
+         * @param batch 每次激活最多处理的消息数，默认为_ctplActorBatch_
+         */
+        actor(Pool & pool, State state = State(), int batch = _ctplActorBatch_)
+            : pool(pool), st(std::move(state)), batch(batch), node(*this), head(&stub), tail(&stub), nPending(0) {}
+
+        /**
+         * @brief 析构函数，释放信箱中残留的消息
+         *
+         * 调用者必须保证此时没有其他线程在send()，且没有激活在排队或执行
+         */
+        ~actor() {
+            while (detail::mailbox_node<Msg> * n = this->pop())
+                delete n;
+        }
+
+        /**
+         * @brief 发送消息（拷贝）
+         */
+        void send(const Msg & msg) { this->enqueue(new detail::mailbox_node<Msg>(msg)); }
+
+        /**
+         * @brief 发送消息（移动）
+         */
+        void send(Msg && msg) { this->enqueue(new detail::mailbox_node<Msg>(std::move(msg))); }
+
+        /**
+         * @brief 在信箱节点中直接构造消息并发送
+         */
+        template<typename... Args>
+        void emplace(Args&&... args) { this->enqueue(new detail::mailbox_node<Msg>(std::forward<Args>(args)...)); }
+
+        /**
+         * @brief 信箱是否为空且没有正在处理的消息
+         */
+        bool idle() const { return this->nPending.load(std::memory_order_acquire) == 0; }
+
+        /**
+         * @brief 获取尚未处理完的消息数量
+         */
+        int n_pending() const { return this->nPending.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief 获取状态对象
+         *
+         * 只应在actor空闲时，或在消息处理函数内部访问
+         */
+        State & state() { return this->st; }
+
+    private:
+
+        actor(const actor &);// = delete;
+        actor(actor &&);// = delete;
+        actor & operator=(const actor &);// = delete;
+        actor & operator=(actor &&);// = delete;
+
+        /**
+         * @brief 将节点链接到信箱尾部（任意线程）
+         *
+         * 只需一次原子交换；交换和链接之间的短暂窗口内，消费者会看到一个"尚未链接"的节点
+         */
+        void link(detail::mailbox_link * n) {
+            n->next.store(nullptr, std::memory_order_relaxed);
+            detail::mailbox_link * prev = this->tail.exchange(n, std::memory_order_acq_rel);
+            prev->next.store(n, std::memory_order_release);
+        }
+
+        /**
+         * @brief 入队消息，信箱从空变为非空时调度一次激活
+         *
+         * 先增加计数再链接节点，保证激活取出的消息数不会超过计数，
+         * 否则计数可能短暂变为负数，导致两次激活同时运行
+         */
+        void enqueue(detail::mailbox_node<Msg> * n) {
+            bool first = this->nPending.fetch_add(1, std::memory_order_acq_rel) == 0;
+            this->link(n);
+            if (first)
+                this->schedule();
+        }
+
+        /**
+         * @brief 从信箱头部取出一个节点（只在激活中调用，单消费者）
+         *
+         * @return 取出的节点，信箱为空或生产者尚未完成链接时返回nullptr
+         */
+        detail::mailbox_node<Msg> * pop() {
+            detail::mailbox_link * h = this->head;
+            detail::mailbox_link * next = h->next.load(std::memory_order_acquire);
+            if (h == &this->stub) {  // 跳过哨兵节点
+                if (!next)
+                    return nullptr;
+                this->head = next;
+                h = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next) {
+                this->head = next;
+                return static_cast<detail::mailbox_node<Msg> *>(h);
+            }
+            if (h != this->tail.load(std::memory_order_acquire))
+                return nullptr;  // 有生产者正在链接新节点，稍后再取
+            this->link(&this->stub);  // h是最后一个节点，重新放入哨兵以便把h取出
+            next = h->next.load(std::memory_order_acquire);
+            if (next) {
+                this->head = next;
+                return static_cast<detail::mailbox_node<Msg> *>(h);
+            }
+            return nullptr;
+        }
+
+        /**
+         * @brief 激活节点：执行时处理一批消息，被线程池丢弃时释放信箱中的消息
+         */
+        struct activation_node : detail::task_node {
+            explicit activation_node(actor & a) : a(a) {}
+            void run(int id) override { this->a.run(id); }
+            void discard() override { this->a.drop(); }
+
+            actor & a;
+        };
+
+        /**
+         * @brief 向线程池提交一次激活
+         */
+        void schedule() {
+            this->pool.post(&this->node);
+        }
+
+        /**
+         * @brief 激活结束时的计数器更新，析构时执行以保证处理函数抛出异常时也能正确调度
+         */
+        struct activation {
+            activation(actor & a) : a(a), n(0) {}
+            ~activation() {
+                // 扣除本次处理的消息数；如果仍有未处理的消息，由本次激活负责重新调度
+                if (this->a.nPending.fetch_sub(this->n, std::memory_order_acq_rel) != this->n)
+                    this->a.schedule();
+            }
+
+            actor & a;
+            int n;  // 本次激活已取出的消息数
+        };
+
+        /**
+         * @brief 一次激活：在工作线程上最多处理batch条消息
+         */
+        void run(int id) {
+            activation act(*this);
+            while (act.n < this->batch) {
+                detail::mailbox_node<Msg> * n = this->pop();
+                if (!n)
+                    break;
+                ++act.n;
+                struct guard {
+                    ~guard() { delete n; }
+                    detail::mailbox_node<Msg> * n;
+                } g = { n };  // 保证处理函数抛出异常时节点也会被释放
+                this->st(id, n->msg);
+            }
+        }
+
+        /**
+         * @brief 激活被线程池丢弃：释放此时已发送的消息
+         *
+         * 与run()一样是唯一的消费者。计数在链接节点之前增加，
+         * 所以已计数的节点可能还没有链接好，取不到时等待生产者完成链接
+         */
+        void drop() {
+            int n = this->nPending.load(std::memory_order_acquire);
+            for (int k = 0; k < n; ++k) {
+                detail::mailbox_node<Msg> * m;
+                while (!(m = this->pop()))
+                    std::this_thread::yield();
+                delete m;
+            }
+            // 丢弃期间又有消息发送时，与激活结束时一样由这里重新调度
+            if (this->nPending.fetch_sub(n, std::memory_order_acq_rel) != n)
+                this->schedule();
+        }
+
+        Pool & pool;  // 执行激活的线程池
+        State st;  // actor状态，只在激活中访问
+        int batch;  // 每次激活最多处理的消息数
+        activation_node node;  // 激活节点，同一时刻最多在线程池队列中出现一次
+
+        detail::mailbox_link stub;  // 哨兵节点，保证队列中始终至少有一个节点
+        detail::mailbox_link * head;  // 消费者端，只在激活中访问
+        std::atomic<detail::mailbox_link *> tail;  // 生产者端，send()通过原子交换更新
+        std::atomic<int> nPending;  // 已发送但尚未处理完的消息数
+    };
+
+}
+
+#endif // __ctpl_actor_H__
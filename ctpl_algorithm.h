@@ -0,0 +1,545 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 基于线程池的并行算法
+*
+* 在已有的thread_pool上执行的数据并行算法，不创建额外的线程。
+*
+* 主要功能和特点：
+* 1. parallel_sort(pool, first, last, comp)：
+*    - 一般比较函数：先把区间切成块并行排序，再逐轮两两归并；
+*      每次归并按"归并路径"切成多段并行执行，最后几轮也能用满所有线程
+*    - 整数键（不带比较函数或比较函数为std::less）：LSD基数排序，
+*      每轮按8位分桶，每个块独立统计直方图，再按块的偏移并行分散
+* 2. parallel_inclusive_scan / parallel_exclusive_scan：两遍分块的前缀扫描
+*    - 第一遍各块并行归约，串行扫描各块的归约值得到每块的进位，第二遍各块带进位并行扫描
+*    - 块的大小按L2缓存选取，且只取决于元素数和元素大小，与线程数无关，
+*      因此对满足结合律但不满足交换律的运算，结果也是确定的
+* 3. 区间较小或线程池只有一个线程时退化为串行算法
+*
+* 线程安全考量：
+* - 调用线程阻塞等待所有块完成，因此不能在同一线程池的工作线程中调用，
+*   否则可能因为占用了工作线程而死锁
+* - 块任务中抛出的异常（例如比较函数抛出）会在调用线程重新抛出
+*
+* 性能考量：
+* - 需要一个与输入等长的临时缓冲区，元素类型需要可默认构造和移动赋值
+* - 块数约为线程数的几倍，使各线程负载均衡
+*********************************************************/
+
+#ifndef __ctpl_algorithm_H__
+#define __ctpl_algorithm_H__
+
+#include <algorithm>   // 用于std::sort、std::merge等串行算法
+#include <exception>   // 用于单线程时保存块的异常
+#include <functional>  // 用于std::less
+#include <future>      // 用于等待块任务完成
+#include <iterator>    // 用于std::iterator_traits
+#include <type_traits> // 用于判断整数类型
+#include <utility>     // 用于std::declval
+#include <vector>      // 用于临时缓冲区和直方图
+
+#ifndef _ctplParallelGrain_
+#define _ctplParallelGrain_  (1 << 14)  // 小于此元素数的区间直接串行处理
+#endif
+
+#ifndef _ctplScanBlockBytes_
+#define _ctplScanBlockBytes_  (256 * 1024)  // 扫描时每块的字节数，输入和输出块应能同时放入L2缓存
+#endif
+
+namespace ctpl {
+
+    namespace detail {
+        /**
+         * @brief 执行第b块的任务
+         */
+        template <typename F>
+        struct block_task {
+            void operator()(int) const { (*this->f)(this->b); }
+
+            const F * f;
+            int b;  // 块的序号
+        };
+
+        /**
+         * @brief 在线程池上并行执行f(0) ... f(nBlocks - 1)，并等待全部完成
+         *
+         * 任一块抛出的异常会在所有块结束后重新抛出。
+         * 线程池最多只有一个线程时，在调用者线程上按顺序执行各块：块的划分不变，
+         * 因此结果（例如浮点扫描的舍入）与多线程时相同，又省去了提交和等待
+         */
+        template <typename Pool, typename F>
+        void parallel_blocks(Pool & pool, int nBlocks, const F & f) {
+            if (pool.size() <= 1) {
+                std::exception_ptr error;
+                for (int b = 0; b < nBlocks; ++b) {
+                    try {
+                        f(b);
+                    }
+                    catch (...) {
+                        if (!error)
+                            error = std::current_exception();  // 与多线程时一样，保留第一个块的异常
+                    }
+                }
+                if (error)
+                    std::rethrow_exception(error);
+                return;
+            }
+            // 直接保存push()返回的future类型，不转换为std::future
+            std::vector<decltype(pool.push(std::declval<block_task<F>>()))> futures;
+            futures.reserve(nBlocks);
+            for (int b = 0; b < nBlocks; ++b) {
+                block_task<F> t = { &f, b };
+                futures.push_back(pool.push(t));
+            }
+            for (std::size_t b = 0; b < futures.size(); ++b)
+                futures[b].wait();  // 先等待全部完成，避免异常时仍有块在访问调用者的数据
+            for (std::size_t b = 0; b < futures.size(); ++b)
+                futures[b].get();
+        }
+
+        /**
+         * @brief 第b块的起点：把n个元素均匀分成nBlocks块
+         */
+        inline std::size_t block_begin(std::size_t n, int nBlocks, int b) {
+            return static_cast<std::size_t>(static_cast<unsigned long long>(n) * b / nBlocks);
+        }
+
+        /**
+         * @brief 根据区间大小和线程数确定块数
+         */
+        template <typename Pool>
+        int block_count(Pool & pool, std::size_t n, int perThread) {
+            std::size_t maxBlocks = n / (_ctplParallelGrain_ / 4) + 1;  // 每块至少有一定的元素
+            std::size_t blocks = static_cast<std::size_t>(pool.size()) * perThread;
+            return static_cast<int>(std::max<std::size_t>(1, std::min(blocks, maxBlocks)));
+        }
+
+        /**
+         * @brief 归并路径切分：求输出的前d个元素中有多少来自a
+         *
+         * 与std::merge一致，相等元素中a的元素排在前面，因此归并是稳定的
+         */
+        template <typename It, typename Compare>
+        std::size_t merge_path(It a, std::size_t m, It b, std::size_t n, std::size_t d, Compare & comp) {
+            std::size_t lo = d > n ? d - n : 0;
+            std::size_t hi = std::min(d, m);
+            while (lo < hi) {
+                std::size_t i = lo + (hi - lo) / 2;
+                std::size_t j = d - i;
+                if (j > 0 && !comp(b[j - 1], a[i]))  // a[i]应排在b[j - 1]之前，需要从a取更多
+                    lo = i + 1;
+                else
+                    hi = i;
+            }
+            return lo;
+        }
+
+        /**
+         * @brief 一轮并行归并：把src中相邻的两个有序段归并到dst的相同位置
+         *
+         * @param runs 有序段的边界，第r对有序段为[runs[r], runs[r + 1])和[runs[r + 1], runs[r + 2])
+         *
+         * 输出区间被均匀切成nSegments段，每段是一个任务；
+         * 一段可能跨越多对有序段，对每对相交的部分用归并路径求出输入范围后独立归并。
+         * 各段的切分点在启动任务之前求出：归并会把元素从src中移走，
+         * 如果在任务中二分查找，可能读到相邻段已经移走的元素
+         */
+        template <typename Pool, typename SrcIt, typename DstIt, typename Compare>
+        void merge_round(Pool & pool, SrcIt src, DstIt dst, std::size_t n, const std::vector<std::size_t> & runs,
+                         int nSegments, Compare & comp) {
+            // split[s]：第s段的起点在它所在的那对有序段中，输出的前d个元素有多少来自前一段
+            std::vector<std::size_t> split(nSegments + 1, 0);
+            for (int s = 1; s < nSegments; ++s) {
+                std::size_t pos = block_begin(n, nSegments, s);
+                for (std::size_t r = 0; r + 1 < runs.size(); r += 2) {
+                    std::size_t pairBegin = runs[r];
+                    std::size_t mid = runs[r + 1];
+                    std::size_t pairEnd = r + 2 < runs.size() ? runs[r + 2] : mid;  // 落单的最后一段只需复制
+                    if (pos > pairBegin && pos < pairEnd) {
+                        split[s] = merge_path(src + pairBegin, mid - pairBegin, src + mid, pairEnd - mid, pos - pairBegin, comp);
+                        break;
+                    }
+                }
+            }
+
+            detail::parallel_blocks(pool, nSegments, [&](int seg) {
+                std::size_t lo = block_begin(n, nSegments, seg);
+                std::size_t hi = block_begin(n, nSegments, seg + 1);
+                for (std::size_t r = 0; r + 1 < runs.size(); r += 2) {
+                    std::size_t pairBegin = runs[r];
+                    std::size_t mid = runs[r + 1];
+                    std::size_t pairEnd = r + 2 < runs.size() ? runs[r + 2] : mid;
+                    if (pairEnd <= lo || pairBegin >= hi)
+                        continue;
+                    std::size_t d0 = std::max(lo, pairBegin) - pairBegin;  // 本段在这对有序段输出中的范围
+                    std::size_t d1 = std::min(hi, pairEnd) - pairBegin;
+                    std::size_t i0 = lo > pairBegin ? split[seg] : 0;  // 段的起点落在这对有序段内部时使用预先求出的切分点
+                    std::size_t i1 = hi < pairEnd ? split[seg + 1] : mid - pairBegin;
+                    std::merge(std::make_move_iterator(src + (pairBegin + i0)), std::make_move_iterator(src + (pairBegin + i1)),
+                               std::make_move_iterator(src + (mid + d0 - i0)), std::make_move_iterator(src + (mid + d1 - i1)),
+                               dst + (pairBegin + d0), comp);
+                }
+            });
+        }
+
+        /**
+         * @brief 并行把[src, src + n)移动到dst
+         */
+        template <typename Pool, typename SrcIt, typename DstIt>
+        void parallel_move(Pool & pool, SrcIt src, DstIt dst, std::size_t n, int nBlocks) {
+            detail::parallel_blocks(pool, nBlocks, [&](int b) {
+                std::move(src + block_begin(n, nBlocks, b), src + block_begin(n, nBlocks, b + 1), dst + block_begin(n, nBlocks, b));
+            });
+        }
+
+        /**
+         * @brief 并行归并排序
+         */
+        template <typename Pool, typename RandomIt, typename Compare>
+        void parallel_merge_sort(Pool & pool, RandomIt first, RandomIt last, Compare & comp) {
+            typedef typename std::iterator_traits<RandomIt>::value_type T;
+            const std::size_t n = static_cast<std::size_t>(last - first);
+            const int nBlocks = block_count(pool, n, 4);
+
+            // 1. 各块并行排序
+            detail::parallel_blocks(pool, nBlocks, [&](int b) {
+                std::sort(first + block_begin(n, nBlocks, b), first + block_begin(n, nBlocks, b + 1), comp);
+            });
+
+            // 2. 逐轮两两归并，数据在原区间和缓冲区之间交替
+            std::vector<T> buf(n);
+            std::vector<std::size_t> runs(nBlocks + 1);  // 当前各有序段的边界
+            for (int b = 0; b <= nBlocks; ++b)
+                runs[b] = block_begin(n, nBlocks, b);
+
+            const int nSegments = std::max(1, pool.size()) * 4;  // 每轮切成的归并段数
+            bool inBuf = false;  // 当前数据是否在缓冲区中
+            while (runs.size() > 2) {
+                if (inBuf)
+                    merge_round(pool, buf.begin(), first, n, runs, nSegments, comp);
+                else
+                    merge_round(pool, first, buf.begin(), n, runs, nSegments, comp);
+                inBuf = !inBuf;
+
+                std::vector<std::size_t> next;  // 归并后有序段的边界
+                for (std::size_t r = 0; r < runs.size(); r += 2)
+                    next.push_back(runs[r]);
+                if (next.back() != n)
+                    next.push_back(n);
+                runs.swap(next);
+            }
+
+            // 3. 如果结果在缓冲区中，并行移回原区间
+            if (inBuf)
+                parallel_move(pool, buf.begin(), first, n, nBlocks);
+        }
+
+        /**
+         * @brief 把整数键映射为无符号数，使无符号比较的顺序与原类型一致
+         */
+        template <typename T>
+        typename std::make_unsigned<T>::type radix_key(T v) {
+            typedef typename std::make_unsigned<T>::type U;
+            U u = static_cast<U>(v);
+            if (std::is_signed<T>::value)
+                u ^= static_cast<U>(U(1) << (sizeof(U) * 8 - 1));  // 翻转符号位，负数排在前面
+            return u;
+        }
+
+        /**
+         * @brief 基数排序的一轮：按第shift位开始的8位数字把src稳定地分散到dst
+         *
+         * @param hist 每块的直方图，块b占[b * 256, (b + 1) * 256)
+         * @return 如果所有元素的该数字都相同则返回false，此时不移动任何元素
+         */
+        template <typename Pool, typename SrcIt, typename DstIt>
+        bool radix_pass(Pool & pool, SrcIt src, DstIt dst, std::size_t n, int nBlocks,
+                        std::vector<std::size_t> & hist, unsigned shift) {
+            const int kBuckets = 256;
+
+            // 1. 各块并行统计直方图
+            detail::parallel_blocks(pool, nBlocks, [&](int b) {
+                std::size_t * h = &hist[static_cast<std::size_t>(b) * kBuckets];
+                std::fill(h, h + kBuckets, std::size_t(0));
+                for (std::size_t i = block_begin(n, nBlocks, b), e = block_begin(n, nBlocks, b + 1); i < e; ++i)
+                    ++h[(radix_key(src[i]) >> shift) & 0xff];
+            });
+
+            // 2. 串行计算每块每个数字的起始偏移：先按数字，再按块，保证稳定
+            std::size_t offset = 0;
+            for (int d = 0; d < kBuckets; ++d) {
+                std::size_t total = 0;
+                for (int b = 0; b < nBlocks; ++b)
+                    total += hist[static_cast<std::size_t>(b) * kBuckets + d];
+                if (total == n)
+                    return false;  // 所有元素在本轮的数字都相同
+                for (int b = 0; b < nBlocks; ++b) {
+                    std::size_t & c = hist[static_cast<std::size_t>(b) * kBuckets + d];
+                    std::size_t t = c;
+                    c = offset;
+                    offset += t;
+                }
+            }
+
+            // 3. 各块并行把元素分散到目标位置
+            detail::parallel_blocks(pool, nBlocks, [&](int b) {
+                std::size_t * h = &hist[static_cast<std::size_t>(b) * kBuckets];
+                for (std::size_t i = block_begin(n, nBlocks, b), e = block_begin(n, nBlocks, b + 1); i < e; ++i)
+                    dst[h[(radix_key(src[i]) >> shift) & 0xff]++] = std::move(src[i]);
+            });
+            return true;
+        }
+
+        /**
+         * @brief 并行LSD基数排序，每轮处理8位，跳过所有元素数字都相同的轮次
+         */
+        template <typename Pool, typename RandomIt>
+        void parallel_radix_sort(Pool & pool, RandomIt first, RandomIt last) {
+            typedef typename std::iterator_traits<RandomIt>::value_type T;
+            const std::size_t n = static_cast<std::size_t>(last - first);
+            const int nBlocks = block_count(pool, n, 1);  // 每块一个直方图，块数与线程数相当即可
+
+            std::vector<T> buf(n);
+            std::vector<std::size_t> hist(static_cast<std::size_t>(nBlocks) * 256);
+            bool inBuf = false;  // 当前数据是否在缓冲区中
+            for (unsigned shift = 0; shift < sizeof(T) * 8; shift += 8) {
+                bool moved = inBuf ? radix_pass(pool, buf.begin(), first, n, nBlocks, hist, shift)
+                                   : radix_pass(pool, first, buf.begin(), n, nBlocks, hist, shift);
+                if (moved)
+                    inBuf = !inBuf;
+            }
+
+            if (inBuf)
+                parallel_move(pool, buf.begin(), first, n, nBlocks);
+        }
+
+        /**
+         * @brief 按顺序归约[first, first + n)，n > 0
+         *
+         * 把区间分成4个连续的子区间分别归约，再按顺序合并：
+         * 4条独立的依赖链便于编译器流水和向量化，而且只要求运算满足结合律
+         */
+        template <typename InputIt, typename T, typename BinaryOp>
+        T scan_block_reduce(InputIt first, std::size_t n, BinaryOp & op) {
+            if (n < 64) {
+                T acc = first[0];
+                for (std::size_t i = 1; i < n; ++i)
+                    acc = op(acc, first[i]);
+                return acc;
+            }
+            const std::size_t q = n / 4;
+            T a0 = first[0], a1 = first[q], a2 = first[2 * q], a3 = first[3 * q];
+            for (std::size_t i = 1; i < q; ++i) {
+                a0 = op(a0, first[i]);
+                a1 = op(a1, first[q + i]);
+                a2 = op(a2, first[2 * q + i]);
+                a3 = op(a3, first[3 * q + i]);
+            }
+            for (std::size_t i = 4 * q; i < n; ++i)  // 余下的元素属于最后一个子区间
+                a3 = op(a3, first[i]);
+            return op(op(a0, a1), op(a2, a3));
+        }
+
+        /**
+         * @brief 分块扫描的块数：每块约_ctplScanBlockBytes_字节，与线程数无关以保证结果确定
+         */
+        template <typename T>
+        int scan_block_count(std::size_t n) {
+            std::size_t perBlock = std::max<std::size_t>(1024, _ctplScanBlockBytes_ / sizeof(T));
+            return static_cast<int>((n + perBlock - 1) / perBlock);
+        }
+
+        /**
+         * @brief 两遍分块扫描
+         *
+         * @param hasInit 是否有初始值：exclusive扫描总是有，inclusive扫描可选
+         * @param inclusive 输出是否包含当前元素
+         */
+        template <typename T, typename Pool, typename InputIt, typename OutputIt, typename BinaryOp>
+        OutputIt blocked_scan(Pool & pool, InputIt first, std::size_t n, OutputIt d_first,
+                              BinaryOp & op, const T * init, bool inclusive) {
+            const int nBlocks = scan_block_count<T>(n);
+
+            // 1. 各块并行归约
+            std::vector<T> carry;
+            carry.reserve(nBlocks);
+            {
+                std::vector<T> sums(nBlocks, first[0]);  // 先用任意元素占位，T不需要可默认构造
+                detail::parallel_blocks(pool, nBlocks, [&](int b) {
+                    std::size_t begin = block_begin(n, nBlocks, b);
+                    sums[b] = scan_block_reduce<InputIt, T>(first + begin, block_begin(n, nBlocks, b + 1) - begin, op);
+                });
+
+                // 2. 串行扫描各块的归约值，得到每块的进位（块0的进位是初始值，可能不存在）
+                if (init)
+                    carry.push_back(*init);
+                for (int b = 0; b + 1 < nBlocks; ++b)
+                    carry.push_back(carry.empty() ? sums[b] : op(carry.back(), sums[b]));
+            }
+
+            // 3. 各块带进位并行扫描，进位总是放在运算的左边
+            const bool block0HasCarry = init != nullptr;
+            detail::parallel_blocks(pool, nBlocks, [&](int b) {
+                std::size_t i = block_begin(n, nBlocks, b);
+                const std::size_t end = block_begin(n, nBlocks, b + 1);
+                const bool hasCarry = b > 0 || block0HasCarry;
+                const std::size_t c = block0HasCarry ? b : b - 1;  // 本块进位在carry中的位置
+                if (inclusive) {
+                    T acc = hasCarry ? op(carry[c], first[i]) : T(first[i]);
+                    d_first[i] = acc;
+                    for (++i; i < end; ++i) {
+                        acc = op(acc, first[i]);
+                        d_first[i] = acc;
+                    }
+                }
+                else {
+                    T acc = carry[c];  // exclusive扫描总有初始值
+                    for (; i < end; ++i) {
+                        T x = first[i];  // 先读后写，支持原地扫描
+                        d_first[i] = acc;
+                        acc = op(acc, x);
+                    }
+                }
+            });
+            return d_first + n;
+        }
+
+        /**
+         * @brief 整数键且按升序排序：使用基数排序
+         */
+        template <typename Pool, typename RandomIt, typename Compare>
+        void parallel_sort_dispatch(Pool & pool, RandomIt first, RandomIt last, Compare &, std::true_type) {
+            detail::parallel_radix_sort(pool, first, last);
+        }
+
+        /**
+         * @brief 一般比较函数：使用归并排序
+         */
+        template <typename Pool, typename RandomIt, typename Compare>
+        void parallel_sort_dispatch(Pool & pool, RandomIt first, RandomIt last, Compare & comp, std::false_type) {
+            detail::parallel_merge_sort(pool, first, last, comp);
+        }
+    }
+
+    /**
+     * @brief 在线程池上并行排序[first, last)
+     *
+     * @param pool 执行排序的线程池
+     * @param first, last 随机访问迭代器区间
+     * @param comp 比较函数，要求与std::sort相同；可能在多个线程上并发调用
+     *
+     * 比较函数为std::less且元素为整数类型时使用基数排序，否则使用并行归并排序。
+     * 与std::sort一样不保证稳定性
+     */
+    template <typename Pool, typename RandomIt, typename Compare>
+    void parallel_sort(Pool & pool, RandomIt first, RandomIt last, Compare comp) {
+        typedef typename std::iterator_traits<RandomIt>::value_type T;
+        const std::size_t n = static_cast<std::size_t>(last - first);
+        if (n < _ctplParallelGrain_) {
+            std::sort(first, last, comp);
+            return;
+        }
+        typedef std::integral_constant<bool, std::is_integral<T>::value && !std::is_same<T, bool>::value
+                                             && std::is_same<Compare, std::less<T>>::value> use_radix;
+        detail::parallel_sort_dispatch(pool, first, last, comp, use_radix());
+    }
+
+    /**
+     * @brief 在线程池上按升序并行排序[first, last)
+     */
+    template <typename Pool, typename RandomIt>
+    void parallel_sort(Pool & pool, RandomIt first, RandomIt last) {
+        ctpl::parallel_sort(pool, first, last, std::less<typename std::iterator_traits<RandomIt>::value_type>());
+    }
+
+    /**
+     * @brief 在线程池上并行计算包含当前元素的前缀扫描
+     *
+     * @param pool 执行扫描的线程池
+     * @param first, last 输入区间，随机访问迭代器
+     * @param d_first 输出区间的起点，可以与first相同（原地扫描）
+     * @param op 满足结合律的二元运算，不要求交换律；可能在多个线程上并发调用
+     * @return OutputIt 输出区间的终点
+     *
+     * 与std::inclusive_scan语义相同；结果与线程数无关，对浮点加法也是确定的
+     */
+    template <typename Pool, typename InputIt, typename OutputIt, typename BinaryOp>
+    OutputIt parallel_inclusive_scan(Pool & pool, InputIt first, InputIt last, OutputIt d_first, BinaryOp op) {
+        typedef typename std::iterator_traits<InputIt>::value_type T;
+        const std::size_t n = static_cast<std::size_t>(last - first);
+        if (n == 0)
+            return d_first;
+        if (n < _ctplParallelGrain_) {
+            T acc = first[0];
+            d_first[0] = acc;
+            for (std::size_t i = 1; i < n; ++i) {
+                acc = op(acc, first[i]);
+                d_first[i] = acc;
+            }
+            return d_first + n;
+        }
+        return detail::blocked_scan<T>(pool, first, n, d_first, op, static_cast<const T *>(nullptr), true);
+    }
+
+    /**
+     * @brief 在线程池上并行计算包含当前元素的前缀和
+     */
+    template <typename Pool, typename InputIt, typename OutputIt>
+    OutputIt parallel_inclusive_scan(Pool & pool, InputIt first, InputIt last, OutputIt d_first) {
+        return ctpl::parallel_inclusive_scan(pool, first, last, d_first, std::plus<typename std::iterator_traits<InputIt>::value_type>());
+    }
+
+    /**
+     * @brief 在线程池上并行计算不包含当前元素的前缀扫描
+     *
+     * @param init 初始值，d_first[0] == init
+     * @param op 满足结合律的二元运算，不要求交换律
+     * @return OutputIt 输出区间的终点
+     *
+     * 与std::exclusive_scan语义相同，常用于由各记录长度计算偏移
+     */
+    template <typename Pool, typename InputIt, typename OutputIt, typename T, typename BinaryOp>
+    OutputIt parallel_exclusive_scan(Pool & pool, InputIt first, InputIt last, OutputIt d_first, T init, BinaryOp op) {
+        const std::size_t n = static_cast<std::size_t>(last - first);
+        if (n == 0)
+            return d_first;
+        if (n < _ctplParallelGrain_) {
+            T acc = init;
+            for (std::size_t i = 0; i < n; ++i) {
+                T x = first[i];
+                d_first[i] = acc;
+                acc = op(acc, x);
+            }
+            return d_first + n;
+        }
+        return detail::blocked_scan<T>(pool, first, n, d_first, op, &init, false);
+    }
+
+    /**
+     * @brief 在线程池上并行计算不包含当前元素的前缀和
+     */
+    template <typename Pool, typename InputIt, typename OutputIt, typename T>
+    OutputIt parallel_exclusive_scan(Pool & pool, InputIt first, InputIt last, OutputIt d_first, T init) {
+        return ctpl::parallel_exclusive_scan(pool, first, last, d_first, init, std::plus<T>());
+    }
+
+}
+
+#endif // __ctpl_algorithm_H__
@@ -0,0 +1,306 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 每线程缓存的小块内存分配器
+*
+* 线程池每次push()都要分配任务节点（其中包含结果的共享状态），
+* 这些小块内存如果都经过全局malloc，多个生产者之间会产生竞争。
+* 此分配器为每个线程维护按大小分级的空闲链表，小块内存从线程自己的slab中切出，
+* 释放后回到分配它的线程的缓存中重复使用。
+*
+* 主要功能和特点：
+* 1. caching_allocator<T>：标准分配器接口，可用于std::allocate_shared、容器和ctpl::task的协程帧
+* 2. 不超过_ctplMaxCachedSize_字节的请求按alignof(std::max_align_t)字节（x86-64上为16）分级缓存，
+*    更大的请求直接使用operator new
+* 3. 线程池的push()用它分配任务节点，工作线程执行完任务后把节点释放回来
+*
+* 线程安全考量：
+* - 在分配它的线程上释放：直接放回该线程的本地空闲链表，没有任何原子操作
+* - 在其他线程上释放（例如工作线程释放生产者分配的任务节点）：
+*   通过一次CAS压入所属缓存的远程链表，这是一个多生产者单消费者(MPSC)链表，
+*   所属线程本地链表为空时用一次原子交换取走整个远程链表，因此不存在ABA问题
+* - 线程退出时它的缓存不会被释放，而是放入全局的孤儿链表，供之后创建的线程接管，
+*   因此块可以比分配它的线程活得更久，线程池反复resize()也不会使内存持续增长
+*
+* 性能考量：
+* - 稳定运行时，任务节点和结果不再调用malloc；队列策略自己的分配除外
+*   （mutex_queue的std::deque约每64个任务分配一块），tests/bench_alloc.cpp统计分配次数
+* - slab内存只会在缓存之间转手，不会归还给系统
+*********************************************************/
+
+#ifndef __ctpl_alloc_H__
+#define __ctpl_alloc_H__
+
+#include <atomic>      // 用于远程释放链表
+#include <cstddef>     // 用于std::size_t和std::max_align_t
+#include <limits>      // 用于std::numeric_limits
+#include <mutex>       // 用于保护孤儿缓存链表
+#include <new>         // 用于operator new和std::bad_alloc
+
+#ifndef _ctplCacheLineSize_
+#define _ctplCacheLineSize_  64  // 缓存行大小，用于隔离被不同线程频繁写入的字段
+#endif
+
+#ifndef _ctplSlabSize_
+#define _ctplSlabSize_  (64 * 1024)  // 每次向系统申请的slab大小
+#endif
+
+#ifndef _ctplMaxCachedSize_
+#define _ctplMaxCachedSize_  256  // 缓存的最大块大小（字节），更大的请求直接使用operator new
+#endif
+
+namespace ctpl {
+
+    namespace detail {
+
+        class thread_cache;
+
+        /**
+         * @brief 每个块前面的头部，记录块所属的缓存和大小级别
+         *
+         * 大小是max_align_t对齐值的整数倍（x86-64上为32字节），保证返回给用户的地址满足基本对齐；
+         * 直接使用operator new分配的大块，owner为nullptr
+         */
+        union block_header {
+            struct {
+                thread_cache * owner;  // 块所属的缓存，块的一生中不变
+                std::size_t cls;  // 大小级别
+            } h;
+            std::max_align_t align;
+        };
+
+        /**
+         * @brief 空闲块中的链接，存放在块的用户区域
+         */
+        struct free_block {
+            free_block * next;
+        };
+
+        const std::size_t cache_granule = alignof(std::max_align_t);  // 大小级别的粒度，与头部大小无关
+        const std::size_t cache_classes = (_ctplMaxCachedSize_ + cache_granule - 1) / cache_granule;  // 大小级别数
+
+        /**
+         * @brief 一个线程的缓存：本地空闲链表、远程释放链表和当前slab
+         */
+        class thread_cache {
+        public:
+            thread_cache() : nextOrphan(nullptr), slab(nullptr), slabLeft(0), slabs(nullptr) {
+                for (std::size_t i = 0; i < cache_classes; ++i) {
+                    this->local[i] = nullptr;
+                    this->remote[i].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+
+            /**
+             * @brief 分配一个cls级别的块，只由所属线程调用
+             */
+            void * allocate(std::size_t cls) {
+                free_block * b = this->local[cls];
+                if (!b) {
+                    b = this->remote[cls].exchange(nullptr, std::memory_order_acquire);  // 取走其他线程释放的块
+                    if (!b)
+                        return this->carve(cls);
+                }
+                this->local[cls] = b->next;
+                return b;
+            }
+
+            /**
+             * @brief 所属线程释放块
+             */
+            void free_local(std::size_t cls, void * p) {
+                free_block * b = static_cast<free_block *>(p);
+                b->next = this->local[cls];
+                this->local[cls] = b;
+            }
+
+            /**
+             * @brief 其他线程释放块，压入远程链表
+             */
+            void free_remote(std::size_t cls, void * p) {
+                free_block * b = static_cast<free_block *>(p);
+                free_block * head = this->remote[cls].load(std::memory_order_relaxed);
+                do {
+                    b->next = head;
+                } while (!this->remote[cls].compare_exchange_weak(head, b, std::memory_order_release, std::memory_order_relaxed));
+            }
+
+            thread_cache * nextOrphan;  // 孤儿链表中的下一个缓存
+
+        private:
+            /**
+             * @brief 从当前slab切出一个新块，slab不足时申请新的slab
+             */
+            void * carve(std::size_t cls) {
+                const std::size_t size = sizeof(block_header) + (cls + 1) * cache_granule;
+                if (this->slabLeft < size) {
+                    // slab开头的一个头部用来把所有slab串起来，剩余部分用于切块
+                    block_header * s = static_cast<block_header *>(::operator new(_ctplSlabSize_));
+                    s->h.owner = reinterpret_cast<thread_cache *>(this->slabs);
+                    this->slabs = s;
+                    this->slab = reinterpret_cast<char *>(s + 1);
+                    this->slabLeft = _ctplSlabSize_ - sizeof(block_header);
+                }
+                block_header * hdr = reinterpret_cast<block_header *>(this->slab);
+                hdr->h.owner = this;
+                hdr->h.cls = cls;
+                this->slab += size;
+                this->slabLeft -= size;
+                return hdr + 1;
+            }
+
+            free_block * local[cache_classes];  // 本地空闲链表，只由所属线程访问
+            char * slab;  // 当前slab中尚未切出的部分
+            std::size_t slabLeft;  // 当前slab剩余的字节数
+            block_header * slabs;  // 所有slab组成的链表，保持slab可达
+            char pad[_ctplCacheLineSize_];  // 隔开其他线程频繁写入的远程链表
+            std::atomic<free_block *> remote[cache_classes];  // 远程释放链表，多生产者单消费者
+        };
+
+        /**
+         * @brief 孤儿缓存链表：所属线程已退出的缓存，等待新线程接管
+         *
+         * 在堆上创建且永不销毁，因此进程退出时仍在运行的分离线程也能安全访问
+         */
+        struct cache_registry {
+            cache_registry() : orphans(nullptr) {}
+
+            std::mutex mutex;  // 保护orphans
+            thread_cache * orphans;  // 孤儿缓存链表
+        };
+
+        inline cache_registry & registry() {
+            static cache_registry * r = new cache_registry();
+            return *r;
+        }
+
+        /**
+         * @brief 当前线程的缓存指针，线程尚未分配过或已经退出时为nullptr
+         */
+        inline thread_cache *& tls_cache() {
+            static thread_local thread_cache * c = nullptr;
+            return c;
+        }
+
+        /**
+         * @brief 线程退出时把缓存放入孤儿链表
+         */
+        struct cache_holder {
+            ~cache_holder() {
+                thread_cache *& c = tls_cache();
+                if (!c)
+                    return;
+                cache_registry & r = registry();
+                std::unique_lock<std::mutex> lock(r.mutex);
+                c->nextOrphan = r.orphans;
+                r.orphans = c;
+                c = nullptr;
+            }
+        };
+
+        /**
+         * @brief 获取当前线程的缓存，第一次调用时接管一个孤儿缓存或创建新缓存
+         */
+        inline thread_cache * current_cache() {
+            thread_cache *& c = tls_cache();
+            if (!c) {
+                static thread_local cache_holder holder;  // 注册线程退出时的清理
+                (void)holder;
+                cache_registry & r = registry();
+                {
+                    std::unique_lock<std::mutex> lock(r.mutex);
+                    c = r.orphans;
+                    if (c)
+                        r.orphans = c->nextOrphan;
+                }
+                if (!c)
+                    c = new thread_cache();
+            }
+            return c;
+        }
+
+        /**
+         * @brief 分配n字节，按max_align_t对齐
+         */
+        inline void * cache_allocate(std::size_t n) {
+            if (n > _ctplMaxCachedSize_) {
+                if (n > std::numeric_limits<std::size_t>::max() - sizeof(block_header))
+                    throw std::bad_alloc();
+                block_header * hdr = static_cast<block_header *>(::operator new(sizeof(block_header) + n));
+                hdr->h.owner = nullptr;
+                return hdr + 1;
+            }
+            return current_cache()->allocate(n ? (n - 1) / cache_granule : 0);
+        }
+
+        /**
+         * @brief 释放cache_allocate()分配的内存，可以在任意线程调用
+         */
+        inline void cache_deallocate(void * p) noexcept {
+            if (!p)
+                return;
+            block_header * hdr = static_cast<block_header *>(p) - 1;
+            thread_cache * owner = hdr->h.owner;
+            if (!owner)
+                ::operator delete(hdr);
+            else if (owner == tls_cache())
+                owner->free_local(hdr->h.cls, p);
+            else
+                owner->free_remote(hdr->h.cls, p);
+        }
+    }
+
+    /**
+     * @brief 使用每线程缓存的标准分配器
+     *
+     * 无状态，所有实例相等；可以在一个线程分配、在另一个线程释放
+     */
+    template <typename T>
+    class caching_allocator {
+    public:
+        typedef T value_type;
+
+        caching_allocator() noexcept {}
+        template <typename U>
+        caching_allocator(const caching_allocator<U> &) noexcept {}
+
+        T * allocate(std::size_t n) {
+            static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+            if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+                throw std::bad_alloc();
+            return static_cast<T *>(detail::cache_allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T * p, std::size_t) noexcept { detail::cache_deallocate(p); }
+
+        template <typename U>
+        struct rebind {
+            typedef caching_allocator<U> other;
+        };
+    };
+
+    template <typename T, typename U>
+    bool operator==(const caching_allocator<T> &, const caching_allocator<U> &) noexcept { return true; }
+
+    template <typename T, typename U>
+    bool operator!=(const caching_allocator<T> &, const caching_allocator<U> &) noexcept { return false; }
+
+}
+
+#endif // __ctpl_alloc_H__
@@ -0,0 +1,397 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 批量异步映射 (map_async)
+*
+* 常见的扇出写法是对每个元素push()一次，把future放进vector，再逐个get()。
+* 每个元素一个任务节点和一个共享状态，每次get()都可能进入futex等待。
+* map_async()把区间切成若干块，每块一个任务，结果直接写入一个连续的数组，
+* 所有块共用一个倒计数的状态字：
+*
+*      std::vector<std::string> paths = ...;
+*      ctpl::batch_result<size_t> sizes = ctpl::map_async(pool, paths,
+*          [](int id, const std::string & p) { return file_size(p); });
+*      sizes.get();  // 等待全部完成，有块抛出异常时重新抛出第一个异常
+*      for (size_t s : sizes) total += s;
+*
+* 主要功能和特点：
+* 1. 结果按元素顺序存放在一个连续数组中，可以像数组一样遍历和下标访问
+* 2. 整批只有一个等待点：每块完成时对状态字减一，减到0且有等待者时才调用futex唤醒
+* 3. 整批的分配次数与元素数无关：共享状态、结果数组、块任务数组各一次
+* 4. 第一个异常被保存并由get()重新抛出；出现异常后尚未开始的块不再执行
+*
+* 线程安全考量：
+* - f在工作线程上执行，签名为T f(int id, reference)，reference是区间元素的引用
+* - 区间以迭代器的形式被任务引用，必须在整批完成之前保持有效
+* - batch_result析构时等待整批完成，因此不应在同一线程池的工作线程中丢弃未完成的batch_result
+* - 最后完成的块在唤醒等待者之后才释放它对共享状态的引用，等待者销毁状态不会影响正在唤醒的线程
+*
+* 性能考量：
+* - 块数为线程数的_ctplBatchChunksPerThread_倍（不超过元素数），在负载均衡和调度开销之间折中
+* - 区间的迭代器需要支持随机访问，以便各块直接定位到自己的起点
+*********************************************************/
+
+#ifndef __ctpl_batch_H__
+#define __ctpl_batch_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#include <algorithm>   // 用于std::min
+#include <atomic>      // 用于倒计数的状态字和引用计数
+#include <chrono>      // 用于超时等待
+#include <cstddef>     // 用于std::size_t
+#include <cstdint>     // 用于std::uint32_t
+#include <exception>   // 用于std::exception_ptr
+#include <future>      // 用于std::future_error
+#include <iterator>    // 用于std::begin和std::end
+#include <memory>      // 用于std::unique_ptr
+#include <new>         // 用于placement new
+#include <type_traits> // 用于std::decay
+#include <utility>     // 用于std::move和std::forward
+
+#ifndef _ctplBatchChunksPerThread_
+#define _ctplBatchChunksPerThread_  4  // 每个线程平均分到的块数
+#endif
+
+namespace ctpl {
+
+    template <typename T>
+    class batch_result;
+
+    namespace detail {
+        const std::uint32_t bs_waiters = 0x80000000u;  // 有线程在等待
+        const std::uint32_t bs_count = 0x7fffffffu;  // 未完成的块数
+
+        /**
+         * @brief 一批任务的共享状态：结果数组、倒计数的状态字和第一个异常
+         *
+         * batch_result和所有块共同持有两个引用，最后一个引用释放时销毁
+         */
+        template <typename T>
+        class batch_state {
+        public:
+            batch_state(std::size_t n, int nChunks)
+                : word(static_cast<std::uint32_t>(nChunks)), refs(2), failed(false), n(n), nChunks(nChunks),
+                  slots(new storage_type[n > 0 ? n : 1]), built(new std::size_t[nChunks > 0 ? nChunks : 1]()) {}
+
+            /**
+             * @brief 一块完成，最后一块唤醒等待者并释放块的引用
+             */
+            void arrive() {
+                std::uint32_t old = this->word.fetch_sub(1, std::memory_order_acq_rel);
+                if ((old & bs_count) != 1)
+                    return;
+                if (old & bs_waiters)
+                    state_wake_all(this->word);
+                this->release();
+            }
+
+            /**
+             * @brief 记录异常，只保留第一个
+             */
+            void fail(std::exception_ptr e) {
+                if (!this->failed.exchange(true, std::memory_order_acq_rel))
+                    this->error = std::move(e);
+            }
+
+            bool has_failed() const { return this->failed.load(std::memory_order_relaxed); }
+
+            bool is_ready() const { return (this->word.load(std::memory_order_acquire) & bs_count) == 0; }
+
+            void wait() {
+                std::uint32_t w = this->word.load(std::memory_order_acquire);
+                for (int i = 0; i < _ctplFutureSpin_ && (w & bs_count); ++i)
+                    w = this->word.load(std::memory_order_acquire);
+                while (w & bs_count) {
+                    if (!(w & bs_waiters)) {
+                        if (!this->word.compare_exchange_weak(w, w | bs_waiters, std::memory_order_acquire))
+                            continue;
+                        w |= bs_waiters;
+                    }
+                    state_wait(this->word, w, nullptr);
+                    w = this->word.load(std::memory_order_acquire);
+                }
+            }
+
+            template <typename Clock, typename Duration>
+            bool wait_until(const std::chrono::time_point<Clock, Duration> & deadline) {
+                std::uint32_t w = this->word.load(std::memory_order_acquire);
+                while (w & bs_count) {
+                    typename Clock::time_point now = Clock::now();
+                    if (now >= deadline)
+                        return false;
+                    if (!(w & bs_waiters)) {
+                        if (!this->word.compare_exchange_weak(w, w | bs_waiters, std::memory_order_acquire))
+                            continue;
+                        w |= bs_waiters;
+                    }
+                    std::chrono::nanoseconds left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+                    state_wait(this->word, w, &left);
+                    w = this->word.load(std::memory_order_acquire);
+                }
+                return true;
+            }
+
+            void release() {
+                if (this->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    delete this;
+            }
+
+            /**
+             * @brief 在第i个位置构造结果，c是所在块的序号；同一块内按顺序构造
+             */
+            template <typename U>
+            void construct(int c, std::size_t i, U && v) {
+                new (&this->slots[i]) T(std::forward<U>(v));
+                ++this->built[c];
+            }
+
+            T * data() { return reinterpret_cast<T *>(this->slots.get()); }
+            std::size_t size() const { return this->n; }
+            const std::exception_ptr & first_error() const { return this->error; }
+
+        protected:
+            /**
+             * @brief 销毁已构造的结果；每块的结果从块的起点开始连续构造了built[c]个
+             */
+            virtual ~batch_state() {
+                for (int c = 0; c < this->nChunks; ++c) {
+                    std::size_t b = chunk_begin(this->n, this->nChunks, c);
+                    for (std::size_t i = 0; i < this->built[c]; ++i)
+                        this->data()[b + i].~T();
+                }
+            }
+
+        public:
+            /**
+             * @brief 第c块的起点：把n个元素均匀分成nChunks块
+             */
+            static std::size_t chunk_begin(std::size_t n, int nChunks, int c) {
+                return static_cast<std::size_t>(static_cast<unsigned long long>(n) * c / nChunks);
+            }
+
+        private:
+            /**
+             * @brief 一个结果的未初始化存储
+             */
+            struct alignas(T) storage_type {
+                unsigned char bytes[sizeof(T)];
+            };
+
+            std::atomic<std::uint32_t> word;  // 低31位为未完成的块数，最高位表示有等待者
+            std::atomic<int> refs;  // batch_result一个，所有块共同一个
+            std::atomic<bool> failed;  // 已记录异常
+            std::exception_ptr error;  // 第一个异常
+            std::size_t n;  // 元素数
+            int nChunks;
+            std::unique_ptr<storage_type[]> slots;  // 连续的结果数组
+            std::unique_ptr<std::size_t[]> built;  // 每块已构造的结果数
+        };
+
+        /**
+         * @brief 一块的任务节点，对区间[begin, end)中的元素依次调用f
+         */
+        template <typename T, typename It, typename F>
+        struct batch_chunk : task_node {
+            void run(int id) override {
+                if (!this->st->has_failed()) {  // 已有块失败时跳过尚未开始的块
+                    try {
+                        It it = this->first + static_cast<typename std::iterator_traits<It>::difference_type>(this->begin);
+                        for (std::size_t i = this->begin; i < this->end; ++i, ++it)
+                            this->st->construct(this->c, i, (*this->f)(id, *it));
+                    }
+                    catch (...) {
+                        this->st->fail(std::current_exception());
+                    }
+                }
+                this->st->arrive();
+            }
+
+            void discard() override {
+                this->st->fail(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+                this->st->arrive();
+            }
+
+            batch_state<T> * st;
+            F * f;
+            It first;  // 区间的起点
+            std::size_t begin;  // 本块在区间中的下标范围
+            std::size_t end;
+            int c;  // 块的序号
+        };
+
+        /**
+         * @brief 共享状态加上f和块任务数组
+         */
+        template <typename T, typename It, typename F>
+        class batch_job : public batch_state<T> {
+        public:
+            template <typename U>
+            batch_job(It first, std::size_t n, int nChunks, U && f)
+                : batch_state<T>(n, nChunks), f(std::forward<U>(f)), chunks(new batch_chunk<T, It, F>[nChunks > 0 ? nChunks : 1]) {
+                for (int c = 0; c < nChunks; ++c) {
+                    batch_chunk<T, It, F> & k = this->chunks[c];
+                    k.st = this;
+                    k.f = &this->f;
+                    k.first = first;
+                    k.begin = batch_state<T>::chunk_begin(n, nChunks, c);
+                    k.end = batch_state<T>::chunk_begin(n, nChunks, c + 1);
+                    k.c = c;
+                }
+            }
+
+            batch_chunk<T, It, F> * chunk(int c) { return &this->chunks[c]; }
+
+        private:
+            F f;
+            std::unique_ptr<batch_chunk<T, It, F>[]> chunks;
+        };
+    }
+
+    /**
+     * @brief map_async()的结果：按元素顺序存放的连续数组
+     *
+     * 只能移动，不能拷贝。访问结果之前先调用get()，它等待整批完成并在有异常时重新抛出第一个异常
+     */
+    template <typename T>
+    class batch_result {
+    public:
+        typedef T value_type;
+        typedef T * iterator;
+        typedef const T * const_iterator;
+
+        batch_result() noexcept : st(nullptr) {}
+        batch_result(batch_result && other) noexcept : st(other.st) { other.st = nullptr; }
+        batch_result & operator=(batch_result && other) noexcept {
+            if (this != &other) {
+                this->reset();
+                this->st = other.st;
+                other.st = nullptr;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief 析构函数，等待整批完成
+         */
+        ~batch_result() { this->reset(); }
+
+        bool valid() const noexcept { return this->st != nullptr; }
+        bool is_ready() const { return this->state().is_ready(); }
+
+        void wait() const { this->state().wait(); }
+
+        template <typename Rep, typename Period>
+        std::future_status wait_for(const std::chrono::duration<Rep, Period> & d) const {
+            return this->wait_until(std::chrono::steady_clock::now() + d);
+        }
+
+        template <typename Clock, typename Duration>
+        std::future_status wait_until(const std::chrono::time_point<Clock, Duration> & deadline) const {
+            return this->state().wait_until(deadline) ? std::future_status::ready : std::future_status::timeout;
+        }
+
+        /**
+         * @brief 等待整批完成，有块抛出异常时重新抛出第一个异常；可以多次调用
+         */
+        void get() const {
+            detail::batch_state<T> & s = this->state();
+            s.wait();
+            if (s.has_failed())
+                std::rethrow_exception(s.first_error());
+        }
+
+        // 以下访问函数只能在get()成功返回之后调用
+        std::size_t size() const { return this->st ? this->st->size() : 0; }
+        bool empty() const { return this->size() == 0; }
+        T * data() { return this->st->data(); }
+        const T * data() const { return this->st->data(); }
+        T & operator[](std::size_t i) { return this->st->data()[i]; }
+        const T & operator[](std::size_t i) const { return this->st->data()[i]; }
+        iterator begin() { return this->st ? this->st->data() : nullptr; }
+        iterator end() { return this->st ? this->st->data() + this->st->size() : nullptr; }
+        const_iterator begin() const { return this->st ? this->st->data() : nullptr; }
+        const_iterator end() const { return this->st ? this->st->data() + this->st->size() : nullptr; }
+
+    private:
+        template <typename U, typename Pool, typename Range, typename F>
+        friend batch_result<U> map_async_impl(Pool & pool, Range & range, F && f);
+
+        explicit batch_result(detail::batch_state<T> * st) noexcept : st(st) {}
+
+        batch_result(const batch_result &);// = delete;
+        batch_result & operator=(const batch_result &);// = delete;
+
+        detail::batch_state<T> & state() const {
+            if (!this->st)
+                throw std::future_error(std::future_errc::no_state);
+            return *this->st;
+        }
+
+        void reset() {
+            if (!this->st)
+                return;
+            this->st->wait();  // 任务还在引用调用者的区间
+            this->st->release();
+            this->st = nullptr;
+        }
+
+        detail::batch_state<T> * st;
+    };
+
+    template <typename T, typename Pool, typename Range, typename F>
+    batch_result<T> map_async_impl(Pool & pool, Range & range, F && f) {
+        typedef decltype(std::begin(range)) It;
+        typedef detail::batch_job<T, It, typename std::decay<F>::type> job_type;
+
+        It first = std::begin(range);
+        std::size_t n = static_cast<std::size_t>(std::end(range) - first);
+        std::size_t maxChunks = static_cast<std::size_t>(pool.size() > 0 ? pool.size() : 1) * _ctplBatchChunksPerThread_;
+        int nChunks = static_cast<int>(std::min(n, maxChunks));
+
+        job_type * job = new job_type(first, n, nChunks, std::forward<F>(f));
+        batch_result<T> r(job);
+        if (nChunks == 0) {
+            job->release();  // 空区间：没有块会释放块的引用
+            return r;
+        }
+        for (int c = 0; c < nChunks; ++c)
+            pool.post(job->chunk(c));
+        return r;
+    }
+
+    /**
+     * @brief 对区间的每个元素在线程池中调用f(id, element)，结果按元素顺序存放在batch_result中
+     *
+     * @param range 支持std::begin/std::end且迭代器可随机访问的区间，必须在整批完成之前保持有效
+     * @param f 签名为T f(int id, reference)，在各块之间共享，需要可以并发调用
+     */
+    template <typename Pool, typename Range, typename F>
+    auto map_async(Pool & pool, Range & range, F && f)
+        ->batch_result<typename std::decay<decltype(f(0, *std::begin(range)))>::type> {
+        typedef typename std::decay<decltype(f(0, *std::begin(range)))>::type T;
+        static_assert(!std::is_void<T>::value, "map_async() requires f to return a value");
+        return map_async_impl<T>(pool, range, std::forward<F>(f));
+    }
+
+}
+
+#endif // __ctpl_batch_H__
@@ -0,0 +1,660 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 并发缓存 (concurrent_cache)
+*
+* 线程池中的任务经常重复计算相同的结果，用互斥锁保护的std::unordered_map会让它们串行化。
+* concurrent_cache是分段的开放寻址哈希表，读不加锁，写只锁一个分段：
+*
+*      ctpl::concurrent_cache<std::string, image> cache(64 << 20);  // 内存预算64MB，0表示不限
+*      image img;
+*      if (!cache.find(path, img)) { ... }
+*      std::shared_future<image> f = cache.get_or_compute(pool, path,
+*          [](int id, const std::string & p) { return load(p); });  // 同一个键只计算一次
+*
+* 主要功能和特点：
+* 1. find()不加锁：线性探测分段的当前表，只有两次写本线程计数器的原子操作
+* 2. 写操作（insert、erase、计算完成）按哈希选择分段并只锁该分段；负载过高时在锁内重建该分段的表
+* 3. get_or_compute()：并发未命中同一个键时只有第一个调用者把计算提交到线程池，所有调用者共享同一个std::shared_future；
+*    计算抛出异常时条目被删除，之后的调用会重新计算
+* 4. 设置内存预算时按CLOCK（近似LRU）淘汰：读命中设置引用位，淘汰指针跳过并清除有引用位的条目，
+*    正在计算的条目不会被淘汰；每个条目的大小为条目本身加上Weigh(key, value)
+*
+* 线程安全考量：
+* - 被替换、删除、淘汰的条目和旧表不会立即释放，而是放入分段的待回收列表，
+*   等所有可能看到它们的读者离开后再释放（两个纪元的读者计数，写者翻转纪元后等待旧纪元的读者）
+* - 读者计数按线程分散在多个缓存行上，读者之间不共享可写的缓存行
+* - 计算在线程池中完成后回调缓存，销毁缓存之前必须等待所有计算完成（例如pool.wait_idle()）
+*
+* 性能考量：
+* - 分段数默认为硬件线程数的4倍，内存预算平均分配给各分段，淘汰只在超出预算的分段内进行
+* - 回收每积累_ctplCacheRetireBatch_个对象进行一次，需要等待正在进行的读操作结束
+*********************************************************/
+
+#ifndef __ctpl_cache_H__
+#define __ctpl_cache_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#include <atomic>      // 用于无锁读和读者计数
+#include <cstddef>     // 用于std::size_t
+#include <cstdint>     // 用于std::uint64_t
+#include <exception>   // 用于std::exception_ptr
+#include <functional>  // 用于std::hash和std::equal_to
+#include <future>      // 用于std::promise和std::shared_future
+#include <memory>      // 用于std::unique_ptr
+#include <mutex>       // 用于分段锁
+#include <thread>      // 用于std::this_thread::yield
+#include <utility>     // 用于std::move和std::forward
+#include <vector>      // 用于分段和待回收列表
+
+#ifndef _ctplCacheReaderStripes_
+#define _ctplCacheReaderStripes_  32  // 读者计数的分散数
+#endif
+
+#ifndef _ctplCacheInitialSize_
+#define _ctplCacheInitialSize_  16  // 分段表的初始槽数，必须是2的幂
+#endif
+
+#ifndef _ctplCacheRetireBatch_
+#define _ctplCacheRetireBatch_  64  // 分段积累多少个待回收对象后进行一次回收
+#endif
+
+namespace ctpl {
+
+    namespace detail {
+        /**
+         * @brief 默认的条目大小估计：键和值对象本身的大小
+         */
+        template <typename K, typename V>
+        struct cache_weigh {
+            std::size_t operator()(const K &, const V &) const { return sizeof(K) + sizeof(V); }
+        };
+
+        /**
+         * @brief 两个纪元的读者计数
+         *
+         * 读者在当前纪元的计数器上加一，再确认纪元没有变化；写者翻转纪元后等待旧纪元的计数归零，
+         * 此后旧纪元的读者都已离开，翻转之前摘除的对象可以释放
+         */
+        class cache_epoch {
+        public:
+            cache_epoch() : epoch(0) {
+                for (int e = 0; e < 2; ++e)
+                    for (int s = 0; s < _ctplCacheReaderStripes_; ++s)
+                        this->readers[e][s].n.store(0, std::memory_order_relaxed);
+            }
+
+            int enter() {
+                int s = stripe();
+                while (true) {
+                    int e = this->epoch.load(std::memory_order_acquire);
+                    this->readers[e][s].n.fetch_add(1, std::memory_order_seq_cst);
+                    if (this->epoch.load(std::memory_order_seq_cst) == e)
+                        return e;
+                    this->readers[e][s].n.fetch_sub(1, std::memory_order_release);  // 纪元已翻转，重新进入
+                }
+            }
+
+            void leave(int e) { this->readers[e][stripe()].n.fetch_sub(1, std::memory_order_release); }
+
+            /**
+             * @brief 等待翻转之前进入的读者全部离开，调用者必须互斥地调用
+             */
+            void synchronize() {
+                int old = this->epoch.load(std::memory_order_relaxed);
+                this->epoch.store(old ^ 1, std::memory_order_seq_cst);
+                for (int s = 0; s < _ctplCacheReaderStripes_; ++s)
+                    while (this->readers[old][s].n.load(std::memory_order_seq_cst) != 0)
+                        std::this_thread::yield();
+            }
+
+        private:
+            static int stripe() {
+                static std::atomic<int> next(0);
+                static thread_local int s = next.fetch_add(1, std::memory_order_relaxed) % _ctplCacheReaderStripes_;
+                return s;
+            }
+
+            struct counter {
+                std::atomic<long> n;
+                char pad[_ctplCacheLineSize_ - sizeof(std::atomic<long>)];
+            };
+
+            std::atomic<int> epoch;
+            char pad[_ctplCacheLineSize_];
+            counter readers[2][_ctplCacheReaderStripes_];
+        };
+
+        /**
+         * @brief 读者的作用域守卫
+         */
+        class cache_read_guard {
+        public:
+            explicit cache_read_guard(cache_epoch & ep) : ep(ep), e(ep.enter()) {}
+            ~cache_read_guard() { this->ep.leave(this->e); }
+
+        private:
+            cache_read_guard(const cache_read_guard &);// = delete;
+            cache_read_guard & operator=(const cache_read_guard &);// = delete;
+
+            cache_epoch & ep;
+            int e;
+        };
+    }
+
+    /**
+     * @brief 并发缓存，读不加锁，写按分段加锁，支持只计算一次和按内存预算淘汰
+     *
+     * @tparam Weigh 估计条目大小的函数对象，签名为std::size_t(const K &, const V &)
+     */
+    template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>,
+              typename Weigh = detail::cache_weigh<K, V>>
+    class concurrent_cache {
+
+        struct entry;
+        struct segment;
+
+    public:
+
+        /**
+         * @brief 构造函数
+         *
+         * @param budget 内存预算（字节），0表示不淘汰
+         * @param nSegments 分段数，<= 0时为硬件线程数的4倍，向上取2的幂
+         */
+        explicit concurrent_cache(std::size_t budget = 0, int nSegments = 0) {
+            int n = nSegments > 0 ? nSegments : 4 * static_cast<int>(std::thread::hardware_concurrency());
+            int bits = 0;
+            while ((1 << bits) < n)
+                ++bits;
+            this->segBits = bits;
+            this->segMask = (static_cast<std::size_t>(1) << bits) - 1;
+            std::size_t share = budget / (this->segMask + 1);
+            if (budget && !share)
+                share = 1;  // 预算很小时每个分段至少为1，不能变成不淘汰
+            this->segments.reserve(this->segMask + 1);
+            for (std::size_t i = 0; i <= this->segMask; ++i)
+                this->segments.emplace_back(new segment(share));
+        }
+
+        /**
+         * @brief 析构函数，调用者必须确保没有并发操作和尚未完成的计算
+         */
+        ~concurrent_cache() {
+            for (std::size_t i = 0; i < this->segments.size(); ++i) {
+                segment & s = *this->segments[i];
+                table * t = s.tab.load(std::memory_order_relaxed);
+                for (std::size_t k = 0; k <= t->mask; ++k) {
+                    entry * e = t->slots[k].load(std::memory_order_relaxed);
+                    if (e && e != tombstone())
+                        delete e;
+                }
+                delete t;
+                free_retired(s.retiredEntries, s.retiredTables);
+            }
+        }
+
+        /**
+         * @brief 查找已就绪的值，不加锁
+         *
+         * @return 找到时把值复制到value并返回true；键不存在或仍在计算时返回false
+         */
+        bool find(const K & key, V & value) {
+            std::size_t h = this->hash_of(key);
+            detail::cache_read_guard g(this->epoch);
+            entry * e = this->lookup(this->segment_of(h), h, key);
+            const V * v = e ? e->ready.load(std::memory_order_acquire) : nullptr;
+            if (!v)
+                return false;
+            touch(e);
+            value = *v;
+            return true;
+        }
+
+        /**
+         * @brief 插入或替换一个值
+         */
+        void insert(const K & key, V value) {
+            std::size_t h = this->hash_of(key);
+            segment & s = this->segment_of(h);
+            std::promise<V> p;
+            p.set_value(std::move(value));
+            entry * e = new entry(h, key, p.get_future().share(), true);
+            e->charge += this->weigh(key, e->value.get());
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                e->serial = ++s.serial;
+                this->store_locked(s, e);
+                this->evict_locked(s);
+            }
+            this->reclaim(s);
+        }
+
+        /**
+         * @brief 删除一个键，返回键是否存在；正在进行的计算仍会完成，但结果不再进入缓存
+         */
+        bool erase(const K & key) {
+            std::size_t h = this->hash_of(key);
+            segment & s = this->segment_of(h);
+            bool found;
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                found = this->remove_locked(s, h, key, 0);
+            }
+            this->reclaim(s);
+            return found;
+        }
+
+        /**
+         * @brief 删除所有条目
+         */
+        void clear() {
+            for (std::size_t i = 0; i < this->segments.size(); ++i) {
+                segment & s = *this->segments[i];
+                {
+                    std::lock_guard<std::mutex> lock(s.mutex);
+                    this->rebuild_locked(s, _ctplCacheInitialSize_, true);
+                }
+                this->reclaim(s);
+            }
+        }
+
+        /**
+         * @brief 返回键对应的值的future，键不存在时在线程池中计算f(id, key)
+         *
+         * 并发未命中同一个键的调用者中只有一个提交计算，所有调用者得到同一个shared_future
+         */
+        template <typename Pool, typename F>
+        std::shared_future<V> get_or_compute(Pool & pool, const K & key, F && f) {
+            std::size_t h = this->hash_of(key);
+            segment & s = this->segment_of(h);
+            {
+                detail::cache_read_guard g(this->epoch);
+                entry * e = this->lookup(s, h, key);
+                if (e) {
+                    touch(e);
+                    return e->value;
+                }
+            }
+
+            compute_node<typename std::decay<F>::type> * n;
+            std::shared_future<V> result;
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                entry * e = this->lookup(s, h, key);  // 加锁期间可能已有其他调用者插入
+                if (e) {
+                    touch(e);
+                    return e->value;
+                }
+                n = new compute_node<typename std::decay<F>::type>(*this, h, key, std::forward<F>(f));
+                result = n->promise.get_future().share();
+                e = new entry(h, key, result, false);
+                e->serial = n->serial = ++s.serial;
+                this->store_locked(s, e);
+                this->evict_locked(s);
+            }
+            this->reclaim(s);
+            pool.post(n);
+            return result;
+        }
+
+        /**
+         * @brief 获取条目数
+         */
+        std::size_t size() {
+            std::size_t n = 0;
+            for (std::size_t i = 0; i < this->segments.size(); ++i) {
+                std::lock_guard<std::mutex> lock(this->segments[i]->mutex);
+                n += this->segments[i]->count;
+            }
+            return n;
+        }
+
+        /**
+         * @brief 获取所有条目按Weigh估计的总大小（字节）
+         */
+        std::size_t bytes() {
+            std::size_t n = 0;
+            for (std::size_t i = 0; i < this->segments.size(); ++i) {
+                std::lock_guard<std::mutex> lock(this->segments[i]->mutex);
+                n += this->segments[i]->bytes;
+            }
+            return n;
+        }
+
+    private:
+
+        concurrent_cache(const concurrent_cache &);// = delete;
+        concurrent_cache & operator=(const concurrent_cache &);// = delete;
+
+        /**
+         * @brief 条目，发布后只有ready、referenced和（在分段锁内的）charge会改变
+         */
+        struct entry {
+            entry(std::size_t hash, const K & key, std::shared_future<V> value, bool ready)
+                : hash(hash), key(key), value(std::move(value)), ready(ready ? &this->value.get() : nullptr),
+                  referenced(true), charge(sizeof(entry)), serial(0) {}
+
+            std::size_t hash;
+            K key;
+            std::shared_future<V> value;
+            std::atomic<const V *> ready;  // 计算完成后指向共享状态中的值，find()不必经过shared_future::get()
+            std::atomic<bool> referenced;  // CLOCK的引用位
+            std::size_t charge;  // 计入预算的大小，由分段锁保护
+            std::uint64_t serial;  // 分段内的序号，用于识别计算对应的条目
+        };
+
+        /**
+         * @brief 分段的开放寻址表，槽为nullptr（空）、tombstone()（已删除）或条目指针
+         */
+        struct table {
+            explicit table(std::size_t n) : mask(n - 1), slots(new std::atomic<entry *>[n]) {
+                for (std::size_t i = 0; i < n; ++i)
+                    this->slots[i].store(nullptr, std::memory_order_relaxed);
+            }
+
+            std::size_t mask;
+            std::unique_ptr<std::atomic<entry *>[]> slots;
+        };
+
+        struct segment {
+            explicit segment(std::size_t budget)
+                : tab(new table(_ctplCacheInitialSize_)), count(0), tombstones(0), bytes(0), budget(budget), hand(0), serial(0) {}
+
+            std::mutex mutex;  // 保护以下所有成员的修改
+            std::atomic<table *> tab;  // 读者不加锁读取
+            std::size_t count;  // 条目数
+            std::size_t tombstones;  // 已删除的槽数
+            std::size_t bytes;  // 条目大小之和
+            std::size_t budget;  // 本分段的内存预算，0表示不淘汰
+            std::size_t hand;  // CLOCK淘汰指针
+            std::uint64_t serial;
+            std::vector<entry *> retiredEntries;  // 等待回收的条目
+            std::vector<table *> retiredTables;  // 等待回收的表
+            char pad[_ctplCacheLineSize_];
+        };
+
+        /**
+         * @brief 提交到线程池的计算任务，完成后把值的大小计入预算并标记条目就绪
+         */
+        template <typename F>
+        struct compute_node : detail::task_node {
+            template <typename U>
+            compute_node(concurrent_cache & cache, std::size_t hash, const K & key, U && f)
+                : cache(cache), hash(hash), key(key), serial(0), f(std::forward<U>(f)) {}
+
+            void run(int id) override {
+                std::unique_ptr<compute_node> self(this);  // 执行后释放节点
+                try {
+                    this->promise.set_value(this->f(id, static_cast<const K &>(this->key)));
+                }
+                catch (...) {
+                    this->promise.set_exception(std::current_exception());
+                    this->cache.finish(this->hash, this->key, this->serial, false);
+                    return;
+                }
+                this->cache.finish(this->hash, this->key, this->serial, true);
+            }
+
+            void discard() override {
+                this->promise.set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+                this->cache.finish(this->hash, this->key, this->serial, false);
+                delete this;
+            }
+
+            concurrent_cache & cache;
+            std::size_t hash;
+            K key;
+            std::uint64_t serial;  // 对应条目的序号
+            std::promise<V> promise;
+            F f;
+        };
+
+        static entry * tombstone() {
+            static char dummy;
+            return reinterpret_cast<entry *>(&dummy);
+        }
+
+        /**
+         * @brief 读命中时设置引用位，已设置时不写，避免读者之间争用缓存行
+         */
+        static void touch(entry * e) {
+            if (!e->referenced.load(std::memory_order_relaxed))
+                e->referenced.store(true, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 混合哈希值，std::hash对整数通常是恒等函数，低位直接用于选择分段和槽时分布不均
+         */
+        std::size_t hash_of(const K & key) const {
+            std::uint64_t h = static_cast<std::uint64_t>(this->hasher(key));
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return static_cast<std::size_t>(h);
+        }
+
+        segment & segment_of(std::size_t h) { return *this->segments[h & this->segMask]; }
+
+        std::size_t slot_of(std::size_t h, const table * t) const { return (h >> this->segBits) & t->mask; }
+
+        /**
+         * @brief 在分段的当前表中查找，调用者持有读者守卫或分段锁
+         */
+        entry * lookup(segment & s, std::size_t h, const K & key) {
+            table * t = s.tab.load(std::memory_order_acquire);
+            std::size_t i = this->slot_of(h, t);
+            for (std::size_t n = 0; n <= t->mask; ++n, i = (i + 1) & t->mask) {
+                entry * e = t->slots[i].load(std::memory_order_acquire);
+                if (!e)
+                    return nullptr;
+                if (e != tombstone() && e->hash == h && this->equal(e->key, key))
+                    return e;
+            }
+            return nullptr;
+        }
+
+        /**
+         * @brief 插入条目，键已存在时替换旧条目；调用者持有分段锁
+         */
+        void store_locked(segment & s, entry * e) {
+            // 负载（含已删除的槽）超过3/4时重建，条目数超过一半时容量加倍
+            table * t = s.tab.load(std::memory_order_relaxed);
+            if ((s.count + s.tombstones + 1) * 4 > (t->mask + 1) * 3)
+                this->rebuild_locked(s, (s.count + 1) * 2 > t->mask + 1 ? (t->mask + 1) * 2 : t->mask + 1, false);
+            t = s.tab.load(std::memory_order_relaxed);
+
+            std::size_t i = this->slot_of(e->hash, t);
+            std::size_t free = t->mask + 1;  // 遇到的第一个已删除的槽
+            for (;; i = (i + 1) & t->mask) {
+                entry * old = t->slots[i].load(std::memory_order_relaxed);
+                if (!old)
+                    break;
+                if (old == tombstone()) {
+                    if (free > t->mask)
+                        free = i;
+                    continue;
+                }
+                if (old->hash == e->hash && this->equal(old->key, e->key)) {
+                    t->slots[i].store(e, std::memory_order_release);
+                    s.bytes += e->charge;
+                    s.bytes -= old->charge;
+                    s.retiredEntries.push_back(old);
+                    return;
+                }
+            }
+            if (free <= t->mask) {
+                i = free;
+                --s.tombstones;
+            }
+            t->slots[i].store(e, std::memory_order_release);
+            ++s.count;
+            s.bytes += e->charge;
+        }
+
+        /**
+         * @brief 删除键；serial不为0时只删除序号相同的条目。调用者持有分段锁
+         */
+        bool remove_locked(segment & s, std::size_t h, const K & key, std::uint64_t serial) {
+            table * t = s.tab.load(std::memory_order_relaxed);
+            std::size_t i = this->slot_of(h, t);
+            for (std::size_t n = 0; n <= t->mask; ++n, i = (i + 1) & t->mask) {
+                entry * e = t->slots[i].load(std::memory_order_relaxed);
+                if (!e)
+                    return false;
+                if (e != tombstone() && e->hash == h && this->equal(e->key, key)) {
+                    if (serial && e->serial != serial)
+                        return false;
+                    this->unlink_locked(s, t, i);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void unlink_locked(segment & s, table * t, std::size_t i) {
+            entry * e = t->slots[i].load(std::memory_order_relaxed);
+            t->slots[i].store(tombstone(), std::memory_order_release);
+            --s.count;
+            ++s.tombstones;
+            s.bytes -= e->charge;
+            s.retiredEntries.push_back(e);
+        }
+
+        /**
+         * @brief 把分段的条目移到一张新表中并丢弃已删除的槽；empty为true时丢弃所有条目。调用者持有分段锁
+         */
+        void rebuild_locked(segment & s, std::size_t n, bool empty) {
+            table * old = s.tab.load(std::memory_order_relaxed);
+            table * t = new table(n);
+            for (std::size_t k = 0; k <= old->mask; ++k) {
+                entry * e = old->slots[k].load(std::memory_order_relaxed);
+                if (!e || e == tombstone())
+                    continue;
+                if (empty) {
+                    s.retiredEntries.push_back(e);
+                    continue;
+                }
+                std::size_t i = this->slot_of(e->hash, t);
+                while (t->slots[i].load(std::memory_order_relaxed))
+                    i = (i + 1) & t->mask;
+                t->slots[i].store(e, std::memory_order_relaxed);
+            }
+            s.tab.store(t, std::memory_order_release);
+            s.retiredTables.push_back(old);
+            s.tombstones = 0;
+            s.hand = 0;
+            if (empty) {
+                s.count = 0;
+                s.bytes = 0;
+            }
+        }
+
+        /**
+         * @brief 超出预算时按CLOCK淘汰已就绪的条目，最多扫描两圈。调用者持有分段锁
+         */
+        void evict_locked(segment & s) {
+            if (!s.budget)
+                return;
+            table * t = s.tab.load(std::memory_order_relaxed);
+            for (std::size_t n = 0; s.bytes > s.budget && n < 2 * (t->mask + 1); ++n) {
+                std::size_t i = s.hand;
+                s.hand = (s.hand + 1) & t->mask;
+                entry * e = t->slots[i].load(std::memory_order_relaxed);
+                if (!e || e == tombstone() || !e->ready.load(std::memory_order_relaxed))
+                    continue;
+                if (e->referenced.load(std::memory_order_relaxed)) {
+                    e->referenced.store(false, std::memory_order_relaxed);
+                    continue;
+                }
+                this->unlink_locked(s, t, i);
+            }
+        }
+
+        /**
+         * @brief 计算结束：成功时计入值的大小并标记就绪，失败时删除条目
+         */
+        void finish(std::size_t h, const K & key, std::uint64_t serial, bool ok) {
+            segment & s = this->segment_of(h);
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                if (!ok) {
+                    this->remove_locked(s, h, key, serial);
+                }
+                else {
+                    entry * e = this->lookup(s, h, key);
+                    if (e && e->serial == serial) {
+                        std::size_t w = this->weigh(key, e->value.get());
+                        e->charge += w;
+                        s.bytes += w;
+                        e->ready.store(&e->value.get(), std::memory_order_release);
+                        this->evict_locked(s);
+                    }
+                }
+            }
+            this->reclaim(s);
+        }
+
+        /**
+         * @brief 待回收对象足够多时，等待读者离开后释放它们
+         */
+        void reclaim(segment & s) {
+            std::vector<entry *> entries;
+            std::vector<table *> tables;
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                if (s.retiredEntries.size() + s.retiredTables.size() < _ctplCacheRetireBatch_)
+                    return;
+                entries.swap(s.retiredEntries);
+                tables.swap(s.retiredTables);
+            }
+            {
+                std::lock_guard<std::mutex> lock(this->reclaimMutex);
+                this->epoch.synchronize();
+            }
+            free_retired(entries, tables);
+        }
+
+        static void free_retired(std::vector<entry *> & entries, std::vector<table *> & tables) {
+            for (std::size_t i = 0; i < entries.size(); ++i)
+                delete entries[i];
+            for (std::size_t i = 0; i < tables.size(); ++i)
+                delete tables[i];
+            entries.clear();
+            tables.clear();
+        }
+
+        Hash hasher;
+        KeyEqual equal;
+        Weigh weigh;
+        int segBits;  // 分段索引的位数，槽索引使用哈希值的其余位
+        std::size_t segMask;
+        std::vector<std::unique_ptr<segment>> segments;
+        std::mutex reclaimMutex;  // 串行化纪元翻转
+        detail::cache_epoch epoch;
+    };
+
+}
+
+#endif // __ctpl_cache_H__
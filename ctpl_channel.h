@@ -0,0 +1,319 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 多生产者多消费者通道 (channel)
+*
+* 在线程之间传递数据的有界或无界队列，可以关闭，并与thread_pool配合：
+* 在工作线程上的消费者用async_recv()登记一个续体，数据到达时续体被提交到线程池，
+* 而不是阻塞工作线程等待数据。
+*
+*      ctpl::channel<std::string> ch(128);  // 容量128，0表示无界
+*      ch.async_recv(pool, [](int id, std::string * s) { if (s) handle(*s); });
+*      ch.send("hello");
+*      ch.close();
+*
+* 主要功能和特点：
+* 1. send()在通道满时阻塞，recv()在通道空时阻塞；try_send()/try_recv()从不阻塞
+* 2. close()之后send()失败，recv()仍能取出剩余数据，取完后返回false；
+*    尚未得到数据的async_recv()续体以nullptr被调用
+* 3. 有续体在等待时，send()把数据直接交给最早登记的续体，不经过队列，也不占用容量
+* 4. 续体本身就是线程池的任务节点，数据直接存放在节点中，每次async_recv()只有一次分配
+*
+* 线程安全考量：
+* - 所有操作由一把互斥锁保护，阻塞等待使用两个条件变量（非空、非满）
+* - 续体在锁外提交到线程池，不会在持有通道锁时执行用户代码
+* - 续体抛出的异常会被丢弃，与actor的消息处理函数一致
+*********************************************************/
+
+#ifndef __ctpl_channel_H__
+#define __ctpl_channel_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#include <condition_variable>  // 用于阻塞的send()和recv()
+#include <cstddef>     // 用于std::size_t
+#include <memory>      // 用于std::unique_ptr
+#include <mutex>       // 用于互斥锁
+#include <new>         // 用于placement new
+#include <queue>       // 用于标准库队列
+#include <type_traits> // 用于std::decay
+#include <utility>     // 用于std::move和std::forward
+
+namespace ctpl {
+
+    namespace detail {
+        /**
+         * @brief 等待数据的续体，数据直接存放在节点中
+         */
+        template <typename T>
+        struct channel_waiter : task_node {
+            channel_waiter() : next(nullptr), has(false) {}
+            ~channel_waiter() {
+                if (this->has)
+                    this->value()->~T();
+            }
+
+            template <typename U>
+            void set(U && v) {
+                new (&this->storage) T(std::forward<U>(v));
+                this->has = true;
+            }
+
+            /**
+             * @brief 交给续体的数据，通道已关闭时为nullptr
+             */
+            T * value() { return this->has ? reinterpret_cast<T *>(&this->storage) : nullptr; }
+
+            virtual void post() = 0;  // 把续体提交到登记时指定的线程池
+
+            channel_waiter * next;  // 等待链表中的下一个续体
+            alignas(T) unsigned char storage[sizeof(T)];  // 交给续体的数据，has为true时有效
+            bool has;  // storage中是否有数据
+        };
+
+        /**
+         * @brief async_recv()登记的续体：f(int id, T * value)
+         */
+        template <typename T, typename Pool, typename F>
+        struct channel_recv_node : channel_waiter<T> {
+            template <typename U>
+            channel_recv_node(Pool & pool, U && f) : pool(pool), f(std::forward<U>(f)) {}
+
+            void run(int id) override {
+                std::unique_ptr<channel_recv_node> self(this);  // 执行后释放节点
+                try {
+                    this->f(id, this->value());
+                }
+                catch (...) {
+                }
+            }
+
+            void discard() override { delete this; }
+
+            void post() override { this->pool.post(this); }
+
+            Pool & pool;  // 执行续体的线程池
+            F f;  // 续体
+        };
+    }
+
+    /**
+     * @brief 多生产者多消费者通道
+     *
+     * @tparam T 数据类型，需要可移动构造
+     *
+     * 通道不可拷贝或移动。销毁时仍在等待的async_recv()续体被直接释放而不调用，
+     * 调用者应在销毁前close()通道
+     */
+    template <typename T>
+    class channel {
+
+    public:
+
+        /**
+         * @brief 构造函数
+         *
+         * @param capacity 最多缓存的数据数，0表示无界
+         */
+        explicit channel(std::size_t capacity = 0) : capacity(capacity), closed(false), head(nullptr), tail(nullptr) {}
+
+        ~channel() {
+            while (detail::channel_waiter<T> * w = this->head) {
+                this->head = w->next;
+                w->discard();
+            }
+        }
+
+        /**
+         * @brief 发送数据，通道满时阻塞
+         *
+         * @return bool 通道已关闭时返回false，数据被丢弃
+         *
+         * T的构造函数抛出的异常传给调用者，此时数据没有发送，等待的续体不受影响
+         */
+        bool send(const T & v) { return this->push(v, true); }
+        bool send(T && v) { return this->push(std::move(v), true); }
+
+        /**
+         * @brief 发送数据，不阻塞
+         *
+         * @return bool 通道已满或已关闭时返回false，v保持不变
+         */
+        bool try_send(const T & v) { return this->push(v, false); }
+        bool try_send(T && v) { return this->push(std::move(v), false); }
+
+        /**
+         * @brief 接收数据，通道空时阻塞
+         *
+         * @param v 接收到的数据
+         * @return bool 通道已关闭且没有剩余数据时返回false
+         *
+         * 不应在线程池的工作线程上调用，工作线程上应使用async_recv()
+         */
+        bool recv(T & v) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->notEmpty.wait(lock, [this]() { return !this->q.empty() || this->closed; });
+            return this->pop(v, lock);
+        }
+
+        /**
+         * @brief 接收数据，不阻塞
+         *
+         * @return bool 没有数据时返回false
+         */
+        bool try_recv(T & v) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            return this->pop(v, lock);
+        }
+
+        /**
+         * @brief 异步接收一个数据
+         *
+         * @param pool 执行续体的线程池
+         * @param f 续体 f(int id, T * value)，id是工作线程索引；
+         *          value指向接收到的数据，通道已关闭且没有剩余数据时为nullptr
+         *
+         * 有数据时续体立即被提交到线程池；否则登记续体，由之后的send()或close()提交。
+         * 续体按登记顺序得到数据，每个续体只被调用一次
+         */
+        template <typename Pool, typename F>
+        void async_recv(Pool & pool, F && f) {
+            typedef detail::channel_recv_node<T, Pool, typename std::decay<F>::type> node_type;
+            std::unique_ptr<node_type> n(new node_type(pool, std::forward<F>(f)));
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                if (this->q.empty() && !this->closed) {  // 登记续体，等待数据
+                    if (this->tail)
+                        this->tail->next = n.get();
+                    else
+                        this->head = n.get();
+                    this->tail = n.release();
+                    return;
+                }
+                if (!this->q.empty()) {
+                    n->set(std::move(this->q.front()));
+                    this->q.pop();
+                }
+            }
+            this->notFull.notify_one();
+            n.release()->post();
+        }
+
+        /**
+         * @brief 关闭通道：之后的send()失败，等待中的接收者被唤醒
+         */
+        void close() {
+            detail::channel_waiter<T> * w;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->closed = true;
+                w = this->head;  // 有续体在等待说明队列为空，它们都以nullptr被调用
+                this->head = this->tail = nullptr;
+            }
+            this->notEmpty.notify_all();
+            this->notFull.notify_all();
+            while (w) {
+                detail::channel_waiter<T> * next = w->next;
+                w->post();
+                w = next;
+            }
+        }
+
+        /**
+         * @brief 通道是否已关闭
+         */
+        bool is_closed() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            return this->closed;
+        }
+
+        /**
+         * @brief 获取队列中的数据数量，不包括已直接交给续体的数据
+         */
+        std::size_t size() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            return this->q.size();
+        }
+
+    private:
+
+        channel(const channel &);// = delete;
+        channel(channel &&);// = delete;
+        channel & operator=(const channel &);// = delete;
+        channel & operator=(channel &&);// = delete;
+
+        /**
+         * @brief 发送数据：有续体等待时直接交给最早的续体，否则放入队列
+         */
+        template <typename U>
+        bool push(U && v, bool wait) {
+            detail::channel_waiter<T> * w = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                if (wait)
+                    this->notFull.wait(lock, [this]() { return this->closed || !this->full(); });
+                if (this->closed || this->full())
+                    return false;
+                if (this->head) {  // 有续体等待时队列一定为空
+                    w = this->head;
+                    w->set(std::forward<U>(v));  // 先构造数据：T的构造函数抛出异常时续体仍在链表中等待
+                    this->head = w->next;
+                    if (!this->head)
+                        this->tail = nullptr;
+                }
+                else
+                    this->q.push(std::forward<U>(v));
+            }
+            if (w)
+                w->post();
+            else
+                this->notEmpty.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief 从队列取出一个数据，调用者持有锁
+         */
+        bool pop(T & v, std::unique_lock<std::mutex> & lock) {
+            if (this->q.empty())
+                return false;
+            v = std::move(this->q.front());
+            this->q.pop();
+            lock.unlock();
+            this->notFull.notify_one();
+            return true;
+        }
+
+        bool full() const { return this->capacity != 0 && this->q.size() >= this->capacity; }
+
+        std::size_t capacity;  // 容量，0表示无界
+        std::mutex mutex;  // 保护以下成员
+        std::condition_variable notEmpty;  // 通知阻塞的recv()
+        std::condition_variable notFull;  // 通知阻塞的send()
+        std::queue<T> q;  // 缓存的数据
+        bool closed;  // 是否已关闭
+        detail::channel_waiter<T> * head;  // 等待数据的续体链表
+        detail::channel_waiter<T> * tail;
+    };
+
+}
+
+#endif // __ctpl_channel_H__
@@ -0,0 +1,347 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* C++20协程支持
+*
+* 提供可co_await的协程类型ctpl::task<T>，配合thread_pool::schedule()，
+* 可以用顺序的协程代码编写异步流水线，而不必层层嵌套push()回调：
+*
+*      ctpl::task<int> work(ctpl::thread_pool & pool) {
+*          int id = co_await pool.schedule();  // 切换到线程池的工作线程
+*          co_return id;
+*      }
+*
+* 主要功能和特点：
+* 1. task<T>是惰性的：创建时不执行，被co_await或sync_wait()时才开始
+* 2. 完成时通过对称转移(symmetric transfer)直接恢复等待者，不经过队列，也不会因嵌套过深而栈溢出
+* 3. 除协程帧本身外不分配内存，结果直接存放在协程帧的promise中
+* 4. 协程帧通过模板参数Alloc（标准分配器接口）分配，可以换成ctpl_alloc.h中的每线程缓存分配器ctpl::caching_allocator
+* 5. 任务中抛出的异常会在co_await或sync_wait()处重新抛出
+*
+* 线程安全考量：
+* - 同一个task只能被co_await一次
+* - sync_wait()使用互斥锁和条件变量阻塞调用线程，不能在线程池的工作线程中调用，否则可能死锁
+*********************************************************/
+
+#ifndef __ctpl_coro_H__
+#define __ctpl_coro_H__
+
+#if !defined(__cpp_impl_coroutine) || __cpp_impl_coroutine < 201902L
+#error "ctpl_coro.h requires C++20 coroutine support"
+#endif
+
+#include <coroutine>           // 用于协程句柄和挂起点
+#include <condition_variable>  // 用于sync_wait()阻塞等待
+#include <cstddef>             // 用于std::size_t
+#include <exception>           // 用于std::exception_ptr
+#include <memory>              // 用于std::allocator和std::allocator_traits
+#include <mutex>               // 用于sync_wait()阻塞等待
+#include <optional>            // 用于存放task的结果
+#include <utility>             // 用于std::move和std::exchange
+
+namespace ctpl {
+
+    template <typename T = void, typename Alloc = std::allocator<char>>
+    class task;
+
+    namespace detail {
+        /**
+         * @brief 协程帧分配的基本单位，保证帧按默认new的对齐方式对齐
+         */
+        struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) frame_unit {
+            char bytes[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+        };
+
+        /**
+         * @brief 所有task的promise公共部分：帧分配、等待者、异常和最终挂起点
+         *
+         * @tparam Alloc 无状态的标准分配器，协程帧通过它的rebind分配
+         */
+        template <typename Alloc>
+        class promise_base {
+        public:
+            using frame_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<frame_unit>;
+
+            /**
+             * @brief 协程帧的分配函数，编译器创建帧时调用
+             */
+            static void * operator new(std::size_t size) {
+                frame_allocator a;
+                return std::allocator_traits<frame_allocator>::allocate(a, units(size));
+            }
+
+            /**
+             * @brief 协程帧的释放函数，编译器销毁帧时调用，带有帧的大小
+             */
+            static void operator delete(void * p, std::size_t size) noexcept {
+                frame_allocator a;
+                std::allocator_traits<frame_allocator>::deallocate(a, static_cast<frame_unit *>(p), units(size));
+            }
+
+            /**
+             * @brief 最终挂起点：通过对称转移直接恢复等待者
+             */
+            struct final_awaiter {
+                bool await_ready() const noexcept { return false; }
+
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+                    std::coroutine_handle<> c = h.promise().continuation;
+                    return c ? c : std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }  // 惰性启动
+            final_awaiter final_suspend() const noexcept { return {}; }
+            void unhandled_exception() noexcept { this->exception = std::current_exception(); }
+
+            std::coroutine_handle<> continuation;  // 等待此task完成的协程
+            std::exception_ptr exception;  // 任务中抛出的异常
+
+        private:
+            static std::size_t units(std::size_t size) {
+                return (size + sizeof(frame_unit) - 1) / sizeof(frame_unit);
+            }
+        };
+
+        /**
+         * @brief 有返回值的task的promise，结果直接存放在协程帧中
+         */
+        template <typename T, typename Alloc>
+        class task_promise : public promise_base<Alloc> {
+        public:
+            task<T, Alloc> get_return_object() noexcept;
+
+            template <typename U>
+            void return_value(U && value) { this->value.emplace(std::forward<U>(value)); }
+
+            T result() {
+                if (this->exception)
+                    std::rethrow_exception(this->exception);
+                return std::move(*this->value);
+            }
+
+        private:
+            std::optional<T> value;  // 任务结果
+        };
+
+        /**
+         * @brief 无返回值的task的promise
+         */
+        template <typename Alloc>
+        class task_promise<void, Alloc> : public promise_base<Alloc> {
+        public:
+            task<void, Alloc> get_return_object() noexcept;
+
+            void return_void() noexcept {}
+
+            void result() {
+                if (this->exception)
+                    std::rethrow_exception(this->exception);
+            }
+        };
+    }
+
+    /**
+     * @brief 惰性启动的协程任务
+     *
+     * @tparam T 结果类型
+     * @tparam Alloc 协程帧使用的无状态标准分配器，默认为std::allocator<char>
+     *
+     * task只能移动，不能拷贝；task被销毁时会销毁其协程帧。
+     * co_await一个task会启动它，并在它完成时于完成它的线程上恢复等待者。
+     */
+    template <typename T, typename Alloc>
+    class task {
+    public:
+        using promise_type = detail::task_promise<T, Alloc>;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        task() noexcept : h(nullptr) {}
+        explicit task(handle_type h) noexcept : h(h) {}
+        task(task && other) noexcept : h(std::exchange(other.h, nullptr)) {}
+        task(const task &) = delete;
+        task & operator=(const task &) = delete;
+
+        task & operator=(task && other) noexcept {
+            if (this != &other) {
+                if (this->h)
+                    this->h.destroy();
+                this->h = std::exchange(other.h, nullptr);
+            }
+            return *this;
+        }
+
+        ~task() {
+            if (this->h)
+                this->h.destroy();
+        }
+
+        /**
+         * @brief task是否已经完成
+         */
+        bool done() const noexcept { return !this->h || this->h.done(); }
+
+        /**
+         * @brief co_await task的等待体：启动task并通过对称转移切换到它
+         */
+        class awaiter {
+        public:
+            explicit awaiter(handle_type h) noexcept : h(h) {}
+
+            bool await_ready() const noexcept { return !this->h || this->h.done(); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) noexcept {
+                this->h.promise().continuation = c;
+                return this->h;  // 对称转移：直接开始执行task，不增加调用栈深度
+            }
+
+            T await_resume() { return this->h.promise().result(); }
+
+        private:
+            handle_type h;
+        };
+
+        awaiter operator co_await() && noexcept { return awaiter(this->h); }
+        awaiter operator co_await() & noexcept { return awaiter(this->h); }
+
+        /**
+         * @brief 等待task完成但不取结果，用于sync_wait()
+         */
+        class ready_awaiter : public awaiter {
+        public:
+            using awaiter::awaiter;
+            void await_resume() const noexcept {}
+        };
+
+        ready_awaiter when_ready() noexcept { return ready_awaiter(this->h); }
+
+        /**
+         * @brief 获取已完成task的结果，如果task抛出了异常则重新抛出
+         */
+        T result() { return this->h.promise().result(); }
+
+    private:
+        handle_type h;  // 协程句柄
+    };
+
+    namespace detail {
+        template <typename T, typename Alloc>
+        task<T, Alloc> task_promise<T, Alloc>::get_return_object() noexcept {
+            return task<T, Alloc>(std::coroutine_handle<task_promise>::from_promise(*this));
+        }
+
+        template <typename Alloc>
+        task<void, Alloc> task_promise<void, Alloc>::get_return_object() noexcept {
+            return task<void, Alloc>(std::coroutine_handle<task_promise>::from_promise(*this));
+        }
+
+        /**
+         * @brief sync_wait()的阻塞状态
+         */
+        struct sync_wait_state {
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool done = false;
+        };
+
+        /**
+         * @brief sync_wait()使用的驱动协程，在最终挂起点通知等待的线程
+         */
+        class sync_wait_driver {
+        public:
+            struct promise_type {
+                sync_wait_driver get_return_object() noexcept {
+                    return sync_wait_driver(std::coroutine_handle<promise_type>::from_promise(*this));
+                }
+
+                std::suspend_always initial_suspend() const noexcept { return {}; }
+
+                /**
+                 * @brief 协程已经挂起后才通知，因此等待的线程被唤醒后可以立即销毁协程帧
+                 */
+                struct final_awaiter {
+                    bool await_ready() const noexcept { return false; }
+
+                    void await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                        sync_wait_state & st = *h.promise().state;
+                        std::unique_lock<std::mutex> lock(st.mutex);
+                        st.done = true;
+                        st.cv.notify_all();
+                    }
+
+                    void await_resume() const noexcept {}
+                };
+
+                final_awaiter final_suspend() const noexcept { return {}; }
+                void return_void() noexcept {}
+                void unhandled_exception() noexcept {}  // 结果和异常都保存在被等待的task中
+
+                sync_wait_state * state = nullptr;
+            };
+
+            explicit sync_wait_driver(std::coroutine_handle<promise_type> h) noexcept : h(h) {}
+            sync_wait_driver(sync_wait_driver && other) noexcept : h(std::exchange(other.h, nullptr)) {}
+
+            ~sync_wait_driver() {
+                if (this->h)
+                    this->h.destroy();
+            }
+
+            /**
+             * @brief 在调用线程上启动驱动协程，并阻塞直到它完成
+             */
+            void run(sync_wait_state & st) {
+                this->h.promise().state = &st;
+                this->h.resume();
+                std::unique_lock<std::mutex> lock(st.mutex);
+                st.cv.wait(lock, [&st]() { return st.done; });
+            }
+
+        private:
+            std::coroutine_handle<promise_type> h;
+        };
+
+        template <typename T, typename Alloc>
+        sync_wait_driver make_sync_wait_driver(task<T, Alloc> & t) {
+            co_await t.when_ready();
+        }
+    }
+
+    /**
+     * @brief 在当前线程阻塞等待task完成并返回其结果
+     *
+     * @param t 要执行的task
+     * @return T task的结果，task抛出的异常会在这里重新抛出
+     *
+     * task从调用线程开始执行，直到它通过co_await pool.schedule()等切换到其他线程。
+     * 不能在线程池的工作线程中调用，否则可能因为占用了工作线程而死锁
+     */
+    template <typename T, typename Alloc>
+    T sync_wait(task<T, Alloc> t) {
+        detail::sync_wait_state st;
+        detail::make_sync_wait_driver(t).run(st);
+        return t.result();
+    }
+
+}
+
+#endif // __ctpl_coro_H__
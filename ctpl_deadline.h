@@ -0,0 +1,457 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 按截止时间调度 (EDF, earliest deadline first)
+*
+* 线程池的队列是先进先出的：请求带有截止时间时，已经过期的任务仍会先于新请求执行。
+* deadline_scheduler把带截止时间的任务放在按截止时间排序的堆中，
+* 线程池中只有一个调度令牌，工作线程执行令牌时才取出截止时间最早的任务。
+*
+*      ctpl::deadline_scheduler<ctpl::thread_pool> ds(pool, ctpl::expired_policy::drop);
+*      auto f = ds.push_with_deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(5),
+*                                     [](int id) { return handle(); });
+*      auto g = ds.push_with_deadline(deadline, [](int id) { return full(); },
+*                                     [](int id) { return cached(); });  // 过期时改为执行备用函数
+*
+* 主要功能和特点：
+* 1. 每个工作线程一个最小堆，任务轮流放入各堆；取任务时比较本线程的堆和另一个堆的堆顶，
+*    取截止时间较早的一个（两者择一的窃取），两个堆都为空时扫描所有堆
+* 2. 取出时已经过期的任务：带备用函数的执行备用函数，结果同样通过future返回；
+*    否则按expired_policy照常执行或丢弃，丢弃的任务的future中为deadline_missed异常
+* 3. stats()统计执行、过期、丢弃、备用和错过截止时间的任务数，以及迟到时间的总和与最大值
+*
+* 线程安全考量：
+* - 每个堆由自己的互斥锁保护，取任务时同一时刻最多持有一把锁
+* - 调度令牌是调度器的一个成员，同一时刻最多在线程池队列中出现一次，侵入式队列（mpsc_queue）也可以使用；
+*   pending记录还需要执行令牌的次数（每个任务一次），令牌执行时先减一，仍大于0则立即重新提交自己，
+*   再取出一个任务执行，因此多个工作线程仍能同时执行任务，且每次执行一定能取到一个任务
+* - 调度器销毁时等待所有令牌被执行或丢弃，调用者应保证线程池在此之前不会被销毁
+*
+* 性能考量：
+* - 除任务节点本身外没有额外的分配，任务节点与结果的共享状态位于同一次分配中
+* - 截止时间相同的任务按提交顺序执行（同一个堆内）
+*********************************************************/
+
+#ifndef __ctpl_deadline_H__
+#define __ctpl_deadline_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#include <algorithm>   // 用于std::push_heap和std::pop_heap
+#include <atomic>      // 用于统计计数和令牌计数
+#include <chrono>      // 用于截止时间
+#include <cstdint>     // 用于std::uint64_t
+#include <memory>      // 用于std::unique_ptr
+#include <mutex>       // 用于保护每个堆
+#include <stdexcept>   // 用于std::runtime_error
+#include <thread>      // 用于std::this_thread::yield
+#include <type_traits> // 用于std::decay
+#include <utility>     // 用于std::forward
+#include <vector>      // 用于堆的存储
+
+namespace ctpl {
+
+    /**
+     * @brief 任务因过期被丢弃时，future中保存的异常
+     */
+    class deadline_missed : public std::runtime_error {
+    public:
+        deadline_missed() : std::runtime_error("ctpl: task deadline missed") {}
+    };
+
+    /**
+     * @brief 没有备用函数的任务在取出时已经过期的处理方式
+     */
+    enum class expired_policy {
+        run,   // 照常执行，计为迟到
+        drop   // 不执行，future中为deadline_missed异常
+    };
+
+    /**
+     * @brief deadline_scheduler::stats()返回的统计数据
+     */
+    struct deadline_stats {
+        std::uint64_t executed;  // 执行了的任务数，包括迟到执行的
+        std::uint64_t expired;  // 取出时已经过期的任务数
+        std::uint64_t dropped;  // 过期后被丢弃的任务数
+        std::uint64_t fallbacks;  // 过期后改为执行备用函数的任务数
+        std::uint64_t missed;  // 没有在截止时间前完成的任务数：完成时已过期的，以及被丢弃或改为备用函数的
+        std::chrono::nanoseconds totalLateness;  // 错过截止时间的任务迟到时间之和
+        std::chrono::nanoseconds maxLateness;  // 最大迟到时间
+    };
+
+    namespace detail {
+        typedef std::chrono::steady_clock deadline_clock;
+
+        /**
+         * @brief 堆中的任务节点
+         */
+        struct deadline_node {
+            virtual void run(int id) = 0;  // 执行任务，此后不再访问节点
+            virtual void expire(int id) = 0;  // 过期：执行备用函数或设置deadline_missed，此后不再访问节点
+            virtual void discard() = 0;  // 线程池停止，任务没有执行，此后不再访问节点
+
+            deadline_clock::time_point deadline;  // 截止时间
+            std::uint64_t seq;  // 在所在堆中的提交序号，截止时间相同时先提交的先执行
+            bool hasFallback;  // 是否有备用函数
+        };
+
+        /**
+         * @brief 没有备用函数
+         */
+        struct no_fallback {};
+
+        /**
+         * @brief 带截止时间的任务，结果的共享状态也在节点中
+         */
+        template <typename R, typename F, typename G>
+        struct deadline_task : deadline_node, future_state<R> {
+            template <typename U, typename V>
+            deadline_task(U && u, V && v) : f(std::forward<U>(u)), g(std::forward<V>(v)) {
+                this->hasFallback = !std::is_same<G, no_fallback>::value;
+            }
+
+            void run(int id) override {
+                try {
+                    future_invoker<R>::run(*this, this->f, id);
+                }
+                catch (...) {
+                    this->set_exception(std::current_exception());
+                }
+                this->release();
+            }
+
+            void expire(int id) override {
+                this->fallback(id, std::is_same<G, no_fallback>());
+                this->release();
+            }
+
+            void discard() override {
+                this->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+                this->release();
+            }
+
+            void destroy() override { delete this; }
+
+            static void * operator new(std::size_t size) { return cache_allocate(size); }
+            static void operator delete(void * p) noexcept { cache_deallocate(p); }
+
+        private:
+            void fallback(int, std::true_type) {
+                this->set_exception(std::make_exception_ptr(deadline_missed()));
+            }
+
+            void fallback(int id, std::false_type) {
+                try {
+                    future_invoker<R>::run(*this, this->g, id);
+                }
+                catch (...) {
+                    this->set_exception(std::current_exception());
+                }
+            }
+
+            F f;  // 任务，签名为R(int id)
+            G g;  // 备用函数，签名为R(int id)
+        };
+
+        /**
+         * @brief 堆的比较函数：截止时间晚的排在后面，堆顶是截止时间最早的任务
+         */
+        struct deadline_later {
+            bool operator()(const deadline_node * a, const deadline_node * b) const {
+                return a->deadline > b->deadline || (a->deadline == b->deadline && a->seq > b->seq);
+            }
+        };
+
+        /**
+         * @brief 一个工作线程的堆和统计数据
+         *
+         * 统计数据由以此为主堆的工作线程更新，末尾的填充隔开相邻的堆
+         */
+        struct deadline_shard {
+            deadline_shard() : seq(0), executed(0), expired(0), dropped(0), fallbacks(0), missed(0),
+                totalLateness(0), maxLateness(0) {}
+
+            std::mutex mutex;  // 保护heap和seq
+            std::vector<deadline_node *> heap;  // 按截止时间排序的最小堆
+            std::uint64_t seq;  // 下一个提交序号
+
+            std::atomic<std::uint64_t> executed;
+            std::atomic<std::uint64_t> expired;
+            std::atomic<std::uint64_t> dropped;
+            std::atomic<std::uint64_t> fallbacks;
+            std::atomic<std::uint64_t> missed;
+            std::atomic<long long> totalLateness;  // 纳秒
+            std::atomic<long long> maxLateness;  // 纳秒
+            char pad[_ctplCacheLineSize_];
+        };
+    }
+
+    /**
+     * @brief 按截止时间调度任务的执行器
+     *
+     * @tparam Pool 线程池类型，需要提供post(task_node *)和size()方法（ctpl::thread_pool即可）
+     *
+     * 调度器不可拷贝或移动，销毁时阻塞直到所有已提交的任务被执行或丢弃
+     */
+    template <typename Pool>
+    class deadline_scheduler {
+
+    public:
+
+        typedef std::chrono::steady_clock clock;
+
+        /**
+         * @brief 构造函数
+         *
+         * @param pool 执行任务的线程池
+         * @param policy 没有备用函数的任务在过期时的处理方式
+         * @param nShards 堆的数量，默认为线程池的线程数
+         */
+        explicit deadline_scheduler(Pool & pool, expired_policy policy = expired_policy::run, int nShards = 0)
+            : pool(pool), policy(policy), nShards(nShards > 0 ? nShards : std::max(1, pool.size())),
+              shards(new detail::deadline_shard[this->nShards]), nextShard(0), outstanding(0), pending(0), token(*this) {}
+
+        ~deadline_scheduler() {
+            while (this->outstanding.load(std::memory_order_acquire) != 0)
+                std::this_thread::yield();  // 令牌仍在线程池的队列中
+            for (int i = 0; i < this->nShards; ++i) {
+                for (detail::deadline_node * n : this->shards[i].heap)
+                    n->discard();  // 正常情况下此时堆已经为空
+            }
+        }
+
+        /**
+         * @brief 提交带截止时间的任务
+         *
+         * @param deadline 截止时间
+         * @param f 任务 f(int id)，id是工作线程索引
+         * @return future<decltype(f(0))> 任务的结果；按expired_policy::drop丢弃时为deadline_missed异常
+         */
+        template <typename F>
+        auto push_with_deadline(clock::time_point deadline, F && f) -> future<decltype(f(0))> {
+            typedef decltype(f(0)) R;
+            typedef detail::deadline_task<R, typename std::decay<F>::type, detail::no_fallback> task_type;
+            return this->submit<R>(new task_type(std::forward<F>(f), detail::no_fallback()), deadline);
+        }
+
+        /**
+         * @brief 提交带截止时间和备用函数的任务
+         *
+         * @param fallback 取出时任务已经过期则改为执行fallback(int id)，返回类型与f相同
+         */
+        template <typename F, typename G>
+        auto push_with_deadline(clock::time_point deadline, F && f, G && fallback) -> future<decltype(f(0))> {
+            typedef decltype(f(0)) R;
+            typedef detail::deadline_task<R, typename std::decay<F>::type, typename std::decay<G>::type> task_type;
+            return this->submit<R>(new task_type(std::forward<F>(f), std::forward<G>(fallback)), deadline);
+        }
+
+        /**
+         * @brief 获取已提交但尚未完成的任务数量
+         */
+        int size() const { return static_cast<int>(this->outstanding.load(std::memory_order_relaxed)); }
+
+        /**
+         * @brief 获取统计数据，各项分别读取，不是一个一致的快照
+         */
+        deadline_stats stats() const {
+            deadline_stats r = {};
+            long long total = 0, maxL = 0;
+            for (int i = 0; i < this->nShards; ++i) {
+                const detail::deadline_shard & s = this->shards[i];
+                r.executed += s.executed.load(std::memory_order_relaxed);
+                r.expired += s.expired.load(std::memory_order_relaxed);
+                r.dropped += s.dropped.load(std::memory_order_relaxed);
+                r.fallbacks += s.fallbacks.load(std::memory_order_relaxed);
+                r.missed += s.missed.load(std::memory_order_relaxed);
+                total += s.totalLateness.load(std::memory_order_relaxed);
+                maxL = std::max(maxL, s.maxLateness.load(std::memory_order_relaxed));
+            }
+            r.totalLateness = std::chrono::nanoseconds(total);
+            r.maxLateness = std::chrono::nanoseconds(maxL);
+            return r;
+        }
+
+    private:
+
+        deadline_scheduler(const deadline_scheduler &);// = delete;
+        deadline_scheduler(deadline_scheduler &&);// = delete;
+        deadline_scheduler & operator=(const deadline_scheduler &);// = delete;
+        deadline_scheduler & operator=(deadline_scheduler &&);// = delete;
+
+        /**
+         * @brief 调度令牌：执行时取出并执行截止时间最早的任务
+         *
+         * 只在pending从0变为非0时提交，或在执行时由自己重新提交，因此同一时刻最多在队列中出现一次；
+         * 重新提交后其他工作线程可能在本次执行结束前再次执行它，令牌本身不持有状态
+         */
+        struct dispatch_token : detail::task_node {
+            explicit dispatch_token(deadline_scheduler & s) : s(s) {}
+
+            void run(int id) override {
+                if (this->s.pending.fetch_sub(1, std::memory_order_acq_rel) > 1)
+                    this->s.pool.post(this);  // 还有任务等待调度，让其他工作线程并行取任务
+                this->s.dispatch(id);
+            }
+
+            void discard() override { this->s.drop_pending(); }
+
+            deadline_scheduler & s;
+        };
+
+        /**
+         * @brief 把任务放入一个堆，并提交一个令牌
+         */
+        template <typename R, typename Node>
+        future<R> submit(Node * n, clock::time_point deadline) {
+            n->deadline = deadline;
+            future<R> fut(n);
+            detail::deadline_shard & s = this->shards[this->nextShard.fetch_add(1, std::memory_order_relaxed) % this->nShards];
+            try {
+                std::unique_lock<std::mutex> lock(s.mutex);
+                n->seq = s.seq++;
+                s.heap.push_back(n);
+                std::push_heap(s.heap.begin(), s.heap.end(), detail::deadline_later());
+            }
+            catch (...) {
+                n->discard();
+                throw;
+            }
+            this->outstanding.fetch_add(1, std::memory_order_relaxed);
+            if (this->pending.fetch_add(1, std::memory_order_acq_rel) == 0)
+                this->pool.post(&this->token);  // 令牌不在队列中
+            return fut;
+        }
+
+        /**
+         * @brief 工作线程的主堆
+         */
+        int home(int id) const { return id >= 0 ? id % this->nShards : 0; }
+
+        /**
+         * @brief 从堆s取出堆顶，堆为空时返回nullptr
+         */
+        detail::deadline_node * pop(detail::deadline_shard & s) {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            if (s.heap.empty())
+                return nullptr;
+            std::pop_heap(s.heap.begin(), s.heap.end(), detail::deadline_later());
+            detail::deadline_node * n = s.heap.back();
+            s.heap.pop_back();
+            return n;
+        }
+
+        /**
+         * @brief 比较主堆和另一个堆的堆顶，取出截止时间较早的任务；两个堆都为空时扫描所有堆
+         */
+        detail::deadline_node * take(int id) {
+            static thread_local unsigned rotation = 0;  // 轮流选择被比较的另一个堆
+            const int h = this->home(id);
+            while (true) {
+                detail::deadline_node * n = nullptr;
+                if (this->nShards > 1) {
+                    detail::deadline_shard & own = this->shards[h];
+                    detail::deadline_shard & other = this->shards[(h + 1 + rotation++ % (this->nShards - 1)) % this->nShards];
+                    bool ownEmpty;
+                    clock::time_point ownTop = clock::time_point::max();
+                    {
+                        std::unique_lock<std::mutex> lock(own.mutex);
+                        ownEmpty = own.heap.empty();
+                        if (!ownEmpty)
+                            ownTop = own.heap.front()->deadline;
+                    }
+                    {
+                        std::unique_lock<std::mutex> lock(other.mutex);
+                        if (!other.heap.empty() && (ownEmpty || other.heap.front()->deadline < ownTop)) {
+                            std::pop_heap(other.heap.begin(), other.heap.end(), detail::deadline_later());
+                            n = other.heap.back();
+                            other.heap.pop_back();
+                            return n;
+                        }
+                    }
+                }
+                for (int k = 0; k < this->nShards; ++k) {  // 从主堆开始扫描
+                    if ((n = this->pop(this->shards[(h + k) % this->nShards])))
+                        return n;
+                }
+                // 令牌的执行次数等于已提交的任务数，所以一定有任务，只是被同时执行的令牌暂时取走了别的堆中的任务
+                std::this_thread::yield();
+            }
+        }
+
+        /**
+         * @brief 令牌被执行：取出截止时间最早的任务，按是否过期执行任务或备用函数并更新统计
+         */
+        void dispatch(int id) {
+            detail::deadline_node * n = this->take(id);
+            detail::deadline_shard & st = this->shards[this->home(id)];
+            const clock::time_point deadline = n->deadline;  // 执行后节点可能已被释放
+            const clock::time_point start = clock::now();
+            if (start > deadline) {
+                st.expired.fetch_add(1, std::memory_order_relaxed);
+                if (n->hasFallback || this->policy == expired_policy::drop) {
+                    (n->hasFallback ? st.fallbacks : st.dropped).fetch_add(1, std::memory_order_relaxed);
+                    n->expire(id);
+                    this->record_miss(st, start - deadline);
+                    this->outstanding.fetch_sub(1, std::memory_order_release);  // 此后不再访问调度器
+                    return;
+                }
+            }
+            n->run(id);
+            st.executed.fetch_add(1, std::memory_order_relaxed);
+            const clock::time_point end = clock::now();
+            if (end > deadline)
+                this->record_miss(st, end - deadline);
+            this->outstanding.fetch_sub(1, std::memory_order_release);  // 此后不再访问调度器
+        }
+
+        /**
+         * @brief 令牌被线程池丢弃：丢弃所有等待调度的任务
+         */
+        void drop_pending() {
+            for (long n = this->pending.exchange(0, std::memory_order_acq_rel); n > 0; --n) {
+                this->take(-1)->discard();
+                this->outstanding.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        static void record_miss(detail::deadline_shard & st, clock::duration lateness) {
+            long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(lateness).count();
+            st.missed.fetch_add(1, std::memory_order_relaxed);
+            st.totalLateness.fetch_add(ns, std::memory_order_relaxed);
+            long long cur = st.maxLateness.load(std::memory_order_relaxed);
+            while (ns > cur && !st.maxLateness.compare_exchange_weak(cur, ns, std::memory_order_relaxed)) {}
+        }
+
+        Pool & pool;  // 执行任务的线程池
+        expired_policy policy;  // 没有备用函数的任务过期时的处理方式
+        int nShards;  // 堆的数量
+        std::unique_ptr<detail::deadline_shard[]> shards;  // 每个工作线程一个堆
+        std::atomic<unsigned> nextShard;  // 下一个任务放入的堆
+        std::atomic<long> outstanding;  // 已提交但尚未完成的任务数
+        std::atomic<long> pending;  // 还需要执行令牌的次数，大于0时令牌在队列中（或正在被重新提交）
+        dispatch_token token;  // 调度令牌
+    };
+
+}
+
+#endif // __ctpl_deadline_H__
@@ -0,0 +1,599 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* std::execution (P2300) 调度器适配
+*
+* 让thread_pool作为senders/receivers异步算法的执行后端，接口与stdexec兼容：
+*
+*      auto sch = ctpl::get_scheduler(pool);
+*      auto work = stdexec::schedule(sch) | stdexec::then([] { return 42; });
+*      auto [v] = stdexec::sync_wait(std::move(work)).value();
+*
+* 主要功能和特点：
+* 1. pool_scheduler<Pool>：满足stdexec::scheduler概念，schedule()返回的sender在工作线程上完成
+* 2. stdexec::bulk的定制：调度器通过get_domain报告自己的domain，domain的transform_sender
+*    把在线程池上完成（或在线程池上启动）的bulk(sndr, shape, fn)换成并行版本：
+*    前一个sender完成后，[0, shape)被切分为与线程数相当的块，在工作线程上并行执行，
+*    而不是像默认的bulk那样在一个线程上串行执行
+*
+*      auto work = stdexec::schedule(sch) | stdexec::then([] { return 3; })
+*                | stdexec::bulk(n, [&](int i, int k) { out[i] = i * k; });
+*
+* 3. schedule_bulk(shape, fn)：等价于bulk(schedule(sch), shape, fn)，不经过domain
+* 4. 操作状态(operation state)本身就是线程池的任务节点，connect/start过程中没有任何堆分配
+*
+* 线程安全考量：
+* - 操作状态在start()之后、完成之前不能被移动或销毁，这由P2300的约定保证
+* - 线程池被立即停止(stop(false))时，尚未执行的操作以set_stopped完成
+* - fn(i, values...)可能在多个线程上并发调用，前一个sender的值以左值引用传给每次调用
+*
+* 依赖：C++20和stdexec（https://github.com/NVIDIA/stdexec），通过<stdexec/execution.hpp>引入。
+* stdexec没有取出bulk参数的公开接口，第2项依赖stdexec的内部接口（NVHPC 24.x附带的版本）：
+* stdexec::__sexpr_apply，以及bulk_t的数据成员__shape_和__fun_（P3481给bulk加入执行策略参数之前）。
+* 因此第2项受_ctplExecBulkDomain_控制：默认只在存在<stdexec/__detail/__basic_sender.hpp>时开启；
+* 开启后，bulk_t的数据不是这一布局（例如带有__pol_）时，transform_sender在编译期退回default_domain，
+* stdexec::bulk按默认方式串行执行，结果不变。schedule_bulk()只使用公开接口，不受影响。
+* tests/test_exec.cpp报告使用的是哪一条路径。
+*********************************************************/
+
+#ifndef __ctpl_exec_H__
+#define __ctpl_exec_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#include <stdexec/execution.hpp>  // P2300的参考实现
+#include <algorithm>   // 用于std::min
+#include <atomic>      // 用于bulk操作的完成计数
+#include <exception>   // 用于std::exception_ptr
+#include <tuple>       // 用于保存前一个sender的值
+#include <type_traits> // 用于std::decay_t
+#include <utility>     // 用于std::move
+#include <variant>     // 用于保存前一个sender的值
+
+#ifndef _ctplExecBulkDomain_
+#if __has_include(<stdexec/__detail/__basic_sender.hpp>)
+#define _ctplExecBulkDomain_  1  // 用stdexec的内部接口把stdexec::bulk换成并行版本
+#else
+#define _ctplExecBulkDomain_  0  // 内部接口不存在，stdexec::bulk按默认方式执行
+#endif
+#endif
+
+#ifndef _ctplBulkMaxChunks_
+#define _ctplBulkMaxChunks_  64  // schedule_bulk()最多切分的块数，块节点内嵌在操作状态中
+#endif
+
+namespace ctpl {
+
+    namespace detail {
+        template <typename... Ts>
+        using decayed_tuple = std::tuple<std::decay_t<Ts>...>;
+
+        template <typename... Ts>
+        using value_variant = std::variant<std::monostate, Ts...>;  // monostate表示前一个sender尚未完成
+
+        template <typename... Ts>
+        using decayed_set_value = stdexec::completion_signatures<stdexec::set_value_t(std::decay_t<Ts>...)>;
+
+#if _ctplExecBulkDomain_
+        /**
+         * @brief bulk_t的数据是否为domain能识别的布局{__shape_, __fun_}
+         */
+        template <typename Data>
+        concept known_bulk_data = requires (Data & d) { d.__shape_; d.__fun_; } && !requires (Data & d) { d.__pol_; };
+
+        struct bulk_data_probe {
+            template <typename Data, typename Child>
+            auto operator()(stdexec::bulk_t, Data &&, Child &&) const noexcept
+                -> std::bool_constant<known_bulk_data<std::remove_cvref_t<Data>>> { return {}; }
+        };
+
+        template <typename Sender>
+        inline constexpr bool known_bulk_sender = decltype(stdexec::__sexpr_apply(std::declval<Sender>(), bulk_data_probe()))::value;
+#endif
+
+        /**
+         * @brief 并行bulk的块调度，由bulk操作状态继承（CRTP）
+         *
+         * @tparam Derived 需要提供run_range(begin, end)、stop_requested()和complete()
+         *
+         * 每个块是一个内嵌的任务节点，最后一个完成的块调用Derived::complete()
+         */
+        template <typename Derived>
+        class bulk_chunks {
+        protected:
+            bulk_chunks() : nChunks(0), remaining(0), failed(false), stopped(false) {}
+
+            /**
+             * @brief 把[0, shape)切分为块并提交到线程池，shape <= 0时直接完成
+             */
+            template <typename Pool>
+            void launch(Pool * pool, long long shape) noexcept {
+                if (shape <= 0) {
+                    static_cast<Derived *>(this)->complete();
+                    return;
+                }
+                // 块数取线程数，但不超过元素数和内嵌节点数
+                long long n = std::max(1, pool->size());
+                n = std::min<long long>(n, shape);
+                const int nChunks = static_cast<int>(std::min<long long>(n, _ctplBulkMaxChunks_));
+                this->shape = shape;
+                this->nChunks = nChunks;
+                this->remaining.store(nChunks, std::memory_order_relaxed);
+
+                // 提交最后一个块之后操作状态可能已经完成并被销毁，因此循环只使用局部变量
+                int posted = 0;
+                try {
+                    for (; posted < nChunks; ++posted) {
+                        this->chunks[posted].op = this;
+                        this->chunks[posted].index = posted;
+                        pool->post(&this->chunks[posted]);
+                    }
+                }
+                catch (...) {
+                    this->fail(std::current_exception());
+                    // 未能提交的块直接计为完成
+                    for (int i = posted; i < nChunks; ++i)
+                        this->finish_chunk();
+                }
+            }
+
+            /**
+             * @brief 记录第一个异常，之后尚未开始的块不再执行
+             */
+            void fail(std::exception_ptr e) noexcept {
+                bool expected = false;
+                if (this->failed.compare_exchange_strong(expected, true, std::memory_order_relaxed))
+                    this->error = e;  // 只有第一个失败的块写入，完成计数的acq_rel保证对完成者可见
+            }
+
+            /**
+             * @brief 一个块的任务节点
+             */
+            struct chunk : task_node {
+                chunk() : op(nullptr), index(0) {}
+
+                void run(int) override { this->op->run_chunk(this->index); }
+
+                void discard() override {
+                    this->op->stopped.store(true, std::memory_order_relaxed);
+                    this->op->finish_chunk();
+                }
+
+                bulk_chunks * op;
+                int index;  // 块的序号
+            };
+
+            /**
+             * @brief 执行第index块：[shape * index / nChunks, shape * (index + 1) / nChunks)
+             */
+            void run_chunk(int index) {
+                Derived & self = *static_cast<Derived *>(this);
+                if (!this->failed.load(std::memory_order_relaxed) && !self.stop_requested()) {
+                    long long begin = this->shape * index / this->nChunks;
+                    long long end = this->shape * (index + 1) / this->nChunks;
+                    try {
+                        self.run_range(begin, end);
+                    }
+                    catch (...) {
+                        this->fail(std::current_exception());
+                    }
+                }
+                this->finish_chunk();
+            }
+
+            /**
+             * @brief 一个块完成；最后一个完成的块通知Derived
+             */
+            void finish_chunk() noexcept {
+                if (this->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    static_cast<Derived *>(this)->complete();
+            }
+
+            chunk chunks[_ctplBulkMaxChunks_];  // 内嵌的块节点，不需要堆分配
+            long long shape;  // 元素数
+            int nChunks;  // 实际使用的块数
+            std::atomic<int> remaining;  // 尚未完成的块数
+            std::atomic<bool> failed;  // 是否有块抛出了异常
+            std::atomic<bool> stopped;  // 是否有块因线程池停止而被丢弃
+            std::exception_ptr error;  // 第一个异常
+        };
+    }
+
+    /**
+     * @brief 基于thread_pool的P2300调度器
+     *
+     * @tparam Pool 线程池类型，需要提供post(detail::task_node *)和size()
+     *
+     * 调度器只保存线程池指针，可以自由拷贝；指向同一线程池的调度器相等
+     */
+    template <typename Pool = thread_pool>
+    class pool_scheduler {
+
+    public:
+
+        explicit pool_scheduler(Pool & pool) noexcept : pool(&pool) {}
+
+        /**
+         * @brief sender的环境，报告完成时所在的调度器
+         */
+        class env {
+        public:
+            explicit env(Pool * pool) noexcept : pool(pool) {}
+
+            template <typename CPO>
+            pool_scheduler query(stdexec::get_completion_scheduler_t<CPO>) const noexcept {
+                return pool_scheduler(*this->pool);
+            }
+
+        private:
+            Pool * pool;
+        };
+
+        /**
+         * @brief schedule()的操作状态，本身就是线程池的任务节点
+         */
+        template <typename Receiver>
+        class operation : public detail::task_node {
+        public:
+            operation(Pool * pool, Receiver rcvr) : pool(pool), rcvr(std::move(rcvr)) {}
+            operation(operation &&) = delete;  // 已提交到队列的节点地址不能改变
+
+            void start() & noexcept {
+                try {
+                    this->pool->post(this);
+                }
+                catch (...) {
+                    stdexec::set_error(std::move(this->rcvr), std::current_exception());
+                }
+            }
+
+            void run(int) override {
+                if (stdexec::get_stop_token(stdexec::get_env(this->rcvr)).stop_requested())
+                    stdexec::set_stopped(std::move(this->rcvr));
+                else
+                    stdexec::set_value(std::move(this->rcvr));
+            }
+
+            void discard() override { stdexec::set_stopped(std::move(this->rcvr)); }
+
+        private:
+            Pool * pool;
+            Receiver rcvr;
+        };
+
+        /**
+         * @brief schedule()返回的sender，在某个工作线程上以set_value()完成
+         */
+        class sender {
+        public:
+            using sender_concept = stdexec::sender_t;
+            using completion_signatures = stdexec::completion_signatures<
+                stdexec::set_value_t(),
+                stdexec::set_error_t(std::exception_ptr),
+                stdexec::set_stopped_t()>;
+
+            explicit sender(Pool * pool) noexcept : pool(pool) {}
+
+            template <typename Receiver>
+            operation<Receiver> connect(Receiver rcvr) const {
+                return operation<Receiver>(this->pool, std::move(rcvr));
+            }
+
+            env get_env() const noexcept { return env(this->pool); }
+
+        private:
+            Pool * pool;
+        };
+
+        /**
+         * @brief schedule_bulk()的操作状态
+         */
+        template <typename Receiver, typename Shape, typename Fn>
+        class bulk_operation : detail::bulk_chunks<bulk_operation<Receiver, Shape, Fn>> {
+            friend class detail::bulk_chunks<bulk_operation>;
+
+        public:
+            bulk_operation(Pool * pool, Shape shape, Fn fn, Receiver rcvr)
+                : pool(pool), count(shape), fn(std::move(fn)), rcvr(std::move(rcvr)) {}
+            bulk_operation(bulk_operation &&) = delete;
+
+            void start() & noexcept { this->launch(this->pool, static_cast<long long>(this->count)); }
+
+        private:
+            void run_range(long long begin, long long end) {
+                for (Shape i = static_cast<Shape>(begin); i < static_cast<Shape>(end); ++i)
+                    this->fn(i);
+            }
+
+            bool stop_requested() const noexcept {
+                return stdexec::get_stop_token(stdexec::get_env(this->rcvr)).stop_requested();
+            }
+
+            void complete() noexcept {
+                if (this->failed.load(std::memory_order_relaxed))
+                    stdexec::set_error(std::move(this->rcvr), std::move(this->error));
+                else if (this->stopped.load(std::memory_order_relaxed) || this->stop_requested())
+                    stdexec::set_stopped(std::move(this->rcvr));
+                else
+                    stdexec::set_value(std::move(this->rcvr));
+            }
+
+            Pool * pool;
+            Shape count;  // 元素数
+            Fn fn;  // 对每个元素调用的函数 fn(i)
+            Receiver rcvr;
+        };
+
+        /**
+         * @brief schedule_bulk()返回的sender
+         */
+        template <typename Shape, typename Fn>
+        class bulk_sender {
+        public:
+            using sender_concept = stdexec::sender_t;
+            using completion_signatures = stdexec::completion_signatures<
+                stdexec::set_value_t(),
+                stdexec::set_error_t(std::exception_ptr),
+                stdexec::set_stopped_t()>;
+
+            bulk_sender(Pool * pool, Shape shape, Fn fn) : pool(pool), shape(shape), fn(std::move(fn)) {}
+
+            template <typename Receiver>
+            bulk_operation<Receiver, Shape, Fn> connect(Receiver rcvr) && {
+                return bulk_operation<Receiver, Shape, Fn>(this->pool, this->shape, std::move(this->fn), std::move(rcvr));
+            }
+
+            template <typename Receiver>
+            bulk_operation<Receiver, Shape, Fn> connect(Receiver rcvr) const & {
+                return bulk_operation<Receiver, Shape, Fn>(this->pool, this->shape, this->fn, std::move(rcvr));
+            }
+
+            env get_env() const noexcept { return env(this->pool); }
+
+        private:
+            Pool * pool;
+            Shape shape;
+            Fn fn;
+        };
+
+        /**
+         * @brief 并行bulk的操作状态：先运行前一个sender，保存它的值，再把区间分块提交到线程池
+         *
+         * 前一个sender的操作状态内嵌在其中；值保存在variant中，每个块以左值引用把它们传给fn，
+         * 全部完成后移动给接收者
+         */
+        template <typename Child, typename Receiver, typename Shape, typename Fn>
+        class bulk_after_operation : detail::bulk_chunks<bulk_after_operation<Child, Receiver, Shape, Fn>> {
+            friend class detail::bulk_chunks<bulk_after_operation>;
+
+            /**
+             * @brief 连接到前一个sender的接收者
+             */
+            class child_receiver {
+            public:
+                using receiver_concept = stdexec::receiver_t;
+
+                explicit child_receiver(bulk_after_operation * op) noexcept : op(op) {}
+
+                template <typename... Vs>
+                void set_value(Vs &&... vs) && noexcept {
+                    try {
+                        this->op->values.template emplace<detail::decayed_tuple<Vs...>>(std::forward<Vs>(vs)...);
+                    }
+                    catch (...) {
+                        stdexec::set_error(std::move(this->op->rcvr), std::current_exception());
+                        return;
+                    }
+                    this->op->launch(this->op->pool, static_cast<long long>(this->op->count));
+                }
+
+                template <typename E>
+                void set_error(E && e) && noexcept { stdexec::set_error(std::move(this->op->rcvr), std::forward<E>(e)); }
+
+                void set_stopped() && noexcept { stdexec::set_stopped(std::move(this->op->rcvr)); }
+
+                stdexec::env_of_t<Receiver> get_env() const noexcept { return stdexec::get_env(this->op->rcvr); }
+
+            private:
+                bulk_after_operation * op;
+            };
+
+        public:
+            bulk_after_operation(Pool * pool, Child && child, Shape shape, Fn fn, Receiver rcvr)
+                : pool(pool), count(shape), fn(std::move(fn)), rcvr(std::move(rcvr)),
+                  childOp(stdexec::connect(std::move(child), child_receiver(this))) {}
+            bulk_after_operation(bulk_after_operation &&) = delete;
+
+            void start() & noexcept { stdexec::start(this->childOp); }
+
+        private:
+            void run_range(long long begin, long long end) {
+                std::visit([this, begin, end](auto & t) {
+                    if constexpr (!std::is_same_v<std::decay_t<decltype(t)>, std::monostate>) {
+                        std::apply([this, begin, end](auto &... vs) {
+                            for (Shape i = static_cast<Shape>(begin); i < static_cast<Shape>(end); ++i)
+                                this->fn(i, vs...);
+                        }, t);
+                    }
+                }, this->values);
+            }
+
+            bool stop_requested() const noexcept {
+                return stdexec::get_stop_token(stdexec::get_env(this->rcvr)).stop_requested();
+            }
+
+            void complete() noexcept {
+                if (this->failed.load(std::memory_order_relaxed))
+                    stdexec::set_error(std::move(this->rcvr), std::move(this->error));
+                else if (this->stopped.load(std::memory_order_relaxed) || this->stop_requested())
+                    stdexec::set_stopped(std::move(this->rcvr));
+                else {
+                    std::visit([this](auto & t) {
+                        if constexpr (!std::is_same_v<std::decay_t<decltype(t)>, std::monostate>) {
+                            std::apply([this](auto &... vs) {
+                                stdexec::set_value(std::move(this->rcvr), std::move(vs)...);
+                            }, t);
+                        }
+                    }, this->values);
+                }
+            }
+
+            typedef stdexec::value_types_of_t<Child, stdexec::env_of_t<Receiver>, detail::decayed_tuple, detail::value_variant> values_type;
+
+            Pool * pool;
+            Shape count;  // 元素数
+            Fn fn;  // 对每个元素调用的函数 fn(i, values...)
+            Receiver rcvr;
+            values_type values;  // 前一个sender的值
+            stdexec::connect_result_t<Child, child_receiver> childOp;  // 前一个sender的操作状态
+        };
+
+        /**
+         * @brief domain把bulk(child, shape, fn)换成的sender
+         */
+        template <typename Child, typename Shape, typename Fn>
+        class bulk_after_sender {
+        public:
+            using sender_concept = stdexec::sender_t;
+
+            template <typename Env>
+            using completions = stdexec::transform_completion_signatures_of<Child, Env,
+                stdexec::completion_signatures<stdexec::set_error_t(std::exception_ptr), stdexec::set_stopped_t()>,
+                detail::decayed_set_value>;
+
+            bulk_after_sender(Pool * pool, Child child, Shape shape, Fn fn)
+                : pool(pool), child(std::move(child)), shape(shape), fn(std::move(fn)) {}
+
+            template <typename Env>
+            completions<Env> get_completion_signatures(Env &&) const { return {}; }
+
+            template <typename Receiver>
+            bulk_after_operation<Child, Receiver, Shape, Fn> connect(Receiver rcvr) && {
+                return bulk_after_operation<Child, Receiver, Shape, Fn>(this->pool, std::move(this->child), this->shape, std::move(this->fn), std::move(rcvr));
+            }
+
+            env get_env() const noexcept { return env(this->pool); }
+
+        private:
+            Pool * pool;
+            Child child;  // 前一个sender
+            Shape shape;
+            Fn fn;
+        };
+
+#if _ctplExecBulkDomain_
+        /**
+         * @brief 调度器的domain，把在线程池上完成或启动的stdexec::bulk换成并行版本
+         *
+         * 第一个transform_sender在调用bulk()时使用（前一个sender在本线程池上完成），
+         * 第二个在connect时使用（接收者的环境中的调度器是本线程池）；
+         * 不认识bulk_t的数据布局时交给default_domain
+         */
+        class domain : public stdexec::default_domain {
+        public:
+            template <stdexec::sender_expr_for<stdexec::bulk_t> Sender>
+            auto transform_sender(Sender && sndr) const {
+                if constexpr (detail::known_bulk_sender<Sender>) {
+                    return stdexec::__sexpr_apply(std::forward<Sender>(sndr), [](stdexec::bulk_t, auto && data, auto && child) {
+                        Pool * pool = stdexec::get_completion_scheduler<stdexec::set_value_t>(stdexec::get_env(child)).pool;
+                        return domain::make_bulk(pool, std::forward<decltype(data)>(data), std::forward<decltype(child)>(child));
+                    });
+                }
+                else
+                    return stdexec::default_domain().transform_sender(std::forward<Sender>(sndr));
+            }
+
+            template <stdexec::sender_expr_for<stdexec::bulk_t> Sender, typename Env>
+                requires std::is_same_v<std::decay_t<decltype(stdexec::get_scheduler(std::declval<const Env &>()))>, pool_scheduler>
+            auto transform_sender(Sender && sndr, const Env & e) const {
+                if constexpr (detail::known_bulk_sender<Sender>) {
+                    Pool * pool = stdexec::get_scheduler(e).pool;
+                    return stdexec::__sexpr_apply(std::forward<Sender>(sndr), [pool](stdexec::bulk_t, auto && data, auto && child) {
+                        return domain::make_bulk(pool, std::forward<decltype(data)>(data), std::forward<decltype(child)>(child));
+                    });
+                }
+                else
+                    return stdexec::default_domain().transform_sender(std::forward<Sender>(sndr), e);
+            }
+
+        private:
+            template <typename Data, typename Child>
+            static auto make_bulk(Pool * pool, Data && data, Child && child) {
+                using shape_type = std::decay_t<decltype(data.__shape_)>;
+                using fn_type = std::decay_t<decltype(data.__fun_)>;
+                return bulk_after_sender<std::decay_t<Child>, shape_type, fn_type>(
+                    pool, std::forward<Child>(child), data.__shape_, std::forward<Data>(data).__fun_);
+            }
+        };
+#endif
+
+        /**
+         * @brief 返回一个在工作线程上完成的sender
+         */
+        sender schedule() const noexcept { return sender(this->pool); }
+
+        /**
+         * @brief 返回一个在线程池上并行执行fn(i)（i属于[0, shape)）的sender
+         *
+         * @param shape 元素数，整数类型
+         * @param fn 对每个元素调用的函数，可能在多个线程上并发调用
+         *
+         * 与stdexec::bulk(schedule(), shape, fn)相同，但不经过domain。
+         * 区间被切分为连续的块，块数等于线程数（不超过_ctplBulkMaxChunks_）；
+         * 全部完成后以set_value()完成，任一调用抛出异常则以第一个异常set_error()
+         */
+        template <typename Shape, typename Fn>
+        bulk_sender<Shape, Fn> schedule_bulk(Shape shape, Fn fn) const {
+            return bulk_sender<Shape, Fn>(this->pool, shape, std::move(fn));
+        }
+
+#if _ctplExecBulkDomain_
+        /**
+         * @brief 报告调度器的domain，stdexec::bulk据此选择并行版本
+         */
+        domain query(stdexec::get_domain_t) const noexcept { return domain(); }
+#endif
+
+        /**
+         * @brief 线程池中的任务可以并行执行
+         */
+        stdexec::forward_progress_guarantee query(stdexec::get_forward_progress_guarantee_t) const noexcept {
+            return stdexec::forward_progress_guarantee::parallel;
+        }
+
+        bool operator==(const pool_scheduler & other) const noexcept { return this->pool == other.pool; }
+        bool operator!=(const pool_scheduler & other) const noexcept { return this->pool != other.pool; }
+
+    private:
+        Pool * pool;  // 执行任务的线程池
+    };
+
+    /**
+     * @brief 获取线程池的P2300调度器
+     */
+    template <typename Pool>
+    pool_scheduler<Pool> get_scheduler(Pool & pool) noexcept {
+        return pool_scheduler<Pool>(pool);
+    }
+
+}
+
+#endif // __ctpl_exec_H__
@@ -0,0 +1,381 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 多租户加权公平调度
+*
+* 多个租户共用一个线程池时，某个租户一次提交大量任务就会占满先进先出队列，其他租户的任务只能排在后面。
+* fair_scheduler为每个租户维护独立的队列和权重，工作线程按租户已使用的执行时间选择下一个任务，
+* 因此一个租户的排队时间不受其他租户提交量的影响。
+*
+*      ctpl::fair_scheduler<ctpl::thread_pool> fs(pool);
+*      auto web = fs.add_tenant(3);        // 权重3
+*      auto batch = fs.add_tenant(1, 2);   // 权重1，最多同时执行2个任务
+*      web.push([](int id) { ... });
+*      batch.push(job, arg);
+*      ctpl::tenant_stats s = batch.stats();
+*
+* 主要功能和特点：
+* 1. 步幅调度（stride scheduling）：每个租户有一个虚拟时间，任务执行完后加上执行时间除以权重，
+*    每次选择有待执行任务且虚拟时间最小的租户；长期来看各租户得到的执行时间与权重成正比
+* 2. 租户从空闲变为有任务时，虚拟时间至少追到当前的虚拟时钟，空闲期间不会积攒额度
+* 3. 可选的并发上限：达到上限的租户暂时不参与选择，它的任务执行完后再继续
+* 4. 每个租户统计提交数、完成数、执行时间、排队时间的总和与最大值
+*
+* 线程安全考量：
+* - 租户的队列和虚拟时间由调度器的一把互斥锁保护，任务在锁外执行
+* - 与deadline_scheduler相同，调度令牌同一时刻最多在线程池队列中出现一次，pending记录还需要执行令牌的次数；
+*   令牌找不到可执行的任务（所有有任务的租户都达到并发上限）时这次执行暂存，
+*   受限租户的任务执行完后再补回pending，因此pending与暂存数之和始终等于尚未取出的任务数
+* - 调度器销毁时等待所有令牌被执行或丢弃；立即停止线程池（stop(false)）之前应先等待受限租户的任务执行完，
+*   否则执行完的任务重新提交的令牌不会再被执行
+*
+* 性能考量：
+* - 执行时间用steady_clock测量任务的墙钟时间，不是线程的CPU时间，避免每个任务两次系统调用
+* - 选择租户时线性扫描有任务的租户，适合租户数不多的情况
+*********************************************************/
+
+#ifndef __ctpl_fair_H__
+#define __ctpl_fair_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#include <algorithm>   // 用于std::max
+#include <atomic>      // 用于令牌计数
+#include <chrono>      // 用于执行时间和排队时间
+#include <cstdint>     // 用于std::uint64_t
+#include <deque>       // 用于租户的任务队列
+#include <memory>      // 用于std::unique_ptr
+#include <mutex>       // 用于保护调度状态
+#include <thread>      // 用于std::this_thread::yield
+#include <type_traits> // 用于std::decay
+#include <utility>     // 用于std::forward
+#include <vector>      // 用于租户列表
+
+namespace ctpl {
+
+    /**
+     * @brief 一个租户的统计数据
+     */
+    struct tenant_stats {
+        std::uint64_t submitted;  // 提交的任务数
+        std::uint64_t completed;  // 执行完的任务数
+        std::size_t queued;  // 正在排队的任务数
+        int running;  // 正在执行的任务数
+        std::chrono::nanoseconds cpuTime;  // 任务执行时间之和
+        std::chrono::nanoseconds totalWait;  // 已开始执行的任务的排队时间之和
+        std::chrono::nanoseconds maxWait;  // 最长排队时间
+    };
+
+    namespace detail {
+        typedef std::chrono::steady_clock fair_clock;
+
+        /**
+         * @brief 排队中的任务和入队时间
+         */
+        struct fair_item {
+            task_node * node;
+            fair_clock::time_point enqueued;
+        };
+
+        /**
+         * @brief 一个租户的调度状态，全部由调度器的互斥锁保护
+         */
+        struct tenant_state {
+            tenant_state(double weight, int maxRunning)
+                : weight(weight), maxRunning(maxRunning), vtime(0), running(0), submitted(0), completed(0),
+                  cpuTime(0), totalWait(0), maxWait(0) {}
+
+            bool eligible() const { return !this->q.empty() && (this->maxRunning <= 0 || this->running < this->maxRunning); }
+
+            double weight;  // 权重
+            int maxRunning;  // 并发上限，0表示不限
+            double vtime;  // 虚拟时间：执行时间（纳秒）除以权重的累计值
+            int running;  // 正在执行的任务数
+            std::deque<fair_item> q;  // 排队中的任务
+            std::uint64_t submitted;
+            std::uint64_t completed;
+            fair_clock::duration cpuTime;
+            fair_clock::duration totalWait;
+            fair_clock::duration maxWait;
+        };
+    }
+
+    /**
+     * @brief 多租户加权公平调度器
+     *
+     * @tparam Pool 线程池类型，需要提供post(task_node *)方法（ctpl::thread_pool即可）
+     *
+     * 调度器不可拷贝或移动，销毁时阻塞直到所有已提交的任务被执行或丢弃
+     */
+    template <typename Pool>
+    class fair_scheduler {
+
+    public:
+
+        /**
+         * @brief 租户句柄，可以拷贝，所有拷贝指向同一个租户；调度器销毁后不能再使用
+         */
+        class tenant {
+        public:
+            tenant() : s(nullptr), t(nullptr) {}
+
+            /**
+             * @brief 提交任务到此租户的队列
+             *
+             * @return future<R> 任务的结果，R与thread_pool::push()相同
+             */
+            template <typename F, typename... Rest>
+            auto push(F && f, Rest&&... rest)
+                ->future<typename detail::bound_task<typename std::decay<F>::type, typename std::decay<Rest>::type...>::result_type> {
+                typedef detail::bound_task<typename std::decay<F>::type, typename std::decay<Rest>::type...> bound_type;
+                typedef typename bound_type::result_type R;
+                typedef detail::future_task<R, bound_type> task_type;
+                task_type * _f = new task_type(std::forward<F>(f), std::forward<Rest>(rest)...);
+                future<R> fut(_f);
+                this->s->submit(*this->t, _f);
+                return fut;
+            }
+
+            template <typename F>
+            auto push(F && f) ->future<decltype(f(0))> {
+                typedef decltype(f(0)) R;
+                typedef detail::future_task<R, typename std::decay<F>::type> task_type;
+                task_type * _f = new task_type(std::forward<F>(f));
+                future<R> fut(_f);
+                this->s->submit(*this->t, _f);
+                return fut;
+            }
+
+            /**
+             * @brief 修改权重和并发上限，对之后的调度生效
+             */
+            void set_weight(double weight) { this->s->set_weight(*this->t, weight); }
+            void set_max_running(int maxRunning) { this->s->set_max_running(*this->t, maxRunning); }
+
+            tenant_stats stats() const { return this->s->stats(*this->t); }
+
+        private:
+            friend class fair_scheduler;
+            tenant(fair_scheduler * s, detail::tenant_state * t) : s(s), t(t) {}
+
+            fair_scheduler * s;
+            detail::tenant_state * t;
+        };
+
+        explicit fair_scheduler(Pool & pool) : pool(pool), vclock(0), parked(0), outstanding(0), pending(0), token(*this) {}
+
+        ~fair_scheduler() {
+            while (this->outstanding.load(std::memory_order_acquire) != 0)
+                std::this_thread::yield();  // 令牌仍在线程池的队列中，或任务仍在执行
+        }
+
+        /**
+         * @brief 添加租户
+         *
+         * @param weight 权重，必须大于0；执行时间按权重的比例分配
+         * @param maxRunning 同时执行的任务数上限，0表示不限
+         */
+        tenant add_tenant(double weight = 1.0, int maxRunning = 0) {
+            std::unique_ptr<detail::tenant_state> t(new detail::tenant_state(weight > 0 ? weight : 1.0, maxRunning));
+            std::unique_lock<std::mutex> lock(this->mutex);
+            t->vtime = this->vclock;
+            this->tenants.push_back(std::move(t));
+            return tenant(this, this->tenants.back().get());
+        }
+
+    private:
+
+        fair_scheduler(const fair_scheduler &);// = delete;
+        fair_scheduler(fair_scheduler &&);// = delete;
+        fair_scheduler & operator=(const fair_scheduler &);// = delete;
+        fair_scheduler & operator=(fair_scheduler &&);// = delete;
+
+        /**
+         * @brief 调度令牌：执行时按虚拟时间选择租户并执行它的一个任务
+         *
+         * 与deadline_scheduler的令牌相同，同一时刻最多在队列中出现一次，
+         * pending仍大于0时先重新提交自己，其他工作线程可以同时选择任务
+         */
+        struct dispatch_token : detail::task_node {
+            explicit dispatch_token(fair_scheduler & s) : s(s) {}
+
+            void run(int id) override {
+                if (this->s.pending.fetch_sub(1, std::memory_order_acq_rel) > 1)
+                    this->s.pool.post(this);  // 还有任务等待调度
+                this->s.dispatch(id);
+            }
+
+            void discard() override { this->s.drop_pending(); }
+
+            fair_scheduler & s;
+        };
+
+        void submit(detail::tenant_state & t, detail::task_node * node) {
+            detail::fair_item item = { node, detail::fair_clock::now() };
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                if (t.q.empty() && t.running == 0)
+                    t.vtime = std::max(t.vtime, this->vclock);  // 从空闲变为活跃，不积攒空闲期间的额度
+                try {
+                    t.q.push_back(item);
+                }
+                catch (...) {
+                    lock.unlock();
+                    node->discard();
+                    throw;
+                }
+                ++t.submitted;
+            }
+            this->outstanding.fetch_add(1, std::memory_order_relaxed);
+            this->schedule(1);
+        }
+
+        /**
+         * @brief 增加n次令牌执行，pending从0变为非0时令牌不在队列中，由调用者提交
+         */
+        void schedule(long n) {
+            if (n > 0 && this->pending.fetch_add(n, std::memory_order_acq_rel) == 0)
+                this->pool.post(&this->token);
+        }
+
+        /**
+         * @brief 选择有可执行任务且虚拟时间最小的租户，调用者持有mutex
+         */
+        detail::tenant_state * pick() {
+            detail::tenant_state * best = nullptr;
+            for (std::size_t i = 0; i < this->tenants.size(); ++i) {
+                detail::tenant_state * t = this->tenants[i].get();
+                if (t->eligible() && (!best || t->vtime < best->vtime))
+                    best = t;
+            }
+            return best;
+        }
+
+        void dispatch(int id) {
+            detail::tenant_state * t;
+            detail::fair_item item;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                t = this->pick();
+                if (!t) {  // 有任务的租户都达到了并发上限，这次令牌执行暂存
+                    ++this->parked;
+                    return;
+                }
+                item = t->q.front();
+                t->q.pop_front();
+                ++t->running;
+                this->vclock = std::max(this->vclock, t->vtime);
+            }
+            const detail::fair_clock::time_point start = detail::fair_clock::now();
+            item.node->run(id);
+            const detail::fair_clock::time_point end = detail::fair_clock::now();
+
+            bool repost = false;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                const detail::fair_clock::duration wait = start - item.enqueued;
+                const detail::fair_clock::duration cpu = end - start;
+                --t->running;
+                ++t->completed;
+                t->cpuTime += cpu;
+                t->totalWait += wait;
+                t->maxWait = std::max(t->maxWait, wait);
+                t->vtime += std::chrono::duration_cast<std::chrono::nanoseconds>(cpu).count() / t->weight;
+                if (this->parked > 0 && t->eligible()) {  // 空出了一个执行名额，补回一次暂存的令牌执行
+                    --this->parked;
+                    repost = true;
+                }
+            }
+            if (repost)
+                this->schedule(1);
+            this->outstanding.fetch_sub(1, std::memory_order_release);  // 此后不再访问调度器
+        }
+
+        /**
+         * @brief 令牌被线程池丢弃（线程池被立即停止）：丢弃所有等待调度的任务，不考虑并发上限；
+         *        暂存的令牌执行不会再发生，它们对应的任务也一并丢弃
+         */
+        void drop_pending() {
+            std::vector<detail::task_node *> nodes;
+            const long pending = this->pending.exchange(0, std::memory_order_acq_rel);
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                std::size_t n = static_cast<std::size_t>(pending) + this->parked;
+                this->parked = 0;
+                for (std::size_t i = 0; i < this->tenants.size() && nodes.size() < n; ++i) {
+                    detail::tenant_state & t = *this->tenants[i];
+                    while (!t.q.empty() && nodes.size() < n) {
+                        nodes.push_back(t.q.front().node);
+                        t.q.pop_front();
+                    }
+                }
+            }
+            for (std::size_t i = 0; i < nodes.size(); ++i)
+                nodes[i]->discard();
+            this->outstanding.fetch_sub(static_cast<long>(nodes.size()), std::memory_order_release);
+        }
+
+        void set_weight(detail::tenant_state & t, double weight) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            t.weight = weight > 0 ? weight : 1.0;
+        }
+
+        void set_max_running(detail::tenant_state & t, int maxRunning) {
+            int repost = 0;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                t.maxRunning = maxRunning;
+                // 放宽上限后可能有暂存的令牌执行可以补回
+                while (this->parked > 0 && repost < static_cast<int>(t.q.size()) &&
+                       (maxRunning <= 0 || t.running + repost < maxRunning)) {
+                    --this->parked;
+                    ++repost;
+                }
+            }
+            this->schedule(repost);
+        }
+
+        tenant_stats stats(detail::tenant_state & t) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            tenant_stats r;
+            r.submitted = t.submitted;
+            r.completed = t.completed;
+            r.queued = t.q.size();
+            r.running = t.running;
+            r.cpuTime = std::chrono::duration_cast<std::chrono::nanoseconds>(t.cpuTime);
+            r.totalWait = std::chrono::duration_cast<std::chrono::nanoseconds>(t.totalWait);
+            r.maxWait = std::chrono::duration_cast<std::chrono::nanoseconds>(t.maxWait);
+            return r;
+        }
+
+        Pool & pool;  // 执行任务的线程池
+        std::mutex mutex;  // 保护以下调度状态
+        std::vector<std::unique_ptr<detail::tenant_state>> tenants;  // 所有租户，地址在调度器的生命周期内不变
+        double vclock;  // 虚拟时钟：最近一次被选中的租户的虚拟时间
+        int parked;  // 暂存的令牌执行次数
+        std::atomic<long> outstanding;  // 已提交但尚未完成的任务数
+        std::atomic<long> pending;  // 还需要执行令牌的次数，大于0时令牌在队列中（或正在被重新提交）
+        dispatch_token token;  // 调度令牌
+    };
+
+}
+
+#endif // __ctpl_fair_H__
@@ -0,0 +1,394 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 轻量级future
+*
+* thread_pool::push()返回的ctpl::future<T>。与packaged_task和std::future相比：
+* 共享状态只有一个32位原子状态字，加上内联存放的结果和异常，
+* 并且和任务节点位于同一次分配中，每次push()只分配一次内存。
+*
+* 主要功能和特点：
+* 1. 接口与std::future一致：get()、wait()、wait_for()、wait_until()、valid()、share()
+* 2. 可以隐式转换为std::future<T>，原来写成 std::future<int> f = pool.push(...) 的代码不需要修改
+* 3. 完成任务只需一次原子fetch_or，不加锁；只有确实有线程在等待时才调用futex唤醒
+*
+* 状态字的布局：
+* - 低2位：结果状态（未完成、有值、有异常）
+* - 第2位：有线程在futex上等待
+* - 第3位：已转换为std::future，完成者需要把结果转交给std::promise
+* - 其余位：引用计数，任务和future各持有一个引用
+*
+* 线程安全考量：
+* - 结果在设置状态位之前写入，读者用acquire读取状态字后即可看到结果
+* - 转换为std::future时，完成者和转换者通过fetch_or的返回值确定由谁转交结果，恰好一方执行
+* - Linux上使用futex等待；其他平台在C++20下使用std::atomic::wait，否则退化为让出CPU的轮询
+*********************************************************/
+
+#ifndef __ctpl_future_H__
+#define __ctpl_future_H__
+
+#include <atomic>      // 用于状态字
+#include <chrono>      // 用于超时等待
+#include <cstdint>     // 用于std::uint32_t
+#include <exception>   // 用于std::exception_ptr
+#include <future>      // 用于转换为std::future和std::future_error
+#include <memory>      // 用于std::unique_ptr
+#include <new>         // 用于placement new
+#include <thread>      // 用于std::this_thread::yield
+#include <utility>     // 用于std::move和std::forward
+#if defined(__linux__)
+#include <climits>     // 用于INT_MAX
+#include <ctime>       // 用于timespec
+#include <linux/futex.h>  // 用于FUTEX_WAIT和FUTEX_WAKE
+#include <sys/syscall.h>  // 用于SYS_futex
+#include <unistd.h>    // 用于syscall
+#endif
+
+#ifndef _ctplFutureSpin_
+#define _ctplFutureSpin_  64  // 进入futex等待之前的自旋次数，结果通常很快就绪
+#endif
+
+namespace ctpl {
+
+    template <typename T>
+    class future;
+
+    namespace detail {
+
+        // 状态字各位的含义
+        const std::uint32_t fs_pending = 0;  // 未完成
+        const std::uint32_t fs_value = 1;  // 有值
+        const std::uint32_t fs_error = 2;  // 有异常
+        const std::uint32_t fs_status = 3;  // 结果状态的掩码
+        const std::uint32_t fs_waiters = 4;  // 有线程在等待
+        const std::uint32_t fs_linked = 8;  // 已转换为std::future
+        const std::uint32_t fs_ref = 16;  // 一个引用
+
+        /**
+         * @brief 在状态字仍等于expected时阻塞，可能被虚假唤醒
+         *
+         * @param timeout 相对超时，nullptr表示不超时
+         */
+        inline void state_wait(std::atomic<std::uint32_t> & word, std::uint32_t expected, const std::chrono::nanoseconds * timeout) {
+#if defined(__linux__)
+            timespec ts;
+            timespec * pts = nullptr;
+            if (timeout) {
+                ts.tv_sec = static_cast<time_t>(timeout->count() / 1000000000);
+                ts.tv_nsec = static_cast<long>(timeout->count() % 1000000000);
+                pts = &ts;
+            }
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected, pts, nullptr, 0);
+#elif defined(__cpp_lib_atomic_wait) && __cpp_lib_atomic_wait >= 201907L
+            if (!timeout)
+                word.wait(expected, std::memory_order_acquire);
+            else
+                std::this_thread::yield();
+#else
+            (void)word;
+            (void)expected;
+            (void)timeout;
+            std::this_thread::yield();
+#endif
+        }
+
+        /**
+         * @brief 唤醒所有在状态字上等待的线程
+         */
+        inline void state_wake_all(std::atomic<std::uint32_t> & word) {
+#if defined(__linux__)
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#elif defined(__cpp_lib_atomic_wait) && __cpp_lib_atomic_wait >= 201907L
+            word.notify_all();
+#else
+            (void)word;
+#endif
+        }
+
+        /**
+         * @brief 内联存放的结果
+         */
+        template <typename T>
+        class future_value {
+        public:
+            template <typename U>
+            void set(U && v) { new (&this->storage) T(std::forward<U>(v)); }
+            T take() { return std::move(*this->ptr()); }
+            void destroy() { this->ptr()->~T(); }
+            void fulfill(std::promise<T> & p) { p.set_value(std::move(*this->ptr())); }
+
+        private:
+            T * ptr() { return reinterpret_cast<T *>(&this->storage); }
+
+            alignas(T) unsigned char storage[sizeof(T)];  // set()之后存放结果
+        };
+
+        template <typename T>
+        class future_value<T &> {
+        public:
+            void set(T & v) { this->p = &v; }
+            T & take() { return *this->p; }
+            void destroy() {}
+            void fulfill(std::promise<T &> & pr) { pr.set_value(*this->p); }
+
+        private:
+            T * p;
+        };
+
+        template <>
+        class future_value<void> {
+        public:
+            void set() {}
+            void take() {}
+            void destroy() {}
+            void fulfill(std::promise<void> & p) { p.set_value(); }
+        };
+
+        /**
+         * @brief future的共享状态，由任务节点继承，和任务位于同一次分配中
+         */
+        template <typename T>
+        class future_state {
+        public:
+            future_state() : word(2 * fs_ref), linked(nullptr) {}  // 任务和future各一个引用
+
+            /**
+             * @brief 设置结果并唤醒等待者，只调用一次
+             */
+            template <typename... U>
+            void set_value(U &&... v) {
+                this->value.set(std::forward<U>(v)...);
+                this->complete(fs_value);
+            }
+
+            void set_exception(std::exception_ptr e) {
+                this->error = std::move(e);
+                this->complete(fs_error);
+            }
+
+            /**
+             * @brief 释放一个引用，最后一个引用释放时销毁结果和整个对象
+             */
+            void release() {
+                std::uint32_t old = this->word.fetch_sub(fs_ref, std::memory_order_acq_rel);
+                if (old / fs_ref != 1)
+                    return;
+                if ((old & fs_status) == fs_value && !(old & fs_linked))
+                    this->value.destroy();
+                this->destroy();
+            }
+
+            bool is_ready() const { return (this->word.load(std::memory_order_acquire) & fs_status) != fs_pending; }
+
+            /**
+             * @brief 阻塞直到结果就绪
+             */
+            void wait() {
+                std::uint32_t w = this->word.load(std::memory_order_acquire);
+                for (int i = 0; i < _ctplFutureSpin_ && !(w & fs_status); ++i)
+                    w = this->word.load(std::memory_order_acquire);
+                while (!(w & fs_status)) {
+                    if (!(w & fs_waiters)) {
+                        if (!this->word.compare_exchange_weak(w, w | fs_waiters, std::memory_order_acquire))
+                            continue;
+                        w |= fs_waiters;
+                    }
+                    state_wait(this->word, w, nullptr);
+                    w = this->word.load(std::memory_order_acquire);
+                }
+            }
+
+            /**
+             * @brief 阻塞直到结果就绪或超过deadline
+             */
+            template <typename Clock, typename Duration>
+            bool wait_until(const std::chrono::time_point<Clock, Duration> & deadline) {
+                std::uint32_t w = this->word.load(std::memory_order_acquire);
+                while (!(w & fs_status)) {
+                    typename Clock::time_point now = Clock::now();
+                    if (now >= deadline)
+                        return false;
+                    if (!(w & fs_waiters)) {
+                        if (!this->word.compare_exchange_weak(w, w | fs_waiters, std::memory_order_acquire))
+                            continue;
+                        w |= fs_waiters;
+                    }
+                    std::chrono::nanoseconds left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+                    state_wait(this->word, w, &left);
+                    w = this->word.load(std::memory_order_acquire);
+                }
+                return true;
+            }
+
+            /**
+             * @brief 取出结果，结果为异常时重新抛出；调用前结果必须已经就绪
+             */
+            T take() {
+                if ((this->word.load(std::memory_order_acquire) & fs_status) == fs_error)
+                    std::rethrow_exception(this->error);
+                return this->value.take();
+            }
+
+            /**
+             * @brief 把结果转交给一个std::promise，返回对应的std::future
+             */
+            std::future<T> link() {
+                std::unique_ptr<std::promise<T>> p(new std::promise<T>());
+                std::future<T> f = p->get_future();
+                this->linked = p.release();
+                if (this->word.fetch_or(fs_linked, std::memory_order_acq_rel) & fs_status)
+                    this->fulfill();  // 结果已经就绪，完成者没有看到fs_linked，由转换者转交
+                return f;
+            }
+
+        protected:
+            virtual ~future_state() {}
+            virtual void destroy() = 0;  // 销毁包含共享状态的整个对象
+
+        private:
+            void complete(std::uint32_t status) {
+                std::uint32_t old = this->word.fetch_or(status, std::memory_order_acq_rel);
+                if (old & fs_linked)
+                    this->fulfill();
+                if (old & fs_waiters)
+                    state_wake_all(this->word);
+            }
+
+            void fulfill() {
+                std::unique_ptr<std::promise<T>> p(this->linked);
+                if ((this->word.load(std::memory_order_acquire) & fs_status) == fs_error)
+                    p->set_exception(this->error);
+                else {
+                    this->value.fulfill(*p);
+                    this->value.destroy();
+                }
+            }
+
+            std::atomic<std::uint32_t> word;  // 状态字
+            future_value<T> value;  // 结果
+            std::exception_ptr error;  // 异常
+            std::promise<T> * linked;  // 转换为std::future时的promise
+        };
+
+        /**
+         * @brief 调用任务并把结果或异常写入共享状态
+         */
+        template <typename T>
+        struct future_invoker {
+            template <typename F, typename... Args>
+            static void run(future_state<T> & s, F & f, Args &&... args) {
+                s.set_value(f(std::forward<Args>(args)...));
+            }
+        };
+
+        template <>
+        struct future_invoker<void> {
+            template <typename F, typename... Args>
+            static void run(future_state<void> & s, F & f, Args &&... args) {
+                f(std::forward<Args>(args)...);
+                s.set_value();
+            }
+        };
+    }
+
+    /**
+     * @brief thread_pool::push()返回的future
+     *
+     * 只能移动，不能拷贝；get()只能调用一次。
+     * 销毁一个尚未完成的future不会阻塞，任务仍会执行，结果被丢弃
+     */
+    template <typename T>
+    class future {
+    public:
+        future() noexcept : st(nullptr) {}
+        explicit future(detail::future_state<T> * st) noexcept : st(st) {}
+        future(future && other) noexcept : st(other.st) { other.st = nullptr; }
+
+        future & operator=(future && other) noexcept {
+            if (this != &other) {
+                if (this->st)
+                    this->st->release();
+                this->st = other.st;
+                other.st = nullptr;
+            }
+            return *this;
+        }
+
+        ~future() {
+            if (this->st)
+                this->st->release();
+        }
+
+        /**
+         * @brief 是否关联了共享状态
+         */
+        bool valid() const noexcept { return this->st != nullptr; }
+
+        /**
+         * @brief 结果是否已经就绪（不阻塞）
+         */
+        bool is_ready() const { return this->state().is_ready(); }
+
+        void wait() const { this->state().wait(); }
+
+        template <typename Rep, typename Period>
+        std::future_status wait_for(const std::chrono::duration<Rep, Period> & d) const {
+            return this->wait_until(std::chrono::steady_clock::now() + d);
+        }
+
+        template <typename Clock, typename Duration>
+        std::future_status wait_until(const std::chrono::time_point<Clock, Duration> & deadline) const {
+            return this->state().wait_until(deadline) ? std::future_status::ready : std::future_status::timeout;
+        }
+
+        /**
+         * @brief 等待并取出结果，任务抛出的异常在这里重新抛出；之后future不再有效
+         */
+        T get() {
+            this->state().wait();
+            future tmp(std::move(*this));  // 返回时释放引用
+            return tmp.st->take();
+        }
+
+        /**
+         * @brief 转换为std::future，之后此future不再有效
+         */
+        operator std::future<T>() && {
+            future tmp(std::move(*this));
+            return tmp.state().link();
+        }
+
+        std::shared_future<T> share() { return std::future<T>(std::move(*this)).share(); }
+
+    private:
+        future(const future &);// = delete;
+        future & operator=(const future &);// = delete;
+
+        detail::future_state<T> & state() const {
+            if (!this->st)
+                throw std::future_error(std::future_errc::no_state);
+            return *this->st;
+        }
+
+        detail::future_state<T> * st;  // 共享状态，与任务节点位于同一个对象中
+    };
+
+}
+
+#endif // __ctpl_future_H__
@@ -0,0 +1,599 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 异步文件I/O (io_context)
+*
+* 工作线程阻塞在read()/pwrite()上时不占用CPU，却占用了线程池的线程，只能靠resize()多开线程。
+* io_context把读写请求提交给内核的io_uring，请求完成后把续体提交到线程池执行，
+* 或者直接完成返回的future，工作线程不再阻塞在磁盘I/O上。
+*
+*      ctpl::io_context<ctpl::thread_pool> io(pool);
+*      io.async_read(fd, buf, 4096, offset, [](int id, long n) { ... });  // n为字节数或-errno
+*      ctpl::future<long> w = io.async_write(fd, data, len, 0);
+*
+* 主要功能和特点：
+* 1. 直接使用io_uring的系统调用，不依赖liburing；一个完成线程等待完成队列，
+*    续体提交到线程池执行，future在完成线程上直接完成
+* 2. 注册缓冲区：register_buffers()之后，async_read_fixed()/async_write_fixed()使用已注册的缓冲区，
+*    内核不需要每次映射用户页面
+* 3. io_uring不可用时（内核太旧、被seccomp禁止、非Linux平台）自动退化为若干个执行pread()/pwrite()的线程，
+*    接口和结果的含义不变
+* 4. 结果与io_uring一致：成功时为传输的字节数（可能少于请求的长度），失败时为-errno
+*
+* 线程安全考量：
+* - 提交由一把互斥锁保护，可以在任意线程（包括工作线程）上调用
+* - 同时进行的请求数不超过完成队列的容量，超过时提交者阻塞，保证完成事件不会溢出
+* - 续体抛出的异常会被丢弃，与channel的续体一致；线程池在续体执行前被立即停止时续体被直接释放而不调用
+* - io_context销毁时等待所有请求完成
+*
+* 性能考量：
+* - 每次提交调用一次io_uring_enter；完成线程每次唤醒处理所有已完成的事件
+* - 请求节点从每线程缓存中分配，续体节点同时是线程池的任务节点，每个请求只有一次分配
+*********************************************************/
+
+#ifndef __ctpl_io_H__
+#define __ctpl_io_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#include <algorithm>   // 用于std::max
+#include <cerrno>      // 用于errno
+#include <condition_variable>  // 用于等待完成和回退线程
+#include <cstring>     // 用于std::memset
+#include <deque>       // 用于回退线程的请求队列
+#include <memory>      // 用于std::unique_ptr
+#include <mutex>       // 用于保护提交
+#include <thread>      // 用于完成线程和回退线程
+#include <type_traits> // 用于std::decay
+#include <utility>     // 用于std::forward
+#include <vector>      // 用于回退线程
+#include <sys/uio.h>   // 用于iovec
+#include <unistd.h>    // 用于pread和pwrite
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define _ctplHasIoUring_ 1
+#include <linux/io_uring.h>  // 用于io_uring的结构和常量
+#include <sys/mman.h>  // 用于映射提交队列和完成队列
+#include <sys/syscall.h>  // 用于io_uring的系统调用号
+#endif
+#endif
+
+#ifndef _ctplIoEntries_
+#define _ctplIoEntries_  256  // io_uring提交队列的大小
+#endif
+
+#ifndef _ctplIoFallbackThreads_
+#define _ctplIoFallbackThreads_  4  // io_uring不可用时执行阻塞I/O的线程数
+#endif
+
+namespace ctpl {
+
+    namespace detail {
+
+        enum class io_opcode { read, write, read_fixed, write_fixed, nop };
+
+        /**
+         * @brief 一个I/O请求，完成时调用complete()，此后不再访问该请求
+         */
+        struct io_op {
+            virtual void complete(long res) = 0;
+
+            io_opcode opcode;
+            int fd;
+            void * buf;
+            unsigned len;
+            unsigned long long offset;
+            int bufIndex;  // 已注册缓冲区的序号，仅用于read_fixed和write_fixed
+        };
+
+        /**
+         * @brief 完成时把续体 f(int id, long res) 提交到线程池的请求
+         */
+        template <typename Pool, typename F>
+        struct io_callback_op : io_op, task_node {
+            template <typename U>
+            io_callback_op(Pool & pool, U && f) : pool(pool), f(std::forward<U>(f)), res(0) {}
+
+            void complete(long r) override {
+                this->res = r;
+                this->pool.post(this);
+            }
+
+            void run(int id) override {
+                std::unique_ptr<io_callback_op> self(this);  // 执行后释放节点
+                try {
+                    this->f(id, this->res);
+                }
+                catch (...) {
+                }
+            }
+
+            void discard() override { delete this; }
+
+            static void * operator new(std::size_t size) { return cache_allocate(size); }
+            static void operator delete(void * p) noexcept { cache_deallocate(p); }
+
+            Pool & pool;
+            F f;  // 续体
+            long res;  // 结果
+        };
+
+        /**
+         * @brief 完成时直接设置future结果的请求，不经过线程池
+         */
+        struct io_future_op : io_op, future_state<long> {
+            void complete(long r) override {
+                this->set_value(r);
+                this->release();
+            }
+
+            void destroy() override { delete this; }
+
+            static void * operator new(std::size_t size) { return cache_allocate(size); }
+            static void operator delete(void * p) noexcept { cache_deallocate(p); }
+        };
+
+        /**
+         * @brief 用pread()/pwrite()同步执行一个请求，返回字节数或-errno
+         */
+        inline long io_perform(const io_op & op) {
+            ssize_t r = 0;
+            switch (op.opcode) {
+            case io_opcode::read:
+            case io_opcode::read_fixed:
+                r = ::pread(op.fd, op.buf, op.len, static_cast<off_t>(op.offset));
+                break;
+            case io_opcode::write:
+            case io_opcode::write_fixed:
+                r = ::pwrite(op.fd, op.buf, op.len, static_cast<off_t>(op.offset));
+                break;
+            case io_opcode::nop:
+                break;
+            }
+            return r < 0 ? -static_cast<long>(errno) : static_cast<long>(r);
+        }
+
+#if defined(_ctplHasIoUring_)
+        /**
+         * @brief 映射到用户空间的io_uring提交队列和完成队列
+         */
+        class io_ring {
+        public:
+            io_ring() : fd(-1), sqPtr(MAP_FAILED), cqPtr(MAP_FAILED), sqes(static_cast<io_uring_sqe *>(MAP_FAILED)),
+                sqLen(0), cqLen(0), sqesLen(0) {}
+
+            ~io_ring() {
+                if (this->sqes != MAP_FAILED)
+                    ::munmap(this->sqes, this->sqesLen);
+                if (this->cqPtr != MAP_FAILED && this->cqPtr != this->sqPtr)
+                    ::munmap(this->cqPtr, this->cqLen);
+                if (this->sqPtr != MAP_FAILED)
+                    ::munmap(this->sqPtr, this->sqLen);
+                if (this->fd >= 0)
+                    ::close(this->fd);
+            }
+
+            /**
+             * @brief 创建io_uring，失败时返回false（例如内核不支持或被seccomp禁止）
+             */
+            bool init(unsigned entries) {
+                io_uring_params p;
+                std::memset(&p, 0, sizeof(p));
+                this->fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+                if (this->fd < 0)
+                    return false;
+
+                this->sqLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+                this->cqLen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+                const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;  // 两个队列共用一次映射
+                if (single)
+                    this->sqLen = this->cqLen = std::max(this->sqLen, this->cqLen);
+                this->sqPtr = ::mmap(nullptr, this->sqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->fd, IORING_OFF_SQ_RING);
+                if (this->sqPtr == MAP_FAILED)
+                    return false;
+                this->cqPtr = single ? this->sqPtr
+                    : ::mmap(nullptr, this->cqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->fd, IORING_OFF_CQ_RING);
+                if (this->cqPtr == MAP_FAILED)
+                    return false;
+                this->sqesLen = p.sq_entries * sizeof(io_uring_sqe);
+                this->sqes = static_cast<io_uring_sqe *>(::mmap(nullptr, this->sqesLen, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, this->fd, IORING_OFF_SQES));
+                if (this->sqes == MAP_FAILED)
+                    return false;
+
+                char * sq = static_cast<char *>(this->sqPtr);
+                char * cq = static_cast<char *>(this->cqPtr);
+                this->sqHead = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+                this->sqTail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+                this->sqMask = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+                this->sqArray = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+                this->sqEntries = p.sq_entries;
+                this->cqHead = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+                this->cqTail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+                this->cqMask = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+                this->cqes = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+                this->cqEntries = p.cq_entries;
+                return true;
+            }
+
+            /**
+             * @brief 把请求放入提交队列并提交给内核，调用者持有提交锁
+             *
+             * 每次都立即提交，因此提交队列中最多只有一项，不会满
+             *
+             * @return 内核拒绝请求时返回-errno，请求没有被提交；否则返回0
+             */
+            long submit(io_op * op) {
+                unsigned tail = *this->sqTail;
+                unsigned idx = tail & this->sqMask;
+                io_uring_sqe & sqe = this->sqes[idx];
+                std::memset(&sqe, 0, sizeof(sqe));
+                switch (op->opcode) {
+                case io_opcode::read: sqe.opcode = IORING_OP_READ; break;
+                case io_opcode::write: sqe.opcode = IORING_OP_WRITE; break;
+                case io_opcode::read_fixed: sqe.opcode = IORING_OP_READ_FIXED; break;
+                case io_opcode::write_fixed: sqe.opcode = IORING_OP_WRITE_FIXED; break;
+                case io_opcode::nop: sqe.opcode = IORING_OP_NOP; break;
+                }
+                sqe.fd = op->fd;
+                sqe.addr = reinterpret_cast<unsigned long long>(op->buf);
+                sqe.len = op->len;
+                sqe.off = op->offset;
+                sqe.buf_index = static_cast<unsigned short>(op->bufIndex);
+                sqe.user_data = reinterpret_cast<unsigned long long>(op);
+                this->sqArray[idx] = idx;
+                __atomic_store_n(this->sqTail, tail + 1, __ATOMIC_RELEASE);  // 内核看到新的尾部时sqe已经写好
+                while (true) {
+                    long r = ::syscall(__NR_io_uring_enter, this->fd, 1, 0, 0, nullptr, 0);
+                    if (r >= 1)
+                        return 0;
+                    if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                        __atomic_store_n(this->sqTail, tail, __ATOMIC_RELEASE);  // 撤回这一项
+                        return -static_cast<long>(errno);
+                    }
+                    std::this_thread::yield();
+                }
+            }
+
+            /**
+             * @brief 阻塞直到至少有一个完成事件，对每个事件调用h(user_data, res)，返回处理的事件数
+             */
+            template <typename H>
+            unsigned reap(H & h) {
+                unsigned head = *this->cqHead;
+                if (head == __atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE))
+                    ::syscall(__NR_io_uring_enter, this->fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                unsigned tail = __atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE);
+                unsigned n = 0;
+                for (; head != tail; ++head, ++n) {
+                    const io_uring_cqe & cqe = this->cqes[head & this->cqMask];
+                    h(cqe.user_data, static_cast<long>(cqe.res));
+                }
+                __atomic_store_n(this->cqHead, head, __ATOMIC_RELEASE);  // 归还完成队列的空间
+                return n;
+            }
+
+            bool register_buffers(const iovec * iov, unsigned n) {
+                return ::syscall(__NR_io_uring_register, this->fd, IORING_REGISTER_BUFFERS, iov, n) == 0;
+            }
+
+            bool unregister_buffers() {
+                return ::syscall(__NR_io_uring_register, this->fd, IORING_UNREGISTER_BUFFERS, nullptr, 0) == 0;
+            }
+
+            unsigned capacity() const { return this->cqEntries; }
+
+        private:
+            io_ring(const io_ring &);// = delete;
+            io_ring & operator=(const io_ring &);// = delete;
+
+            int fd;  // io_uring的文件描述符
+            void * sqPtr;  // 提交队列的映射
+            void * cqPtr;  // 完成队列的映射，与提交队列共用一次映射时等于sqPtr
+            io_uring_sqe * sqes;  // 提交队列项数组
+            std::size_t sqLen, cqLen, sqesLen;  // 各映射的长度
+            unsigned * sqHead;
+            unsigned * sqTail;
+            unsigned sqMask;
+            unsigned * sqArray;
+            unsigned sqEntries;
+            unsigned * cqHead;
+            unsigned * cqTail;
+            unsigned cqMask;
+            io_uring_cqe * cqes;
+            unsigned cqEntries;
+        };
+#endif
+    }
+
+    /**
+     * @brief 异步文件I/O，完成后在线程池上执行续体
+     *
+     * @tparam Pool 线程池类型，需要提供post(task_node *)方法（ctpl::thread_pool即可）
+     *
+     * 请求使用的缓冲区在请求完成之前必须保持有效。
+     * io_context不可拷贝或移动，销毁时阻塞直到所有请求完成，线程池应比它活得更久
+     */
+    template <typename Pool>
+    class io_context {
+
+    public:
+
+        /**
+         * @brief 构造函数
+         *
+         * @param pool 执行续体的线程池
+         * @param entries io_uring提交队列的大小，同时进行的请求数上限约为它的两倍
+         * @param useUring 为false时不尝试io_uring，直接使用回退线程
+         */
+        explicit io_context(Pool & pool, unsigned entries = _ctplIoEntries_, bool useUring = true)
+            : pool(pool), uring(false), inflight(0), capacity(entries * 2), stopping(false) {
+#if defined(_ctplHasIoUring_)
+            if (useUring) {
+                std::unique_ptr<detail::io_ring> r(new detail::io_ring());
+                if (r->init(entries)) {
+                    this->ring = std::move(r);
+                    this->uring = true;
+                    this->capacity = this->ring->capacity();
+                    this->reaper = std::thread([this]() { this->reap_loop(); });
+                }
+            }
+#else
+            (void)useUring;
+#endif
+            if (!this->uring) {
+                for (int i = 0; i < _ctplIoFallbackThreads_; ++i)
+                    this->fallbackThreads.emplace_back([this]() { this->fallback_loop(); });
+            }
+        }
+
+        ~io_context() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->notFull.wait(lock, [this]() { return this->inflight == 0; });  // 等待所有请求完成
+            this->stopping = true;
+            lock.unlock();
+#if defined(_ctplHasIoUring_)
+            if (this->uring) {
+                this->stopOp.opcode = detail::io_opcode::nop;  // 唤醒完成线程
+                this->stopOp.fd = -1;
+                this->stopOp.buf = nullptr;
+                this->stopOp.len = 0;
+                this->stopOp.offset = 0;
+                this->stopOp.bufIndex = 0;
+                {
+                    std::unique_lock<std::mutex> l(this->mutex);
+                    this->ring->submit(&this->stopOp);
+                }
+                this->reaper.join();
+            }
+#endif
+            this->fallbackCv.notify_all();
+            for (std::size_t i = 0; i < this->fallbackThreads.size(); ++i)
+                this->fallbackThreads[i].join();
+        }
+
+        /**
+         * @brief 是否在使用io_uring（否则使用回退线程）
+         */
+        bool is_uring() const { return this->uring; }
+
+        /**
+         * @brief 从fd的offset处读取最多len字节到buf，完成后在线程池上执行f(int id, long res)
+         */
+        template <typename F>
+        void async_read(int fd, void * buf, unsigned len, unsigned long long offset, F && f) {
+            this->submit(this->make_callback(std::forward<F>(f)), detail::io_opcode::read, fd, buf, len, offset, 0);
+        }
+
+        /**
+         * @brief 从fd的offset处读取最多len字节到buf
+         *
+         * @return future<long> 读取的字节数或-errno；future在完成线程上直接完成，不占用线程池
+         */
+        future<long> async_read(int fd, void * buf, unsigned len, unsigned long long offset) {
+            detail::io_future_op * op = new detail::io_future_op();
+            future<long> fut(op);
+            this->submit(op, detail::io_opcode::read, fd, buf, len, offset, 0);
+            return fut;
+        }
+
+        template <typename F>
+        void async_write(int fd, const void * buf, unsigned len, unsigned long long offset, F && f) {
+            this->submit(this->make_callback(std::forward<F>(f)), detail::io_opcode::write, fd, const_cast<void *>(buf), len, offset, 0);
+        }
+
+        future<long> async_write(int fd, const void * buf, unsigned len, unsigned long long offset) {
+            detail::io_future_op * op = new detail::io_future_op();
+            future<long> fut(op);
+            this->submit(op, detail::io_opcode::write, fd, const_cast<void *>(buf), len, offset, 0);
+            return fut;
+        }
+
+        /**
+         * @brief 注册缓冲区，之后可以用async_read_fixed()/async_write_fixed()读写这些缓冲区
+         *
+         * @return bool 是否成功；回退模式下总是成功，固定缓冲区的请求与普通请求相同
+         *
+         * 再次注册前需要先unregister_buffers()
+         */
+        bool register_buffers(const iovec * iov, unsigned n) {
+#if defined(_ctplHasIoUring_)
+            if (this->uring)
+                return this->ring->register_buffers(iov, n);
+#endif
+            (void)iov;
+            (void)n;
+            return true;
+        }
+
+        bool unregister_buffers() {
+#if defined(_ctplHasIoUring_)
+            if (this->uring)
+                return this->ring->unregister_buffers();
+#endif
+            return true;
+        }
+
+        /**
+         * @brief 读取到第bufIndex个已注册的缓冲区中，buf必须位于该缓冲区内
+         */
+        template <typename F>
+        void async_read_fixed(int fd, int bufIndex, void * buf, unsigned len, unsigned long long offset, F && f) {
+            this->submit(this->make_callback(std::forward<F>(f)), detail::io_opcode::read_fixed, fd, buf, len, offset, bufIndex);
+        }
+
+        future<long> async_read_fixed(int fd, int bufIndex, void * buf, unsigned len, unsigned long long offset) {
+            detail::io_future_op * op = new detail::io_future_op();
+            future<long> fut(op);
+            this->submit(op, detail::io_opcode::read_fixed, fd, buf, len, offset, bufIndex);
+            return fut;
+        }
+
+        template <typename F>
+        void async_write_fixed(int fd, int bufIndex, const void * buf, unsigned len, unsigned long long offset, F && f) {
+            this->submit(this->make_callback(std::forward<F>(f)), detail::io_opcode::write_fixed, fd, const_cast<void *>(buf), len, offset, bufIndex);
+        }
+
+        future<long> async_write_fixed(int fd, int bufIndex, const void * buf, unsigned len, unsigned long long offset) {
+            detail::io_future_op * op = new detail::io_future_op();
+            future<long> fut(op);
+            this->submit(op, detail::io_opcode::write_fixed, fd, const_cast<void *>(buf), len, offset, bufIndex);
+            return fut;
+        }
+
+    private:
+
+        io_context(const io_context &);// = delete;
+        io_context(io_context &&);// = delete;
+        io_context & operator=(const io_context &);// = delete;
+        io_context & operator=(io_context &&);// = delete;
+
+        template <typename F>
+        detail::io_op * make_callback(F && f) {
+            return new detail::io_callback_op<Pool, typename std::decay<F>::type>(this->pool, std::forward<F>(f));
+        }
+
+        /**
+         * @brief 填写请求并提交；同时进行的请求数达到上限时阻塞
+         */
+        void submit(detail::io_op * op, detail::io_opcode opcode, int fd, void * buf, unsigned len,
+                    unsigned long long offset, int bufIndex) {
+            op->opcode = opcode;
+            op->fd = fd;
+            op->buf = buf;
+            op->len = len;
+            op->offset = offset;
+            op->bufIndex = bufIndex;
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->notFull.wait(lock, [this]() { return this->inflight < this->capacity; });
+            ++this->inflight;
+#if defined(_ctplHasIoUring_)
+            if (this->uring) {
+                long err = this->ring->submit(op);
+                if (err) {  // 内核拒绝了请求，直接以错误完成
+                    --this->inflight;
+                    lock.unlock();
+                    op->complete(err);
+                }
+                return;
+            }
+#endif
+            this->pending.push_back(op);
+            lock.unlock();
+            this->fallbackCv.notify_one();
+        }
+
+        /**
+         * @brief 请求完成后减少计数，唤醒等待空位的提交者和析构函数
+         */
+        void finished(unsigned n) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->inflight -= n;
+            this->notFull.notify_all();
+        }
+
+#if defined(_ctplHasIoUring_)
+        /**
+         * @brief 完成线程：等待完成事件，完成对应的请求
+         */
+        void reap_loop() {
+            bool stop = false;
+            unsigned done = 0;
+            auto h = [this, &stop, &done](unsigned long long userData, long res) {
+                detail::io_op * op = reinterpret_cast<detail::io_op *>(userData);
+                if (op == &this->stopOp)
+                    stop = true;  // 停止请求不计入inflight
+                else {
+                    op->complete(res);
+                    ++done;
+                }
+            };
+            while (!stop) {
+                done = 0;
+                this->ring->reap(h);
+                if (done)
+                    this->finished(done);
+            }
+        }
+#endif
+
+        /**
+         * @brief 回退线程：从队列中取出请求，同步执行
+         */
+        void fallback_loop() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (true) {
+                this->fallbackCv.wait(lock, [this]() { return !this->pending.empty() || this->stopping; });
+                if (this->pending.empty())
+                    return;
+                detail::io_op * op = this->pending.front();
+                this->pending.pop_front();
+                lock.unlock();
+                op->complete(detail::io_perform(*op));
+                lock.lock();
+                --this->inflight;
+                this->notFull.notify_all();
+            }
+        }
+
+        Pool & pool;  // 执行续体的线程池
+        bool uring;  // 是否在使用io_uring
+        std::mutex mutex;  // 保护提交、inflight和回退队列
+        std::condition_variable notFull;  // 通知请求完成
+        unsigned inflight;  // 已提交但尚未完成的请求数
+        unsigned capacity;  // 同时进行的请求数上限
+        bool stopping;  // 正在销毁
+#if defined(_ctplHasIoUring_)
+        std::unique_ptr<detail::io_ring> ring;  // io_uring
+        std::thread reaper;  // 完成线程
+        struct stop_op : detail::io_op {
+            void complete(long) override {}
+        } stopOp;  // 销毁时用来唤醒完成线程的空请求
+#endif
+        std::deque<detail::io_op *> pending;  // 回退模式下等待执行的请求
+        std::condition_variable fallbackCv;  // 通知回退线程
+        std::vector<std::thread> fallbackThreads;  // 回退线程
+    };
+
+}
+
+#endif // __ctpl_io_H__
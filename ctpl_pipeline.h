@@ -0,0 +1,570 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 流水线 (pipeline)
+*
+* 把"读取 → 解析 → 变换 → 写出"这类多阶段处理组织成流水线，在已有的thread_pool上执行：
+*
+*      auto f = ctpl::make_filter<void, std::string>(ctpl::filter_mode::serial_in_order,
+*                   [&](int id, ctpl::flow_control & fc) { std::string s; if (!std::getline(in, s)) fc.stop(); return s; })
+*             & ctpl::make_filter<std::string, std::string>(ctpl::filter_mode::parallel,
+*                   [](int id, std::string s) { return compress(s); })
+*             & ctpl::make_filter<std::string, void>(ctpl::filter_mode::serial_in_order,
+*                   [&](int id, std::string s) { out << s; });
+*      ctpl::parallel_pipeline(pool, 16, f);
+*
+* 主要功能和特点：
+* 1. 三种阶段：parallel（可并行处理多个数据项）、serial_in_order（串行且按输入顺序处理）、
+*    serial_out_of_order（串行但不保证顺序）；第一个阶段（数据源）总是串行执行
+* 2. 同时在流水线中的数据项数不超过maxTokens，相当于阶段之间有界的缓冲区，
+*    数据源不会无限制地领先于慢速阶段
+* 3. 每个数据项由一个令牌(token)承载，令牌本身就是线程池的任务节点，
+*    数据直接构造在令牌内部的缓冲区中；pipeline对象可以反复run()，稳定运行时不分配内存
+* 4. 任一阶段抛出异常后，数据源停止产生新数据，已在流水线中的数据项被丢弃，
+*    run()在所有令牌回收后重新抛出第一个异常
+*
+* 线程安全考量：
+* - 每个串行阶段有自己的互斥锁，只保护"是否正在执行"标志和等待的令牌链表，阶段函数在锁外执行
+* - 一个令牌离开串行阶段时，把等待该阶段的下一个令牌直接交给线程池，不会有令牌被遗忘
+* - run()阻塞调用线程直到流水线结束，不能在同一线程池的工作线程中调用，否则可能死锁
+*********************************************************/
+
+#ifndef __ctpl_pipeline_H__
+#define __ctpl_pipeline_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#include <algorithm>   // 用于std::max
+#include <atomic>      // 用于失败标志
+#include <condition_variable>  // 用于run()阻塞等待
+#include <cstddef>     // 用于std::size_t和std::max_align_t
+#include <exception>   // 用于std::exception_ptr
+#include <memory>      // 用于智能指针管理阶段和缓冲区
+#include <mutex>       // 用于互斥锁
+#include <new>         // 用于placement new
+#include <stdexcept>   // 用于std::runtime_error
+#include <utility>     // 用于std::move
+#include <vector>      // 用于存储阶段和令牌
+
+namespace ctpl {
+
+    /**
+     * @brief 流水线阶段的执行方式
+     */
+    enum class filter_mode {
+        parallel,             // 可以同时处理多个数据项
+        serial_in_order,      // 一次处理一个数据项，按数据源产生的顺序
+        serial_out_of_order   // 一次处理一个数据项，按到达的顺序
+    };
+
+    /**
+     * @brief 数据源阶段用来通知流水线没有更多数据
+     */
+    class flow_control {
+    public:
+        flow_control() : stopped(false) {}
+
+        /**
+         * @brief 结束数据源，本次调用的返回值会被丢弃
+         */
+        void stop() { this->stopped = true; }
+
+        bool is_stopped() const { return this->stopped; }
+
+    private:
+        bool stopped;
+    };
+
+    namespace detail {
+        /**
+         * @brief 类型擦除的流水线阶段
+         *
+         * 输入和输出都存放在令牌的缓冲区中：run()总是销毁输入，正常返回时构造输出
+         */
+        struct pipeline_stage {
+            pipeline_stage(filter_mode mode, std::size_t outSize) : mode(mode), outSize(outSize) {}
+            virtual ~pipeline_stage() {}
+
+            virtual void run(int id, void * in, void * out, flow_control & fc) = 0;
+            virtual void destroy_in(void * in) = 0;  // 不执行阶段函数，只销毁输入
+            virtual void destroy_out(void * out) = 0;  // 销毁输出，用于丢弃数据源在stop()后返回的值
+
+            filter_mode mode;
+            std::size_t outSize;  // 输出类型的大小，无输出时为0
+        };
+
+        /**
+         * @brief 发生异常时也销毁输入
+         */
+        template <typename T>
+        struct destroy_guard {
+            explicit destroy_guard(T & x) : x(x) {}
+            ~destroy_guard() { x.~T(); }
+            T & x;
+        };
+
+        /**
+         * @brief 中间阶段：Out f(int id, In in)
+         */
+        template <typename In, typename Out, typename F>
+        struct pipeline_stage_impl : pipeline_stage {
+            static_assert(alignof(Out) <= alignof(std::max_align_t), "over-aligned pipeline items are not supported");
+
+            pipeline_stage_impl(filter_mode mode, F f) : pipeline_stage(mode, sizeof(Out)), f(std::move(f)) {}
+
+            void run(int id, void * in, void * out, flow_control &) override {
+                In & x = *static_cast<In *>(in);
+                destroy_guard<In> g(x);
+                new (out) Out(this->f(id, std::move(x)));
+            }
+
+            void destroy_in(void * in) override { static_cast<In *>(in)->~In(); }
+            void destroy_out(void * out) override { static_cast<Out *>(out)->~Out(); }
+
+            F f;
+        };
+
+        /**
+         * @brief 数据源：Out f(int id, flow_control & fc)
+         */
+        template <typename Out, typename F>
+        struct pipeline_stage_impl<void, Out, F> : pipeline_stage {
+            static_assert(alignof(Out) <= alignof(std::max_align_t), "over-aligned pipeline items are not supported");
+
+            pipeline_stage_impl(filter_mode mode, F f) : pipeline_stage(mode, sizeof(Out)), f(std::move(f)) {}
+
+            void run(int id, void *, void * out, flow_control & fc) override {
+                new (out) Out(this->f(id, fc));
+            }
+
+            void destroy_in(void *) override {}
+            void destroy_out(void * out) override { static_cast<Out *>(out)->~Out(); }
+
+            F f;
+        };
+
+        /**
+         * @brief 最后一个阶段：void f(int id, In in)
+         */
+        template <typename In, typename F>
+        struct pipeline_stage_impl<In, void, F> : pipeline_stage {
+            pipeline_stage_impl(filter_mode mode, F f) : pipeline_stage(mode, 0), f(std::move(f)) {}
+
+            void run(int id, void * in, void *, flow_control &) override {
+                In & x = *static_cast<In *>(in);
+                destroy_guard<In> g(x);
+                this->f(id, std::move(x));
+            }
+
+            void destroy_in(void * in) override { static_cast<In *>(in)->~In(); }
+            void destroy_out(void *) override {}
+
+            F f;
+        };
+
+        /**
+         * @brief 只有一个阶段的流水线：void f(int id, flow_control & fc)
+         */
+        template <typename F>
+        struct pipeline_stage_impl<void, void, F> : pipeline_stage {
+            pipeline_stage_impl(filter_mode mode, F f) : pipeline_stage(mode, 0), f(std::move(f)) {}
+
+            void run(int id, void *, void *, flow_control & fc) override { this->f(id, fc); }
+
+            void destroy_in(void *) override {}
+            void destroy_out(void *) override {}
+
+            F f;
+        };
+    }
+
+    /**
+     * @brief 一个或多个首尾相接的流水线阶段，输入In，输出Out
+     *
+     * 用operator&连接：filter<A, B> & filter<B, C> 得到 filter<A, C>；
+     * 可以交给pipeline执行的是filter<void, void>
+     */
+    template <typename In, typename Out>
+    class filter {
+    public:
+        filter() {}
+
+        /**
+         * @brief 构造单个阶段
+         *
+         * @param mode 执行方式
+         * @param f 阶段函数，签名见make_filter()
+         */
+        template <typename F>
+        filter(filter_mode mode, F f) {
+            this->stages.push_back(std::make_shared<detail::pipeline_stage_impl<In, Out, F>>(mode, std::move(f)));
+        }
+
+        std::vector<std::shared_ptr<detail::pipeline_stage>> stages;  // 按顺序排列的阶段
+    };
+
+    /**
+     * @brief 创建一个阶段
+     *
+     * @tparam In 输入类型，数据源为void
+     * @tparam Out 输出类型，最后一个阶段为void
+     * @param f 数据源：Out f(int id, flow_control & fc)；
+     *          中间阶段：Out f(int id, In in)；最后一个阶段：void f(int id, In in)
+     *
+     * id是执行该阶段的工作线程索引，与thread_pool::push一致
+     */
+    template <typename In, typename Out, typename F>
+    filter<In, Out> make_filter(filter_mode mode, F f) {
+        return filter<In, Out>(mode, std::move(f));
+    }
+
+    /**
+     * @brief 连接两段流水线
+     */
+    template <typename In, typename Mid, typename Out>
+    filter<In, Out> operator&(const filter<In, Mid> & a, const filter<Mid, Out> & b) {
+        filter<In, Out> r;
+        r.stages = a.stages;
+        r.stages.insert(r.stages.end(), b.stages.begin(), b.stages.end());
+        return r;
+    }
+
+    /**
+     * @brief 在线程池上执行的流水线
+     *
+     * @tparam Pool 线程池类型，需要提供post(detail::task_node *)
+     *
+     * 构造时一次性分配所有令牌和数据缓冲区，之后可以反复调用run()
+     */
+    template <typename Pool = thread_pool>
+    class pipeline {
+
+    public:
+
+        /**
+         * @brief 构造函数
+         *
+         * @param pool 执行阶段函数的线程池
+         * @param maxTokens 同时在流水线中的最大数据项数，必须 > 0
+         * @param f 完整的流水线，至少有一个阶段
+         */
+        pipeline(Pool & pool, std::size_t maxTokens, const filter<void, void> & f)
+            : pool(pool), stages(f.stages), serial(new serial_state[f.stages.size()]), tokens(maxTokens) {
+            std::size_t slotSize = 1;
+            for (std::size_t i = 0; i < this->stages.size(); ++i)
+                slotSize = std::max(slotSize, this->stages[i]->outSize);
+            this->slotUnits = (slotSize + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+            this->buffer.reset(new std::max_align_t[2 * this->slotUnits * maxTokens]);
+            for (std::size_t i = 0; i < maxTokens; ++i) {
+                this->tokens[i].owner = this;
+                this->tokens[i].slots = this->buffer.get() + 2 * this->slotUnits * i;
+            }
+            this->freeTokens.reserve(maxTokens);
+        }
+
+        /**
+         * @brief 执行流水线，阻塞直到数据源结束且所有数据项处理完毕
+         *
+         * 某个阶段抛出的第一个异常会在这里重新抛出；同一时刻只能有一次run()
+         */
+        void run() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->stopped = false;
+            this->done = false;
+            this->failed = false;
+            this->error = nullptr;
+            this->nextSeq = 0;
+            for (std::size_t i = 0; i < this->stages.size(); ++i) {
+                this->serial[i].busy = false;
+                this->serial[i].next = 0;
+                this->serial[i].head = this->serial[i].tail = nullptr;
+            }
+            this->freeTokens.clear();
+            for (std::size_t i = this->tokens.size(); i > 1; --i)
+                this->freeTokens.push_back(&this->tokens[i - 1]);
+
+            // 从第一个令牌开始执行数据源，其余令牌在数据源空闲时依次投入
+            token & first = this->tokens[0];
+            first.reset();
+            this->sourceBusy = true;
+            this->nActive = 1;
+            this->pool.post(&first);
+
+            this->cv.wait(lock, [this]() { return this->done; });
+            if (this->error)
+                std::rethrow_exception(this->error);
+        }
+
+    private:
+
+        pipeline(const pipeline &);// = delete;
+        pipeline & operator=(const pipeline &);// = delete;
+
+        /**
+         * @brief 承载一个数据项的令牌，两个缓冲区交替存放阶段的输入和输出
+         */
+        struct token : detail::task_node {
+            token() : owner(nullptr), slots(nullptr), next(nullptr) { this->reset(); }
+
+            void reset() {
+                this->stage = 0;
+                this->seq = 0;
+                this->valid = true;
+                this->holding = false;
+            }
+
+            void run(int id) override { this->owner->process(this, id); }
+
+            /**
+             * @brief 线程池停止时令牌被清出队列：记录错误，并在当前线程上走完剩余阶段以释放其他令牌
+             */
+            void discard() override {
+                this->owner->fail(std::make_exception_ptr(std::runtime_error("ctpl::pipeline: thread pool stopped")));
+                this->owner->process(this, -1);
+            }
+
+            void * slot(std::size_t i) { return this->slots + (i & 1) * this->owner->slotUnits; }
+
+            pipeline * owner;
+            std::max_align_t * slots;  // 两个数据缓冲区
+            std::size_t stage;  // 下一个要执行的阶段
+            std::size_t seq;  // 数据源产生数据项的序号
+            bool valid;  // 缓冲区中是否有数据项
+            bool holding;  // 是否已经由前一个令牌交接得到了当前串行阶段
+            token * next;  // 在串行阶段等待链表中的下一个令牌
+        };
+
+        /**
+         * @brief 串行阶段的状态
+         */
+        struct serial_state {
+            serial_state() : busy(false), next(0), head(nullptr), tail(nullptr) {}
+
+            std::mutex mutex;  // 保护以下成员
+            bool busy;  // 是否有令牌正在执行该阶段
+            std::size_t next;  // serial_in_order：下一个可以执行的序号
+            token * head;  // 等待执行该阶段的令牌链表
+            token * tail;
+        };
+
+        /**
+         * @brief 取出下一个可以执行的等待令牌，调用者持有ss.mutex
+         */
+        static token * take_ready(serial_state & ss, bool inOrder) {
+            token * prev = nullptr;
+            for (token * t = ss.head; t; prev = t, t = t->next) {
+                if (inOrder && t->seq != ss.next)
+                    continue;
+                if (prev)
+                    prev->next = t->next;
+                else
+                    ss.head = t->next;
+                if (ss.tail == t)
+                    ss.tail = prev;
+                t->next = nullptr;
+                return t;
+            }
+            return nullptr;
+        }
+
+        /**
+         * @brief 在工作线程上推进令牌，直到它在某个串行阶段等待，或回到空闲状态
+         */
+        void process(token * t, int id) {
+            for (;;) {
+                if (t->stage == 0) {
+                    if (!this->produce(t, id))
+                        return;
+                    t->stage = 1;
+                }
+                for (; t->stage < this->stages.size(); ++t->stage)
+                    if (!this->advance(t, id))
+                        return;
+
+                // 数据项处理完毕：数据源空闲时令牌直接去取下一个数据，否则回到空闲链表
+                std::unique_lock<std::mutex> lock(this->mutex);
+                if (!this->stopped && !this->sourceBusy) {
+                    this->sourceBusy = true;
+                    t->reset();
+                    continue;
+                }
+                this->release(t);
+                return;  // release()之后run()可能已经返回，不能再访问成员
+            }
+        }
+
+        /**
+         * @brief 执行数据源（令牌已经独占数据源）
+         *
+         * @return 是否产生了数据项
+         */
+        bool produce(token * t, int id) {
+            flow_control fc;
+            bool ok = false;
+            if (!this->failed.load(std::memory_order_relaxed)) {
+                try {
+                    this->stages[0]->run(id, nullptr, t->slot(0), fc);
+                    ok = !fc.is_stopped();
+                    if (!ok)
+                        this->stages[0]->destroy_out(t->slot(0));
+                }
+                catch (...) {
+                    this->fail(std::current_exception());
+                }
+            }
+
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->sourceBusy = false;
+            if (!ok) {
+                this->stopped = true;
+                this->release(t);
+                return false;
+            }
+            t->seq = this->nextSeq++;
+            if (!this->stopped && !this->freeTokens.empty()) {  // 投入一个空闲令牌去取下一个数据
+                token * u = this->freeTokens.back();
+                this->freeTokens.pop_back();
+                u->reset();
+                ++this->nActive;
+                this->sourceBusy = true;
+                this->pool.post(u);
+            }
+            return true;
+        }
+
+        /**
+         * @brief 执行令牌的当前阶段（不是数据源）
+         *
+         * @return false表示令牌在串行阶段排队等待，之后由其他令牌交给线程池继续
+         */
+        bool advance(token * t, int id) {
+            detail::pipeline_stage & s = *this->stages[t->stage];
+            serial_state * ss = s.mode == filter_mode::parallel ? nullptr : &this->serial[t->stage];
+            const bool inOrder = s.mode == filter_mode::serial_in_order;
+
+            if (ss && !t->holding) {
+                std::unique_lock<std::mutex> lock(ss->mutex);
+                if (ss->busy || (inOrder && t->seq != ss->next)) {
+                    if (ss->tail)
+                        ss->tail->next = t;
+                    else
+                        ss->head = t;
+                    ss->tail = t;
+                    return false;
+                }
+                ss->busy = true;
+            }
+            t->holding = false;
+
+            if (t->valid) {
+                void * in = t->slot(t->stage + 1);
+                if (this->failed.load(std::memory_order_relaxed)) {
+                    s.destroy_in(in);  // 流水线已失败，丢弃数据项
+                    t->valid = false;
+                }
+                else {
+                    try {
+                        flow_control fc;  // 只有数据源使用
+                        s.run(id, in, t->slot(t->stage), fc);
+                    }
+                    catch (...) {
+                        t->valid = false;  // 输入已被销毁，输出没有构造
+                        this->fail(std::current_exception());
+                    }
+                }
+            }
+
+            if (ss) {
+                token * u;
+                {
+                    std::unique_lock<std::mutex> lock(ss->mutex);
+                    ss->busy = false;
+                    if (inOrder)
+                        ++ss->next;
+                    u = take_ready(*ss, inOrder);
+                    if (u) {
+                        ss->busy = true;  // 直接把阶段交给等待的令牌
+                        u->holding = true;
+                    }
+                }
+                if (u)
+                    this->pool.post(u);
+            }
+            return true;
+        }
+
+        /**
+         * @brief 记录第一个异常并停止数据源
+         */
+        void fail(std::exception_ptr e) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (!this->error)
+                this->error = e;
+            this->failed.store(true, std::memory_order_relaxed);
+            this->stopped = true;
+        }
+
+        /**
+         * @brief 令牌回到空闲链表，最后一个令牌回收时通知run()，调用者持有mutex
+         */
+        void release(token * t) {
+            this->freeTokens.push_back(t);
+            if (--this->nActive == 0 && this->stopped) {
+                this->done = true;
+                this->cv.notify_one();
+            }
+        }
+
+        Pool & pool;  // 执行阶段函数的线程池
+        std::vector<std::shared_ptr<detail::pipeline_stage>> stages;  // 所有阶段，第一个是数据源
+        std::unique_ptr<serial_state[]> serial;  // 每个阶段的串行状态，并行阶段不使用
+        std::vector<token> tokens;  // 所有令牌
+        std::unique_ptr<std::max_align_t[]> buffer;  // 所有令牌的数据缓冲区
+        std::size_t slotUnits;  // 每个缓冲区的大小，以max_align_t为单位
+
+        std::mutex mutex;  // 保护以下成员
+        std::condition_variable cv;  // 通知run()流水线结束
+        std::vector<token *> freeTokens;  // 空闲的令牌
+        std::size_t nActive;  // 不在空闲链表中的令牌数
+        std::size_t nextSeq;  // 下一个数据项的序号
+        bool sourceBusy;  // 是否有令牌正在执行数据源或已被投入去执行数据源
+        bool stopped;  // 数据源是否已经结束
+        bool done;  // 所有令牌是否已经回收
+        std::exception_ptr error;  // 第一个异常
+        std::atomic<bool> failed;  // 是否有阶段抛出了异常，阶段执行前无锁检查
+    };
+
+    /**
+     * @brief 构造流水线并执行一次
+     *
+     * @param pool 执行阶段函数的线程池
+     * @param maxTokens 同时在流水线中的最大数据项数
+     * @param f 完整的流水线
+     */
+    template <typename Pool>
+    void parallel_pipeline(Pool & pool, std::size_t maxTokens, const filter<void, void> & f) {
+        pipeline<Pool> p(pool, maxTokens, f);
+        p.run();
+    }
+
+}
+
+#endif // __ctpl_pipeline_H__
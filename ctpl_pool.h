@@ -0,0 +1,1403 @@
+/*********************************************************
+*
+*  Copyright (C) 2014 by Vitaliy Vitsentiy
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+*********************************************************/
+
+/*********************************************************
+* 基于策略的线程池模板
+*
+* ctpl.h和ctpl_stl.h中的thread_pool只是basic_thread_pool的不同实例，
+* 所有功能和优化都只在这里实现一次，两个头文件中只剩下各自的队列策略和一个typedef：
+*
+*      typedef ctpl::basic_thread_pool<ctpl::mutex_queue> thread_pool;                    // ctpl_stl.h
+*      typedef ctpl::basic_thread_pool<ctpl::lockfree_queue> thread_pool;                 // ctpl.h
+*      ctpl::basic_thread_pool<ctpl::work_stealing_queue, ctpl::spin_wait<64>> p(8);      // ctpl_queue.h
+*
+* 模板参数（都在编译期确定，热路径上没有虚函数调用）：
+* 1. QueuePolicy：任务队列，保存detail::task_node指针
+*    - mutex_queue：互斥锁保护的std::queue（本文件）
+*    - lockfree_queue：Boost.Lockfree的无锁队列（ctpl.h）
+*    - ring_queue、work_stealing_queue：有界环形缓冲区、每线程双端队列加窃取（ctpl_queue.h）
+*    - mpsc_queue：侵入式多生产者单消费者队列，用于只有一个工作线程的线程池（ctpl_queue.h）
+* 2. WaitPolicy：工作线程队列为空时的等待方式
+*    - block_wait：直接在条件变量上等待（默认）
+*    - spin_wait<N>：先自旋尝试N次，仍然没有任务再等待，减少突发任务的唤醒延迟
+* 3. TaskPolicy：push()创建的任务节点的内存来源
+*    - cached_tasks：每线程缓存的分配器（ctpl_alloc.h，默认）
+*    - heap_tasks：全局operator new/delete
+*
+* 队列策略需要提供：
+*      explicit Q(int queueSize);                  // queueSize为构造线程池时传入的队列大小
+*      bool push(detail::task_node * node);        // 任意线程调用
+*      bool pop(detail::task_node *& node);        // 任意线程调用，队列为空时返回false
+*      bool empty();                               // 任意线程调用，可以在持有线程池的mutex时调用
+*      void attach(int id);                        // 工作线程（id >= 0）和备用线程（id == -1）启动时在该线程上调用一次
+*
+* 主要功能和特点：
+* 1. 提交任务到线程池：支持函数、函数对象、lambda表达式等多种可调用对象
+* 2. 动态调整线程池大小：可以根据负载情况增加或减少工作线程数量
+* 3. 等待所有任务完成：可以选择等待或立即停止；wait_idle()等待队列清空而不停止线程池，
+*    run_pending()让调用线程一起执行队列中的任务
+* 4. 线程安全：使用原子操作、互斥锁和条件变量保证多线程环境下的安全性
+* 5. 支持获取任务返回值：通过ctpl::future（可以转换为std::future）
+* 6. 异常处理：任务中的异常可以通过future传递给调用者
+* 7. 空闲线程可以代替条件变量在轮询器中等待（领导者/跟随者），见ctpl_reactor.h
+* 8. 任务用ctpl::blocking_region标记会阻塞的区间，期间线程池可以启用备用线程补偿，见set_max_spare()
+* 9. push(ctpl::label("name"), f, args...)按标签统计排队时间和执行时间，见top_labels()和ctpl_profile.h
+* 10. 可选的看门狗报告执行时间超过阈值的任务，见set_watchdog()和ctpl_watchdog.h
+*
+* 线程安全考量：
+* - 队列的线程安全由队列策略保证，线程池只在唤醒和等待时使用互斥锁
+* - 使用std::atomic<bool>标志控制线程的停止，保证线程安全的终止
+* - 使用std::condition_variable实现线程同步和通知机制
+* - 使用智能指针管理资源，避免内存泄漏
+*
+* 性能考量：
+* - 使用条件变量使空闲线程进入等待状态，减少CPU资源消耗
+* - 线程池避免了频繁创建和销毁线程的开销
+* - 不同策略组合是不同的类型，队列和等待策略的调用都可以内联
+*********************************************************/
+
+#ifndef __ctpl_pool_H__
+#define __ctpl_pool_H__
+
+#include <functional>  // 用于std::function
+#include <thread>      // 用于std::thread线程管理
+#include <tuple>       // 用于保存push()的参数
+#include <atomic>      // 用于std::atomic原子操作，保证线程安全
+#include <vector>      // 用于存储线程和标志
+#include <memory>      // 用于智能指针管理资源
+#include <exception>   // 用于异常处理
+#include <future>      // 用于std::future_error
+#include <mutex>       // 用于互斥锁和条件变量
+#include <limits>      // 用于run_pending()的默认任务数上限
+#include <new>         // 用于heap_tasks的operator new
+#include <algorithm>   // 用于看门狗的检查间隔
+#include <chrono>      // 用于看门狗的时间
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>   // 用于co_await pool.schedule()，仅在C++20下启用
+#endif
+#include <queue>       // 用于mutex_queue
+
+#ifndef _ctplThreadPoolLength_
+#define _ctplThreadPoolLength_  100  // 默认队列长度为100，不限长度的队列策略忽略此值
+#endif
+
+#ifndef _ctplCacheLineSize_
+#define _ctplCacheLineSize_  64  // 缓存行大小，用于隔离被不同线程频繁写入的字段
+#endif
+
+#include "ctpl_alloc.h"  // 每线程缓存的小块内存分配器，用于任务节点
+#include "ctpl_future.h"  // push()返回的轻量级future
+#include "ctpl_profile.h"  // 带标签任务的延迟统计
+#include "ctpl_watchdog.h"  // 卡住任务的看门狗
+
+/**
+ * 线程池，用于运行用户的函数对象，函数签名为：
+ *      ret func(int id, other_params)
+ * 其中：
+ * - id 是运行该函数的线程索引，可用于标识不同线程
+ * - other_params 是用户传递的其他参数
+ * - ret 是函数的返回类型，可以通过push()返回的future获取
+ */
+
+namespace ctpl {
+
+    /**
+     * @brief 任务策略：push()创建的任务节点从每线程缓存中分配（默认）
+     *
+     * 工作线程执行后把节点释放回分配它的线程的缓存，适合大量小任务
+     */
+    struct cached_tasks {
+        static void * allocate(std::size_t size) { return detail::cache_allocate(size); }
+        static void deallocate(void * p) noexcept { detail::cache_deallocate(p); }
+    };
+
+    /**
+     * @brief 任务策略：push()创建的任务节点使用全局operator new/delete
+     *
+     * 适合已经替换了全局分配器（jemalloc、tcmalloc等）的程序，或需要用内存检查工具跟踪每个节点的情况
+     */
+    struct heap_tasks {
+        static void * allocate(std::size_t size) { return ::operator new(size); }
+        static void deallocate(void * p) noexcept { ::operator delete(p); }
+    };
+
+    namespace detail {
+        /**
+         * @brief 线程安全的队列实现
+         *
+         * @tparam T 队列中存储的元素类型
+         *
+         * 这是一个简单的线程安全队列实现，使用互斥锁保护所有操作。
+         * 与Boost.Lockfree队列不同，此队列使用标准库的互斥锁实现线程安全，
+         * 在高并发情况下可能会有更多的线程竞争和等待。
+         *
+         * 线程安全考量：
+         * - 所有队列操作都使用互斥锁保护，确保线程安全
+         * - 每个公共方法都获取锁，操作完成后自动释放锁
+         * - 使用RAII风格的锁管理，确保异常安全
+         */
+        template <typename T>
+        class Queue {
+        public:
+            /**
+             * @brief 将元素推入队列
+             *
+             * @param value 要推入的元素
+             * @return bool 操作是否成功，总是返回true
+             *
+             * 线程安全：使用互斥锁保护队列操作
+             */
+            bool push(T const & value) {
+                std::unique_lock<std::mutex> lock(this->mutex);  // 获取互斥锁，保护队列操作
+                this->q.push(value);  // 将元素添加到队列末尾
+                return true;  // 操作总是成功
+            }
+
+            /**
+             * @brief 从队列中弹出元素
+             *
+             * @param v 用于存储弹出元素的引用
+             * @return bool 如果队列非空并成功弹出则返回true，否则返回false
+             *
+             * 线程安全：使用互斥锁保护队列操作
+             */
+            bool pop(T & v) {
+                std::unique_lock<std::mutex> lock(this->mutex);  // 获取互斥锁，保护队列操作
+                if (this->q.empty())  // 检查队列是否为空
+                    return false;  // 队列为空，无法弹出元素
+                v = this->q.front();  // 获取队列头部元素
+                this->q.pop();  // 移除队列头部元素
+                return true;  // 成功弹出元素
+            }
+
+            /**
+             * @brief 检查队列是否为空
+             *
+             * @return bool 如果队列为空则返回true，否则返回false
+             *
+             * 线程安全：使用互斥锁保护队列操作
+             */
+            bool empty() {
+                std::unique_lock<std::mutex> lock(this->mutex);  // 获取互斥锁，保护队列操作
+                return this->q.empty();  // 返回队列是否为空
+            }
+
+        private:
+            std::queue<T> q;  // 实际存储元素的标准库队列
+            std::mutex mutex; // 用于保护队列操作的互斥锁
+        };
+
+        /**
+         * @brief 每个工作线程的控制块
+         *
+         * 填充到一个缓存行大小，因此同一批创建的控制块连续存放时，
+         * 每个线程的停止标志都独占一个缓存行，设置某个线程的标志不会使其他线程的缓存行失效。
+         * 使用填充而非alignas，是为了在C++17之前的编译器上也能用普通new分配。
+         *
+         * 线程安全考量：
+         * - 控制块通过共享指针（别名构造）引用所在的整块内存，
+         *   resize()缩小时分离出去的线程仍然持有它，保证访问安全
+         */
+        struct worker_state {
+            worker_state() : stop(false), started(0), label(-1), tid(0), reported(0), seen(0), seenAt(0) {}
+
+            std::atomic<bool> stop;  // 线程停止标志，true表示线程应尽快退出
+            std::atomic<std::uint64_t> started;  // 正在执行的任务开始时看门狗的时间，0表示没有在执行任务
+            std::atomic<int> label;  // 正在执行的任务的标签编号，-1表示没有标签
+            std::atomic<int> tid;  // 内核线程ID，看门狗用它定向发送信号
+            std::uint64_t reported;  // 最近一次报告的任务的started，只由看门狗线程访问
+            std::uint64_t seen;  // 最近一次检查看到的started，只由看门狗线程访问
+            std::uint64_t seenAt;  // 第一次看到seen时看门狗的时间，任务在此之前开始
+            char pad[_ctplCacheLineSize_];  // 隔开相邻线程的控制块
+        };
+
+        /**
+         * @brief 任务队列中的节点
+         *
+         * 队列中只保存节点指针。push()提交的任务是堆上分配的callable_node，执行后自行释放；
+         * 协程等待体、执行器的操作状态等可以把节点嵌入自身，提交时不需要额外分配内存。
+         * 侵入式队列（ctpl_queue.h中的mpsc_queue）直接用节点中的链接指针串起节点，入队不需要分配内存，
+         * 因此同一个节点同一时刻最多在队列中出现一次：节点被取出（开始run()或discard()）之后才能再次提交
+         */
+        struct task_node {
+            task_node() : queueNext(nullptr) {}
+            task_node(const task_node &) : queueNext(nullptr) {}  // 链接指针属于所在的队列，不随节点拷贝
+            task_node & operator=(const task_node &) { return *this; }
+            virtual ~task_node() {}
+            virtual void run(int id) = 0;  // 在工作线程上执行任务，此后线程池不再访问该节点
+            virtual void discard() = 0;  // 任务未执行就被清出队列时调用，代替run()
+
+            std::atomic<task_node *> queueNext;  // 侵入式队列中的下一个节点，节点在队列中时由队列使用
+        };
+
+        /**
+         * @brief 空闲线程的轮询器，例如ctpl_reactor.h中等待套接字就绪的reactor
+         *
+         * 设置轮询器后，同一时刻最多一个空闲的工作线程（领导者）在poll()中阻塞，代替在条件变量上等待；
+         * 其余空闲线程仍在条件变量上等待，其中一个会在领导者返回后接替它（领导者/跟随者模式）
+         */
+        struct idle_poller {
+            virtual ~idle_poller() {}
+
+            /**
+             * @brief 阻塞直到有事件就绪或wakeup()被调用
+             *
+             * @param ready 输出就绪任务节点的数组，由轮询器持有，在下一次poll()之前有效
+             * @return int 就绪的任务节点数；第一个由领导者直接执行，其余放入队列
+             */
+            virtual int poll(task_node ** & ready) = 0;
+
+            virtual void wakeup() = 0;  // 让正在poll()中阻塞的线程尽快返回，可以在任意线程上调用
+        };
+
+        /**
+         * @brief 在堆上保存可调用对象的任务节点，执行或丢弃后释放自身
+         */
+        template <typename F>
+        struct callable_node : task_node {
+            template<typename U>
+            explicit callable_node(U && u) : f(std::forward<U>(u)) {}
+
+            void run(int id) override {
+                std::unique_ptr<callable_node> self(this);  // 确保即使任务抛出异常也能释放节点
+                this->f(id);
+            }
+
+            void discard() override { delete this; }
+
+            // 节点从每线程缓存中分配，工作线程执行后释放回分配它的线程
+            static void * operator new(std::size_t size) { return cache_allocate(size); }
+            static void operator delete(void * p) noexcept { cache_deallocate(p); }
+
+            F f;  // 可调用对象，签名为void(int id)
+        };
+
+        /**
+         * @brief 编译期整数序列，用于把tuple展开为参数列表（C++11没有std::index_sequence）
+         */
+        template <std::size_t... I>
+        struct index_sequence {};
+
+        template <std::size_t N, std::size_t... I>
+        struct make_index_sequence : make_index_sequence<N - 1, N - 1, I...> {};
+
+        template <std::size_t... I>
+        struct make_index_sequence<0, I...> {
+            typedef index_sequence<I...> type;
+        };
+
+        /**
+         * @brief 判断f(int, Args&&...)能否以右值调用
+         *
+         * 能以右值调用时保存的参数被移动给f，因此支持unique_ptr等只能移动的参数；
+         * 否则（例如f接受非const左值引用）按左值传递，与std::bind的行为一致
+         */
+        template <typename F, typename... Args>
+        struct bound_call {
+            template <typename G>
+            static auto test(int) -> decltype(std::declval<G &>()(0, std::declval<Args>()...), std::true_type());
+            template <typename G>
+            static std::false_type test(...);
+
+            typedef decltype(test<F>(0)) moves;
+        };
+
+        template <typename F, bool Moves, typename... Args>
+        struct bound_result {
+            typedef decltype(std::declval<F &>()(0, std::declval<Args>()...)) type;
+        };
+
+        template <typename F, typename... Args>
+        struct bound_result<F, false, Args...> {
+            typedef decltype(std::declval<F &>()(0, std::declval<Args &>()...)) type;
+        };
+
+        /**
+         * @brief push(f, args...)的可调用对象：参数按值保存在tuple中，调用时展开
+         *
+         * 与std::bind相比，参数只在构造时拷贝或移动一次，调用时再移动给f一次
+         */
+        template <typename F, typename... Args>
+        class bound_task {
+        public:
+            typedef typename bound_call<F, Args...>::moves moves;
+            typedef typename bound_result<F, moves::value, Args...>::type result_type;
+
+            template <typename G, typename... U>
+            explicit bound_task(G && g, U &&... u) : f(std::forward<G>(g)), args(std::forward<U>(u)...) {}
+
+            result_type operator()(int id) {
+                return this->call(id, typename make_index_sequence<sizeof...(Args)>::type(), moves());
+            }
+
+        private:
+            template <std::size_t... I>
+            result_type call(int id, index_sequence<I...>, std::true_type) {
+                return this->f(id, std::move(std::get<I>(this->args))...);
+            }
+
+            template <std::size_t... I>
+            result_type call(int id, index_sequence<I...>, std::false_type) {
+                return this->f(id, std::get<I>(this->args)...);
+            }
+
+            F f;  // 可调用对象
+            std::tuple<Args...> args;  // 保存的参数
+        };
+
+        /**
+         * @brief push()创建的任务节点，结果的共享状态也在节点中，每个任务只分配一次
+         *
+         * 任务和返回的future各持有一个引用，两者都释放后节点才被销毁
+         */
+        template <typename R, typename F, typename TaskPolicy = cached_tasks>
+        struct future_task : task_node, future_state<R> {
+            template<typename... U>
+            explicit future_task(U &&... u) : f(std::forward<U>(u)...) {}  // 在节点中直接构造可调用对象
+
+            void run(int id) override {
+                try {
+                    future_invoker<R>::run(*this, this->f, id);
+                }
+                catch (...) {
+                    this->set_exception(std::current_exception());  // 通过future传递给调用者
+                }
+                this->release();
+            }
+
+            void discard() override {
+                this->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+                this->release();
+            }
+
+            void destroy() override { delete this; }
+
+            static void * operator new(std::size_t size) { return TaskPolicy::allocate(size); }
+            static void operator delete(void * p) noexcept { TaskPolicy::deallocate(p); }
+
+            F f;  // 可调用对象，签名为R(int id)
+        };
+
+        /**
+         * @brief 创建堆上的任务节点
+         */
+        template <typename F>
+        task_node * make_task_node(F && f) {
+            return new callable_node<typename std::decay<F>::type>(std::forward<F>(f));
+        }
+
+        /**
+         * @brief pop()返回的任务的持有者，返回的函数对象没有被调用就销毁时丢弃节点
+         */
+        struct popped_task {
+            explicit popped_task(task_node * node) : node(node) {}
+            ~popped_task() {
+                if (this->node)
+                    this->node->discard();
+            }
+
+            void run(int id) {
+                task_node * n = this->node;
+                this->node = nullptr;  // 任务只执行一次
+                if (n)
+                    n->run(id);
+            }
+
+            task_node * node;
+        };
+
+        /**
+         * @brief blocking_region进入和离开阻塞区间时调用的线程池接口
+         *
+         * 只在阻塞区间的边界上通过虚函数调用，不在提交和执行任务的路径上
+         */
+        struct blocking_hooks {
+            virtual void enter_blocking() = 0;
+            virtual void leave_blocking() = 0;
+
+        protected:
+            ~blocking_hooks() {}
+        };
+
+        /**
+         * @brief 当前线程所属的线程池和blocking_region的嵌套深度
+         */
+        struct thread_context {
+            blocking_hooks * pool;  // 工作线程或备用线程所属的线程池，其他线程为nullptr
+            int blocking;  // 嵌套的blocking_region数量，只有最外层的计入阻塞数
+        };
+
+        inline thread_context & current_thread() {
+            static thread_local thread_context c = { nullptr, 0 };
+            return c;
+        }
+    }
+
+    /**
+     * @brief 队列策略：互斥锁保护的std::queue，不依赖第三方库（ctpl_stl.h）
+     */
+    class mutex_queue : public detail::Queue<detail::task_node *> {
+    public:
+        explicit mutex_queue(int) {}  // 队列不限长度
+        void attach(int) {}
+    };
+
+    /**
+     * @brief 等待策略：队列为空时直接在条件变量上等待（默认）
+     */
+    struct block_wait {
+        template <typename TryPop>
+        static bool spin(TryPop &&) { return false; }
+    };
+
+    /**
+     * @brief 等待策略：队列为空时先让出CPU并重试N次，仍然没有任务再在条件变量上等待
+     *
+     * 任务成批到达时工作线程不必每次都经过条件变量的睡眠和唤醒，代价是空闲时多消耗一些CPU
+     */
+    template <int N>
+    struct spin_wait {
+        template <typename TryPop>
+        static bool spin(TryPop && tryPop) {
+            for (int i = 0; i < N; ++i) {
+                if (tryPop())
+                    return true;
+                std::this_thread::yield();
+            }
+            return false;
+        }
+    };
+
+    /**
+     * @brief 线程池类，管理一组工作线程
+     *
+     * @tparam QueuePolicy 任务队列，见文件开头的说明
+     * @tparam WaitPolicy 空闲工作线程的等待方式，block_wait或spin_wait<N>
+     * @tparam TaskPolicy push()创建的任务节点的内存来源，cached_tasks或heap_tasks
+     *
+     * 此类实现了一个完整的线程池，可以动态调整大小，提交任务，等待任务完成等。
+     * ctpl::thread_pool是它的一个实例，由包含的ctpl.h或ctpl_stl.h决定队列策略
+     */
+    template <typename QueuePolicy, typename WaitPolicy = block_wait, typename TaskPolicy = cached_tasks>
+    class basic_thread_pool : private detail::blocking_hooks {
+
+    public:
+
+        /**
+         * @brief 默认构造函数，初始化线程池
+         *
+         * 创建一个空的线程池，使用默认队列大小(_ctplThreadPoolLength_)
+         * 需要调用resize()方法来添加工作线程
+         */
+        basic_thread_pool() : q(_ctplThreadPoolLength_) { this->init(); }
+
+        /**
+         * @brief 构造函数，指定线程数量和队列大小
+         *
+         * @param nThreads 线程池中的线程数量
+         * @param queueSize 传给队列策略的队列大小，默认为_ctplThreadPoolLength_
+         *
+         * 创建指定数量线程的线程池，并立即启动这些线程等待任务
+         */
+        basic_thread_pool(int nThreads, int queueSize = _ctplThreadPoolLength_) : q(queueSize) { this->init(); this->resize(nThreads); }
+
+        /**
+         * @brief 析构函数，等待所有任务完成并停止线程池
+         *
+         * 调用stop(true)确保所有已提交的任务都被执行完毕
+         * 然后释放所有线程资源
+         */
+        ~basic_thread_pool() {
+            this->stop(true);
+            this->set_watchdog(std::chrono::milliseconds(0), nullptr);  // 停止看门狗线程
+            delete this->profiler.load(std::memory_order_relaxed);  // 此后不再有带标签的任务执行
+        }
+
+        /**
+         * @brief 获取线程池中线程的数量
+         *
+         * @return int 线程数量
+         */
+        int size() { return static_cast<int>(this->threads.size()); }
+
+        /**
+         * @brief 获取当前空闲（等待任务）的线程数量
+         *
+         * @return int 空闲线程数量
+         *
+         * 线程安全：此方法返回原子变量，可以安全地从多个线程调用
+         */
+        int n_idle() { return this->nWaiting; }
+
+        /**
+         * @brief 获取指定索引的线程引用
+         *
+         * @param i 线程索引
+         * @return std::thread& 线程引用
+         *
+         * 注意：调用者必须确保索引有效，否则会导致未定义行为
+         */
+        std::thread & get_thread(int i) { return *this->threads[i]; }
+
+        /**
+         * @brief 动态调整线程池大小
+         *
+         * @param nThreads 新的线程数量，必须 >= 0
+         *
+         * 此方法可以在运行时增加或减少线程池中的线程数量：
+         * 1. 如果 nThreads > 当前线程数，则创建新线程
+         * 2. 如果 nThreads < 当前线程数，则停止多余的线程
+         *
+         * 线程安全考量：
+         * - 应该从单个线程调用，否则需要小心避免与其他resize()或stop()调用交错
+         * - 增加线程是安全的，可以并发执行
+         * - 减少线程时使用了线程分离(detach)而非终止(terminate)，确保线程可以安全完成当前任务
+         * - 使用原子标志通知线程停止，避免了强制终止可能导致的资源泄漏
+         */
+        void resize(int nThreads) {
+            if (!this->isStop && !this->isDone) {  // 只有线程池未停止且未完成时才允许调整线程数
+                int oldNThreads = static_cast<int>(this->threads.size());  // 当前线程数
+
+                std::unique_lock<std::mutex> watchLock(this->watchMutex);  // 看门狗在此锁下读取threads和flags
+                if (oldNThreads <= nThreads) {  // 增加线程数量
+                    this->threads.resize(nThreads);  // 扩展线程容器
+                    this->flags.resize(nThreads);    // 扩展标志容器
+
+                    // 为新线程一次性分配连续的控制块，每个线程的标志通过别名共享指针引用其中一项
+                    std::shared_ptr<detail::worker_state> block(new detail::worker_state[nThreads - oldNThreads],
+                        std::default_delete<detail::worker_state[]>());
+
+                    // 创建新线程
+                    for (int i = oldNThreads; i < nThreads; ++i) {
+                        this->flags[i] = std::shared_ptr<detail::worker_state>(block, block.get() + (i - oldNThreads));  // 新线程的停止标志初始为false
+                        this->set_thread(i);  // 启动新线程，绑定工作函数
+                    }
+                }
+                else {  // 减少线程数量
+                    // 标记多余线程的停止标志，并分离这些线程
+                    for (int i = oldNThreads - 1; i >= nThreads; --i) {
+                        this->flags[i]->stop = true;  // 设置该线程的停止标志为true，通知其退出
+                        this->threads[i]->detach();  // 分离线程，使其在后台运行，主线程不再等待它
+                    }
+                    {
+                        // 唤醒所有可能在等待任务的分离线程，让它们检测到停止标志后退出
+                        std::unique_lock<std::mutex> lock(this->mutex);
+                        this->cv.notify_all();
+                        this->idleCv.notify_all();  // 线程数变少，wait_idle()需要重新检查
+                        if (this->polling)
+                            this->poller->wakeup();  // 领导者可能是被停止的线程
+                    }
+                    // 缩小线程和标志容器，安全删除多余元素
+                    this->threads.resize(nThreads);  // 只保留需要的线程对象
+                    this->flags.resize(nThreads);    // 只保留需要的标志对象
+                }
+            }
+        }
+
+        /**
+         * @brief 清空任务队列
+         *
+         * 从队列中移除所有待处理的任务并释放资源
+         * 注意：此操作会丢弃所有未执行的任务
+         *
+         * 线程安全：
+         * - 队列操作的线程安全由队列策略保证
+         * - 但整体方法不是原子的，调用时应确保没有其他线程同时访问队列
+         */
+        void clear_queue() {
+            detail::task_node * _f;
+            while (this->q.pop(_f))  // 循环弹出队列中的所有任务
+                _f->discard();  // 丢弃任务并释放节点
+        }
+
+        /**
+         * @brief 从任务队列中弹出一个任务
+         *
+         * @return std::function<void(int)> 弹出的任务，如果队列为空则返回空函数
+         *
+         * 此方法允许手动从队列中取出任务并执行，主要用于特殊情况下的任务处理
+         *
+         * 线程安全：
+         * - 队列操作的线程安全由队列策略保证
+         * - 使用智能指针确保即使返回的任务没有被执行也能正确释放资源
+         */
+        std::function<void(int)> pop() {
+            detail::task_node * _f = nullptr;
+            std::function<void(int)> f;
+            if (this->q.pop(_f)) {  // 从队列中弹出任务
+                // 使用智能指针持有节点，确保返回的函数对象没有被调用时节点也能被释放
+                std::shared_ptr<detail::popped_task> t = std::make_shared<detail::popped_task>(_f);
+                f = [t](int id) { t->run(id); };
+            }
+            return f;  // 返回包装后的任务，最多执行一次
+        }
+
+        /**
+         * @brief 在调用线程上执行队列中的任务，直到队列为空或已执行maxTasks个
+         *
+         * @param maxTasks 最多执行的任务数
+         * @return int 实际执行的任务数
+         *
+         * 与pop()相比，不需要为每个任务创建std::function，调用线程可以像工作线程一样
+         * 连续执行任务，例如按帧驱动的程序在每帧末尾让主线程一起处理本帧提交的任务。
+         * 传给任务的线程ID为-1，表示任务不是在工作线程上执行的
+         *
+         * 线程安全：可以在任意线程、多个线程同时调用；正在执行的任务计入wait_idle()的判断
+         */
+        int run_pending(int maxTasks = std::numeric_limits<int>::max()) {
+            int n = 0;
+            detail::task_node * _f;
+            ++this->nHelping;  // 先登记再弹出，wait_idle()看到队列为空时一定能看到正在执行的任务
+            while (n < maxTasks && this->q.pop(_f)) {
+                _f->run(-1);
+                ++n;
+            }
+            if (--this->nHelping == 0) {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                if (this->nIdleWaiters)
+                    this->idleCv.notify_all();
+            }
+            return n;
+        }
+
+        /**
+         * @brief 阻塞直到队列为空且所有工作线程都空闲，线程池继续运行
+         *
+         * 等待期间调用线程也会执行队列中的任务（见run_pending()），
+         * 因此即使线程池没有线程也能返回。与stop(true)不同，返回后可以继续提交任务，
+         * 适合每批任务结束后都要同步一次的程序，不需要反复销毁和创建线程池。
+         * 线程池被stop()时也会返回
+         *
+         * 注意：
+         * - 不能在线程池的任务中调用，否则执行该任务的工作线程永远不会空闲
+         * - 返回时其他线程可能已经提交了新任务；resize()缩小时被分离的线程上仍在执行的任务不会被等待
+         */
+        void wait_idle() {
+            while (true) {
+                this->run_pending();  // 先帮助工作线程清空队列
+                std::unique_lock<std::mutex> lock(this->mutex);
+                ++this->nIdleWaiters;
+                // 空闲时返回；队列中还有任务但所有工作线程都在等待（例如没有线程）时回去执行任务
+                this->idleCv.wait(lock, [this]() {
+                    return this->is_idle() || this->isDone || this->isStop ||
+                        (this->nWaiting >= this->size() && !this->q.empty());
+                });
+                --this->nIdleWaiters;
+                if (this->is_idle() || this->isDone || this->isStop)
+                    return;
+            }
+        }
+
+        /**
+         * @brief 等待所有计算线程完成并停止所有线程
+         *
+         * @param isWait 是否等待队列中的所有任务完成，默认为false
+         *
+         * 此方法有两种工作模式：
+         * 1. isWait=true: 等待模式 - 执行队列中的所有任务，然后停止线程池
+         * 2. isWait=false: 立即停止模式 - 立即停止线程池，丢弃队列中未执行的任务
+         *
+         * 可以异步调用此方法，以便在等待时不阻塞调用线程
+         *
+         * 线程安全考量：
+         * - 使用原子变量isStop和isDone标记线程池状态，确保状态变更对所有线程可见
+         * - 使用条件变量通知所有等待的线程检查停止标志
+         * - 使用join等待所有线程安全退出，确保资源正确释放
+         * - 最后清理队列和容器，防止内存泄漏
+         */
+        void stop(bool isWait = false) {
+            if (!isWait) {  // 不等待任务完成，直接停止
+                if (this->isStop)
+                    return;  // 已经停止则直接返回，避免重复操作
+                this->isStop = true;  // 设置停止标志，所有线程看到此标志后会退出
+
+                // 通知所有线程停止
+                for (int i = 0, n = this->size(); i < n; ++i) {
+                    this->flags[i]->stop = true;  // 设置每个线程的停止标志
+                }
+                this->clear_queue();  // 立即清空任务队列，未执行的任务会被丢弃
+            }
+            else {  // 等待所有任务完成后再停止
+                if (this->isDone || this->isStop)
+                    return;  // 已经完成或已停止则直接返回，避免重复操作
+                this->isDone = true;  // 设置完成标志，通知线程完成所有任务后退出
+            }
+            std::vector<std::unique_ptr<std::thread>> spareThreads;
+            {
+                // 唤醒所有等待中的线程，让它们检测到停止/完成标志
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->cv.notify_all();  // 唤醒所有等待线程
+                this->idleCv.notify_all();  // 让wait_idle()返回
+                this->spareCv.notify_all();  // 让后备中的备用线程退出
+                if (this->polling)
+                    this->poller->wakeup();  // 唤醒阻塞在poll()中的领导者
+                spareThreads.swap(this->spares);  // 此后enter_blocking()不会再创建备用线程
+            }
+
+            // 等待所有线程执行完毕
+            for (int i = 0; i < static_cast<int>(this->threads.size()); ++i) {
+                if (this->threads[i]->joinable())
+                    this->threads[i]->join();  // 等待线程结束，确保资源正确释放
+            }
+            for (std::size_t i = 0; i < spareThreads.size(); ++i)
+                spareThreads[i]->join();  // 备用线程在队列为空后退出
+
+            // 如果线程池中没有线程但队列中还有任务，需要手动清理这些任务
+            this->clear_queue();
+            std::unique_lock<std::mutex> watchLock(this->watchMutex);
+            this->threads.clear();  // 清空线程容器
+            this->flags.clear();    // 清空标志容器
+        }
+
+        /**
+         * @brief 提交带参数的任务到线程池
+         *
+         * @tparam F 函数类型
+         * @tparam Rest 参数类型包
+         * @param f 函数对象（函数指针、函数对象、lambda表达式等）
+         * @param rest 传递给函数的参数
+         * @return future<R> 用于获取任务结果的future对象，可以隐式转换为std::future；
+         *         R是以保存的参数调用f的返回值类型
+         *
+         * 此方法允许提交带有额外参数的任务到线程池，并返回一个future对象用于获取结果
+         *
+         * 实现细节：
+         * 1. 函数和参数按值保存在任务节点的tuple中（不使用std::bind），执行时第一个参数为线程ID；
+         *    f能以右值接受参数时参数被移动给f，因此支持只能移动的参数，否则按左值传递
+         * 2. 创建任务节点，节点中同时包含结果的共享状态，按任务策略一次分配
+         * 3. 将任务推入队列
+         * 4. 通知一个等待的线程处理新任务
+         *
+         * 线程安全考量：
+         * - 队列操作的线程安全由队列策略保证
+         * - 任务节点和future各持有共享状态的一个引用，确保即使线程池销毁也能正确获取结果
+         * - 使用完美转发(std::forward)保留参数的值类别，提高效率
+         *
+         * 第一个参数是ctpl::label时选择带标签的重载；默认模板参数在推导返回值类型之前排除这种情况
+         */
+        template<typename F, typename... Rest,
+                 typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, label>::value>::type>
+        auto push(F && f, Rest&&... rest)
+            ->future<typename detail::bound_task<typename std::decay<F>::type, typename std::decay<Rest>::type...>::result_type> {
+            // 1. 函数和参数按值保存在任务节点中，返回值类型为以保存的参数调用f的结果
+            typedef detail::bound_task<typename std::decay<F>::type, typename std::decay<Rest>::type...> bound_type;
+            typedef typename bound_type::result_type R;
+
+            // 2. 创建任务节点，结果的共享状态就在节点中
+            typedef detail::future_task<R, bound_type, TaskPolicy> task_type;
+            task_type * _f = new task_type(std::forward<F>(f), std::forward<Rest>(rest)...);
+            future<R> fut(_f);
+
+            // 3. 将任务指针推入队列，并唤醒一个等待中的线程来执行新任务
+            this->post(_f);
+
+            // 4. 返回 future，用户可通过 get() 获取任务结果
+            return fut;
+        }
+
+        /**
+         * @brief 提交无额外参数的任务到线程池
+         *
+         * @tparam F 函数类型
+         * @param f 函数对象（函数指针、函数对象、lambda表达式等）
+         * @return future<decltype(f(0))> 用于获取任务结果的future对象，可以隐式转换为std::future
+         *
+         * 此方法是push的简化版本，用于提交只接受线程ID参数的任务
+         *
+         * 实现细节：
+         * 1. 创建任务节点，节点中同时包含结果的共享状态，按任务策略一次分配
+         * 2. 将任务推入队列
+         * 3. 通知一个等待的线程处理新任务
+         *
+         * 线程安全考量：
+         * - 与带参数版本相同，确保线程安全的任务提交
+         * - 使用完美转发(std::forward)保留函数对象的值类别，提高效率
+         *
+         * 异常处理：
+         * - 任务中抛出的异常会被任务节点捕获，并通过future传递给调用者
+         * - 调用者可以通过future.get()重新抛出异常
+         */
+        template<typename F>
+        auto push(F && f) ->future<decltype(f(0))> {
+            // 1. 创建任务节点，任务类型为 f(0)，结果的共享状态就在节点中
+            typedef decltype(f(0)) R;
+            typedef detail::future_task<R, typename std::decay<F>::type, TaskPolicy> task_type;
+            task_type * _f = new task_type(std::forward<F>(f));
+            future<R> fut(_f);
+
+            // 2. 将任务指针推入队列，并唤醒一个等待中的线程来执行新任务
+            this->post(_f);
+
+            // 3. 返回 future
+            return fut;
+        }
+
+        /**
+         * @brief 提交带标签的任务，按标签统计排队时间和执行时间
+         *
+         * @param l 任务的标签，例如ctpl::label("parse_header")
+         * @return future<R> 与不带标签的push()相同
+         *
+         * 节点中额外保存标签和提交时间；任务执行前后各读一次时钟，
+         * 统计记录在执行任务的线程自己的计数器中，见top_labels()
+         */
+        template<typename F, typename... Rest>
+        auto push(label l, F && f, Rest&&... rest)
+            ->future<typename detail::bound_task<typename std::decay<F>::type, typename std::decay<Rest>::type...>::result_type> {
+            typedef detail::bound_task<typename std::decay<F>::type, typename std::decay<Rest>::type...> bound_type;
+            typedef typename bound_type::result_type R;
+
+            typedef detail::future_task<R, detail::labeled_call<bound_type>, TaskPolicy> task_type;
+            task_type * _f = new task_type(detail::lazy_get(this->profiler), l.id(), std::forward<F>(f), std::forward<Rest>(rest)...);
+            future<R> fut(_f);
+            this->post(_f);
+            return fut;
+        }
+
+        /**
+         * @brief 将任务节点推入队列，并唤醒一个等待中的线程（低层接口）
+         *
+         * @param node 任务节点；线程池会在工作线程上调用node->run(id)，
+         *             或在清空队列时调用node->discard()，之后不再访问该节点
+         *
+         * 与push()不同，此方法不创建future，也不分配内存，
+         * 供协程、执行器等把节点嵌入自身状态的组件使用
+         */
+        void post(detail::task_node * node) {
+            this->q.push(node);
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (this->polling && this->nWaiting <= 1)
+                this->poller->wakeup();  // 唯一空闲的线程阻塞在poll()中
+            else
+                this->cv.notify_one();
+        }
+
+        /**
+         * @brief 设置空闲线程的轮询器（低层接口），nullptr表示取消
+         *
+         * @param p 轮询器，在再次调用set_idle_poller()之前必须有效
+         *
+         * 返回时原来的轮询器不再被任何线程使用。供ctpl_reactor.h等组件使用，
+         * 应从单个线程调用
+         */
+        void set_idle_poller(detail::idle_poller * p) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            detail::idle_poller * old = this->poller;
+            this->poller = p;
+            while (this->polling) {  // 等待领导者离开原来的轮询器
+                old->wakeup();
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+            }
+            if (p)
+                this->cv.notify_one();  // 让一个空闲线程成为领导者
+        }
+
+        /**
+         * @brief 设置备用线程数的上限，0（默认）表示不补偿阻塞的线程
+         *
+         * @param nSpare 同时启用的备用线程的最大数量
+         *
+         * 工作线程进入ctpl::blocking_region时，如果启用的备用线程少于正在阻塞的线程且未达到上限，
+         * 就启用一个备用线程执行队列中的任务；阻塞结束后多出来的备用线程执行完当前任务就退役，
+         * 回到后备中等待下一次启用。备用线程第一次需要时才创建，线程池停止时才退出，
+         * 因此执行任务的线程数保持在size()左右，不受任务阻塞的影响。
+         * 备用线程传给任务的线程ID为-1，与run_pending()相同
+         */
+        void set_max_spare(int nSpare) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->maxSpare = nSpare;
+        }
+
+        /**
+         * @brief 获取当前处于ctpl::blocking_region中的线程数量
+         */
+        int n_blocked() { return this->nBlocked; }
+
+        /**
+         * @brief 获取当前启用的备用线程数量
+         */
+        int n_spare() { return this->nSpareActive; }
+
+        /**
+         * @brief 按执行时间之和降序返回前k个标签的统计，没有提交过带标签的任务时为空
+         */
+        std::vector<label_stats> top_labels(std::size_t k = 10) {
+            detail::label_profiler * p = this->profiler.load(std::memory_order_acquire);
+            return p ? p->top(k) : std::vector<label_stats>();
+        }
+
+        /**
+         * @brief 把top_labels(k)输出为一张表，时间单位为微秒
+         */
+        void dump_labels(std::ostream & os, std::size_t k = 10) { detail::print_labels(os, this->top_labels(k)); }
+
+        /**
+         * @brief 开启或关闭卡住任务的看门狗
+         *
+         * @param threshold 任务执行超过此时间时报告，<= 0表示关闭
+         * @param report 报告回调，在看门狗线程上调用，每个卡住的任务调用一次；抛出的异常被丢弃
+         * @param captureStack 是否附上卡住的线程的调用栈（仅Linux和glibc）
+         *
+         * 再次调用会先停止原来的看门狗线程。应从单个线程调用，与resize()相同
+         */
+        void set_watchdog(std::chrono::milliseconds threshold, std::function<void(const stuck_task &)> report, bool captureStack = false) {
+            std::unique_ptr<detail::watchdog_control> old;
+            {
+                std::unique_lock<std::mutex> lock(this->watchMutex);
+                old.swap(this->watchdog);
+            }
+            if (old)
+                old->shutdown();
+            if (threshold.count() <= 0 || !report)
+                return;
+            std::unique_ptr<detail::watchdog_control> w(new detail::watchdog_control(threshold, std::move(report), captureStack));
+            detail::watchdog_control * p = w.get();
+            p->thread = std::thread([this, p]() { this->watch(*p); });
+            std::unique_lock<std::mutex> lock(this->watchMutex);
+            this->watchdog = std::move(w);
+        }
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+        /**
+         * @brief schedule()返回的等待体，co_await它会把当前协程转移到线程池的工作线程上继续执行
+         *
+         * co_await的结果是恢复协程的工作线程索引；如果线程池在协程恢复前被立即停止，
+         * 协程会在调用stop()的线程上恢复，结果为-1。
+         * 等待体本身就是任务节点，位于协程帧内，因此切换线程不需要任何内存分配
+         */
+        class schedule_awaiter : public detail::task_node {
+        public:
+            explicit schedule_awaiter(basic_thread_pool & pool) : pool(pool), id(-1) {}
+
+            bool await_ready() const noexcept { return false; }  // 总是挂起并转移到线程池
+
+            void await_suspend(std::coroutine_handle<> h) {
+                this->h = h;
+                this->pool.post(this);  // 等待体在协程恢复之前一直有效
+            }
+
+            int await_resume() const noexcept { return this->id; }
+
+            void run(int id) override {
+                this->id = id;
+                this->h.resume();  // 在工作线程上恢复协程
+            }
+
+            void discard() override { this->h.resume(); }  // id保持为-1
+
+        private:
+            basic_thread_pool & pool;
+            std::coroutine_handle<> h;  // 等待中的协程
+            int id;  // 恢复协程的工作线程索引
+        };
+
+        /**
+         * @brief 用于在协程中切换到线程池：int id = co_await pool.schedule();
+         *
+         * 仅在编译器支持C++20协程时可用，配合ctpl_coro.h中的ctpl::task<T>使用
+         */
+        schedule_awaiter schedule() { return schedule_awaiter(*this); }
+#endif
+
+
+    private:
+
+        /**
+         * @brief 删除的拷贝和移动构造/赋值函数
+         *
+         * 线程池不支持拷贝和移动操作，因为这些操作可能导致线程资源管理混乱
+         * 使用注释而非C++11的=delete语法是为了兼容旧编译器
+         */
+        basic_thread_pool(const basic_thread_pool &);// = delete;
+        basic_thread_pool(basic_thread_pool &&);// = delete;
+        basic_thread_pool & operator=(const basic_thread_pool &);// = delete;
+        basic_thread_pool & operator=(basic_thread_pool &&);// = delete;
+
+        /**
+         * @brief 队列为空、所有工作线程都在等待且没有run_pending()在执行任务，调用者持有mutex
+         *
+         * 工作线程在mutex保护下修改nWaiting并在等待条件中弹出任务，
+         * 因此持有mutex时计入nWaiting的线程手中一定没有任务
+         */
+        bool is_idle() {
+            return this->q.empty() && this->nWaiting >= this->size() && this->nHelping == 0;
+        }
+
+        /**
+         * @brief 看门狗线程的主循环
+         *
+         * 每个检查间隔推进一次watchTick，然后在watchMutex下复制flags，逐个检查开始时间。
+         * 报告和捕获调用栈都在锁外进行，不阻塞resize()
+         *
+         * 工作线程记下的started是任务开始前最近一次推进的时间，可能已过去一个检查间隔，
+         * 回调或捕获调用栈耗时较长时更久；任务一定在第一次看到这个started的检查之前开始，
+         * 所以从那次检查算起超过阈值才报告，不会把执行不到阈值的任务报告为卡住
+         */
+        void watch(detail::watchdog_control & w) {
+            std::chrono::milliseconds period = std::max(w.threshold / 4, std::chrono::milliseconds(1));
+            std::uint64_t threshold = static_cast<std::uint64_t>(w.threshold.count());
+            std::vector<std::shared_ptr<detail::worker_state>> snapshot;
+            std::unique_lock<std::mutex> lock(w.mutex);
+            while (!w.quit) {
+                lock.unlock();
+                std::uint64_t now = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        std::chrono::steady_clock::now() - this->watchBase).count()) + 1;
+                this->watchTick.store(now, std::memory_order_relaxed);
+                {
+                    std::unique_lock<std::mutex> watchLock(this->watchMutex);
+                    snapshot = this->flags;
+                }
+                for (int i = 0; i < static_cast<int>(snapshot.size()); ++i) {
+                    detail::worker_state & ws = *snapshot[i];
+                    std::uint64_t s = ws.started.load(std::memory_order_relaxed);
+                    if (!s || s > now)
+                        continue;
+                    if (s != ws.seen) {  // 新的任务，执行时间的下界从这次检查算起
+                        ws.seen = s;
+                        ws.seenAt = now;
+                    }
+                    if (s == ws.reported || now - ws.seenAt < threshold)
+                        continue;
+                    ws.reported = s;  // 同一个任务只报告一次
+                    stuck_task t;
+                    t.id = i;
+                    int lab = ws.label.load(std::memory_order_relaxed);
+                    if (lab >= 0)
+                        t.label = detail::label_registry::instance().name(lab);
+                    t.elapsed = std::chrono::milliseconds(now - s);  // 上界
+                    if (w.captureStack) {
+                        t.stack = detail::capture_stack(ws.tid.load(std::memory_order_relaxed), std::chrono::milliseconds(100));
+                        if (ws.started.load(std::memory_order_relaxed) != s)
+                            t.stack.clear();  // 捕获期间任务已经结束，栈属于别的任务
+                    }
+                    try {
+                        w.report(t);
+                    }
+                    catch (...) {}  // 回调的异常不影响看门狗
+                }
+                snapshot.clear();
+                lock.lock();
+                w.cv.wait_for(lock, period, [&w]() { return w.quit; });
+            }
+        }
+
+        /**
+         * @brief 设置线程的工作函数
+         *
+         * @param i 线程索引
+         *
+         * 此方法为每个线程创建工作函数，并启动线程
+         * 工作函数的主要逻辑：
+         * 1. 不断从队列中获取任务并执行
+         * 2. 队列为空时等待条件变量通知
+         * 3. 收到停止信号时安全退出
+         *
+         * 线程安全考量：
+         * - 使用共享指针复制线程停止标志，确保即使线程池被销毁，线程也能安全访问标志
+         * - 任务节点在执行后自行释放，即使发生异常也能正确释放资源
+         * - 使用条件变量和互斥锁实现线程等待和唤醒机制，减少CPU资源消耗
+         * - 使用原子操作更新等待线程计数，确保计数的线程安全
+         */
+        void set_thread(int i) {
+            // 复制线程停止标志的共享指针，确保线程可以安全访问标志，即使线程池被销毁
+            std::shared_ptr<detail::worker_state> flag(this->flags[i]);
+
+            // 定义线程的工作函数
+            auto f = [this, i, flag]() {
+                detail::current_thread().pool = this;  // 供blocking_region找到所属的线程池
+                detail::running_label() = &flag->label;  // 带标签的任务在这里登记标签，供看门狗报告
+                flag->tid.store(detail::current_tid(), std::memory_order_relaxed);
+                this->q.attach(i);
+                std::atomic<bool> & _flag = flag->stop;  // 线程停止标志的引用
+                detail::task_node * _f;             // 任务节点指针
+                bool isPop = this->q.pop(_f);       // 尝试从队列中弹出一个任务
+
+                while (true) {
+                    while (isPop) {  // 如果队列中有任务
+                        // 每个任务一次relaxed写：记下看门狗维护的粗粒度时间，不读取时钟
+                        flag->started.store(this->watchTick.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                        _f->run(i);  // 执行任务，传入线程索引；节点在执行后自行释放
+
+                        if (_flag) {
+                            flag->started.store(0, std::memory_order_relaxed);
+                            return;  // 如果线程被标记为停止，则立即退出，即使队列不为空
+                        }
+                        else
+                            isPop = this->q.pop(_f);  // 继续尝试获取下一个任务
+                    }
+                    flag->started.store(0, std::memory_order_relaxed);  // 队列为空，不再执行任务
+
+                    // 按等待策略先自旋，取到任务就不必经过条件变量
+                    if (WaitPolicy::spin([this, &_f]() { return this->q.pop(_f); })) {
+                        isPop = true;
+                        continue;
+                    }
+
+                    // 队列为空，等待新任务或停止信号
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    ++this->nWaiting;  // 增加等待线程计数
+                    if (this->nIdleWaiters)
+                        this->idleCv.notify_all();  // 线程池可能已经空闲，让wait_idle()重新检查
+
+                    while (true) {
+                        // 等待条件变量通知，同时检查三个条件：有新任务、线程池完成标志、线程停止标志；
+                        // 设置了轮询器且没有领导者时也退出等待，成为领导者
+                        this->cv.wait(lock, [this, &_f, &isPop, &_flag](){
+                            isPop = this->q.pop(_f);  // 再次尝试获取任务
+                            return isPop || this->isDone || _flag || (this->poller && !this->polling);
+                        });
+                        if (isPop || this->isDone || _flag)
+                            break;
+                        if ((isPop = this->lead(lock, _f)))  // 在poll()中等待，返回时重新持有mutex
+                            break;
+                    }
+
+                    --this->nWaiting;  // 减少等待线程计数
+
+                    if (!isPop)  // 如果没有获取到任务，说明是因为停止信号而退出等待
+                        return;  // 退出线程
+                }
+            };
+
+            // 创建并启动线程，使用reset而非make_unique是为了兼容旧编译器
+            this->threads[i].reset(new std::thread(f));
+        }
+
+        /**
+         * @brief 作为领导者在轮询器中等待，调用者持有mutex且已计入nWaiting
+         *
+         * @return bool 是否取得了一个要直接执行的任务节点（存入_f）
+         *
+         * 返回时仍持有mutex。有事件就绪时先把领导者的身份交给一个空闲线程，
+         * 第一个就绪的节点由本线程执行，其余放入队列
+         */
+        bool lead(std::unique_lock<std::mutex> & lock, detail::task_node * & _f) {
+            detail::idle_poller * p = this->poller;
+            this->polling = true;
+            lock.unlock();
+            detail::task_node ** ready = nullptr;
+            int n = p->poll(ready);
+            for (int k = 1; k < n; ++k)
+                this->q.push(ready[k]);
+            lock.lock();
+            this->polling = false;
+            for (int k = 0; k < n; ++k)
+                this->cv.notify_one();  // 其余就绪的节点和领导者的身份
+            if (n > 0)
+                _f = ready[0];
+            return n > 0;
+        }
+
+        /**
+         * @brief 当前线程进入阻塞区间，需要时启用一个备用线程
+         *
+         * 由最外层的blocking_region调用。启用的决定在mutex下做出，
+         * 先计入nSpareActive再唤醒后备中的线程，没有后备线程时创建一个
+         */
+        void enter_blocking() override {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            ++this->nBlocked;
+            if (this->nSpareActive >= this->nBlocked || this->nSpareActive >= this->maxSpare || this->isDone || this->isStop)
+                return;
+            ++this->nSpareActive;
+            if (this->nSpareParked > 0) {
+                --this->nSpareParked;
+                ++this->nSpareWakeups;
+                this->spareCv.notify_one();
+                return;
+            }
+            try {
+                this->spares.emplace_back(new std::thread([this]() { this->run_spare(); }));
+            }
+            catch (...) {
+                --this->nSpareActive;  // 不能创建线程时不补偿，阻塞区间本身照常进入
+            }
+        }
+
+        /**
+         * @brief 当前线程离开阻塞区间，让多出来的空闲备用线程退役
+         *
+         * 正在执行任务的备用线程在任务结束后自行检查是否退役
+         */
+        void leave_blocking() override {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            --this->nBlocked;
+            if (this->nSpareActive > this->nBlocked && this->nSpareIdle > 0)
+                this->cv.notify_all();
+        }
+
+        /**
+         * @brief 备用线程的工作函数，创建时已经被启用
+         *
+         * 启用期间像run_pending()一样执行队列中的任务并计入nHelping，队列为空时与工作线程一起
+         * 在cv上等待，但不计入nWaiting，因此不影响wait_idle()对工作线程的判断。
+         * 启用的备用线程多于阻塞的线程时退役，在spareCv上等待enter_blocking()再次启用
+         */
+        void run_spare() {
+            detail::current_thread().pool = this;
+            this->q.attach(-1);
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (true) {
+                while (true) {
+                    ++this->nHelping;  // 先登记再弹出，与run_pending()相同
+                    lock.unlock();
+                    detail::task_node * _f;
+                    while (this->nSpareActive <= this->nBlocked && this->q.pop(_f))
+                        _f->run(-1);
+                    lock.lock();
+                    if (--this->nHelping == 0 && this->nIdleWaiters)
+                        this->idleCv.notify_all();
+                    if (this->nSpareActive > this->nBlocked)
+                        break;  // 阻塞已经结束，退役
+
+                    ++this->nSpareIdle;
+                    this->cv.wait(lock, [this]() {
+                        return this->nSpareActive > this->nBlocked || this->isDone || this->isStop || !this->q.empty();
+                    });
+                    --this->nSpareIdle;
+                    if (this->nSpareActive > this->nBlocked)
+                        break;
+                    if (this->q.empty())
+                        return;  // 线程池已经停止
+                }
+
+                --this->nSpareActive;
+                if (!this->q.empty())
+                    this->cv.notify_one();  // 退役前可能收到了post()的通知，转交给其他线程
+                ++this->nSpareParked;
+                this->spareCv.wait(lock, [this]() { return this->nSpareWakeups > 0 || this->isDone || this->isStop; });
+                if (this->nSpareWakeups == 0)
+                    return;  // 线程池已经停止
+                --this->nSpareWakeups;
+            }
+        }
+
+        /**
+         * @brief 初始化线程池状态
+         *
+         * 重置所有状态变量为初始值
+         */
+        void init() {
+            this->nWaiting = 0;    // 初始化等待线程数为0
+            this->nHelping = 0;    // 初始化run_pending()调用数为0
+            this->nIdleWaiters = 0;  // 初始化wait_idle()调用数为0
+            this->poller = nullptr;  // 初始没有轮询器
+            this->polling = false;
+            this->nBlocked = 0;  // 初始没有阻塞的线程
+            this->nSpareActive = 0;
+            this->maxSpare = 0;  // 默认不启用备用线程
+            this->nSpareIdle = 0;
+            this->nSpareParked = 0;
+            this->nSpareWakeups = 0;
+            this->profiler = nullptr;  // 第一个带标签的任务提交时创建
+            this->watchTick = 0;
+            this->watchBase = std::chrono::steady_clock::now();
+            this->isStop = false;  // 初始化停止标志为false
+            this->isDone = false;  // 初始化完成标志为false
+        }
+
+        // 成员变量
+        // 按写入方分组，组之间用一个缓存行大小的填充隔开，避免生产者、工作线程和只读字段之间的伪共享
+
+        // 只读为主：仅在resize()/stop()时修改，工作线程频繁读取
+        std::vector<std::unique_ptr<std::thread>> threads;  // 线程容器，使用智能指针管理线程生命周期
+        std::vector<std::shared_ptr<detail::worker_state>> flags;  // 每个线程的控制块（含停止标志）
+        std::atomic<bool> isDone;  // 是否完成标志，true表示需要完成所有任务后停止
+        std::atomic<bool> isStop;  // 是否停止标志，true表示立即停止，不处理剩余任务
+        std::atomic<detail::label_profiler *> profiler;  // 标签统计，只创建一次
+
+        // 生产者与工作线程共同访问：任务队列
+        char pad0[_ctplCacheLineSize_];
+        QueuePolicy q;  // 任务队列，线程安全由队列策略保证
+
+        // 工作线程写入：每次进入/离开等待时修改
+        char pad1[_ctplCacheLineSize_];
+        std::atomic<int> nWaiting;  // 等待中的线程数量，用于监控线程池状态
+        std::atomic<int> nHelping;  // 正在执行run_pending()的线程数量
+
+        // 生产者每次push时获取，用于唤醒工作线程
+        char pad2[_ctplCacheLineSize_];
+        std::mutex mutex;  // 互斥锁，用于保护条件变量
+        std::condition_variable cv;  // 条件变量，用于线程等待和通知
+        std::condition_variable idleCv;  // 通知wait_idle()线程池可能已经空闲
+        int nIdleWaiters;  // 在idleCv上等待的线程数量，由mutex保护
+        detail::idle_poller * poller;  // 空闲线程的轮询器，由mutex保护
+        bool polling;  // 是否有领导者在poller->poll()中，由mutex保护
+
+        // 阻塞补偿：计数在mutex下修改，备用线程执行任务时不加锁读取nBlocked和nSpareActive
+        std::atomic<int> nBlocked;  // 处于blocking_region中的线程数量
+        std::atomic<int> nSpareActive;  // 已启用的备用线程数量
+        int maxSpare;  // 同时启用的备用线程的上限，由mutex保护
+        int nSpareIdle;  // 已启用但在cv上等待任务的备用线程数量，由mutex保护
+        int nSpareParked;  // 在后备中等待启用的备用线程数量，由mutex保护
+        int nSpareWakeups;  // 已启用但尚未被后备线程领取的数量，由mutex保护
+        std::condition_variable spareCv;  // 后备线程在此等待启用
+        std::vector<std::unique_ptr<std::thread>> spares;  // 所有备用线程，由mutex保护
+
+        // 看门狗：watchTick每个检查间隔写一次，工作线程每开始一个任务读一次
+        char pad3[_ctplCacheLineSize_];
+        std::atomic<std::uint64_t> watchTick;  // 看门狗的粗粒度时间（毫秒，从1开始），没有看门狗时不变
+        std::chrono::steady_clock::time_point watchBase;  // watchTick的起点，多次开启看门狗时时间仍然单调
+        std::mutex watchMutex;  // 保护threads、flags的修改和watchdog指针，看门狗在此锁下读取快照
+        std::unique_ptr<detail::watchdog_control> watchdog;  // 正在运行的看门狗
+    };
+
+    /**
+     * @brief 标记任务中会阻塞的区间（等待锁、同步I/O等），RAII风格
+     *
+     *      p.push([](int id) {
+     *          ...
+     *          {
+     *              ctpl::blocking_region blocking;
+     *              n = ::read(fd, buf, size);
+     *          }
+     *          ...
+     *      });
+     *
+     * 在线程池的工作线程或备用线程上构造时，线程池可以在区间内启用一个备用线程（见set_max_spare()），
+     * 析构时多出来的备用线程退役；在其他线程上构造时什么也不做。
+     * 嵌套的区间只有最外层的生效。区间应当只包住阻塞的调用，区间内继续执行计算会使执行任务的线程多于size()
+     */
+    class blocking_region {
+    public:
+        blocking_region() : pool(nullptr) {
+            detail::thread_context & c = detail::current_thread();
+            if (c.pool && c.blocking++ == 0) {
+                this->pool = c.pool;
+                this->pool->enter_blocking();
+            }
+        }
+
+        ~blocking_region() {
+            detail::thread_context & c = detail::current_thread();
+            if (c.pool && --c.blocking == 0 && this->pool)
+                this->pool->leave_blocking();
+        }
+
+    private:
+        blocking_region(const blocking_region &);// = delete;
+        blocking_region & operator=(const blocking_region &);// = delete;
+
+        detail::blocking_hooks * pool;  // 计入了阻塞数的线程池，不是最外层时为nullptr
+    };
+
+}
+
+#endif // __ctpl_pool_H__
@@ -0,0 +1,489 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 按标签统计任务延迟
+*
+* 给push()的任务加上一个标签，线程池按标签统计排队时间和执行时间的分布，
+* 不需要外部工具就能看出哪类任务占用了线程池：
+*
+*      pool.push(ctpl::label("parse_header"), parse, buf);
+*      pool.dump_labels(std::cerr, 5);  // 执行时间之和最大的5个标签
+*      std::vector<ctpl::label_stats> top = pool.top_labels(5);
+*
+* 主要功能和特点：
+* 1. 标签在第一次使用时登记为一个整数编号；以字符串字面量（只读字符数组）构造时按地址缓存在每线程的表中，
+*    之后构造同一个标签不加锁；以指针、可写的字符数组或std::string构造时每次按内容查找
+* 2. 每个标签在每个工作线程上有独立的排队时间和执行时间直方图，第一次记录时才分配
+* 3. 直方图为对数-线性分桶（HDR）：每个2的幂区间分成2^_ctplHistogramBits_个等宽的桶，
+*    相对误差不超过2^-_ctplHistogramBits_，范围1纳秒到约18分钟
+* 4. top_labels(k)按执行时间之和排序，合并各线程的直方图给出p50、p99和最大值
+*
+* 线程安全考量：
+* - 计数器都是原子变量；同一个工作线程的记录只写自己的计数器，
+*   ID相同的线程（run_pending()和备用线程的ID都是-1）共用一组计数器，原子加保证不丢失
+* - 统计时不加锁读取计数器，得到的是近似一致的快照
+*
+* 性能考量：
+* - 每个带标签的任务读三次steady_clock（提交、开始、结束），与ctpl_fair.h相同，
+*   执行时间是任务的墙钟时间而不是线程的CPU时间，避免每个任务两次系统调用
+* - 不带标签的任务不经过这里，没有任何额外开销
+*********************************************************/
+
+#ifndef __ctpl_profile_H__
+#define __ctpl_profile_H__
+
+#include <algorithm>   // 用于std::sort
+#include <atomic>      // 用于计数器
+#include <chrono>      // 用于排队时间和执行时间
+#include <cstddef>     // 用于std::size_t
+#include <cstdint>     // 用于std::uint64_t
+#include <iomanip>     // 用于dump_labels()的格式
+#include <mutex>       // 用于标签登记
+#include <ostream>     // 用于dump_labels()
+#include <string>      // 用于标签名
+#include <type_traits> // 用于限定按内容查找的指针构造函数
+#include <unordered_map>  // 用于按名字查找标签
+#include <utility>     // 用于std::forward
+#include <vector>      // 用于统计结果
+
+#ifndef _ctplMaxLabels_
+#define _ctplMaxLabels_  256  // 标签数上限，超出的标签都计入最后一个标签"(other)"
+#endif
+
+#ifndef _ctplProfileSlots_
+#define _ctplProfileSlots_  64  // 每个线程池记录统计的线程槽数，线程ID + 1对它取模
+#endif
+
+#ifndef _ctplHistogramBits_
+#define _ctplHistogramBits_  5  // 直方图每个2的幂区间的分桶数的对数
+#endif
+
+namespace ctpl {
+
+    namespace detail {
+        /**
+         * @brief 全局的标签表：名字到编号
+         */
+        class label_registry {
+        public:
+            static label_registry & instance() {
+                static label_registry r;
+                return r;
+            }
+
+            /**
+             * @brief 按地址查找每线程的缓存，未命中时按内容登记；name必须在程序运行期间有效且不变，
+             *        即字符串字面量或静态存储期的常量数组
+             */
+            int intern_static(const char * name) {
+                struct cached {
+                    const char * p;
+                    int id;
+                };
+                static thread_local cached cache[64];
+                cached & c = cache[(reinterpret_cast<std::uintptr_t>(name) >> 3) & 63];
+                if (c.p == name)
+                    return c.id;
+                int id = this->intern(name);
+                c.p = name;
+                c.id = id;
+                return id;
+            }
+
+            /**
+             * @brief 按内容登记，已登记时返回原来的编号
+             */
+            int intern(const std::string & name) {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                std::unordered_map<std::string, int>::const_iterator it = this->ids.find(name);
+                if (it != this->ids.end())
+                    return it->second;
+                if (this->names.size() + 1 >= _ctplMaxLabels_)
+                    return _ctplMaxLabels_ - 1;  // 已满，计入"(other)"
+                int id = static_cast<int>(this->names.size());
+                this->names.push_back(name);
+                this->ids.emplace(name, id);
+                return id;
+            }
+
+            std::string name(int id) {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                if (id >= 0 && id < static_cast<int>(this->names.size()))
+                    return this->names[id];
+                return "(other)";
+            }
+
+        private:
+            label_registry() {}
+
+            std::mutex mutex;  // 保护names和ids
+            std::vector<std::string> names;  // 编号到名字
+            std::unordered_map<std::string, int> ids;  // 名字到编号
+        };
+    }
+
+    /**
+     * @brief 任务的标签，用于push(ctpl::label("name"), f, args...)
+     *
+     * 只有以只读字符数组（字符串字面量）构造时按地址缓存，之后不加锁，数组必须在程序运行期间有效且不变，
+     * 函数内的局部常量数组应声明为static；以指针、可写的字符数组或std::string构造时每次按内容查找，
+     * 同一块缓冲区先后存放不同的名字也会得到不同的标签
+     */
+    class label {
+    public:
+        template <std::size_t N>
+        explicit label(const char (&name)[N]) : i(detail::label_registry::instance().intern_static(name)) {}
+
+        template <std::size_t N>
+        explicit label(char (&name)[N]) : i(detail::label_registry::instance().intern(name)) {}  // 内容可能改变
+
+        // 指针不能说明所指的内容是否不变，按内容查找；模板使字符串字面量优先匹配上面的数组版本
+        template <typename T, typename = typename std::enable_if<std::is_same<T, const char *>::value ||
+                                                                  std::is_same<T, char *>::value>::type>
+        explicit label(T name) : i(detail::label_registry::instance().intern(name)) {}
+
+        explicit label(const std::string & name) : i(detail::label_registry::instance().intern(name)) {}
+
+        int id() const { return this->i; }
+        std::string name() const { return detail::label_registry::instance().name(this->i); }
+
+    private:
+        int i;  // 标签编号
+    };
+
+    /**
+     * @brief 一个标签的统计数据
+     */
+    struct label_stats {
+        std::string name;  // 标签名
+        std::uint64_t count;  // 执行完的任务数
+        std::chrono::nanoseconds runTime;  // 执行时间之和（墙钟时间，不是线程的CPU时间）
+        std::chrono::nanoseconds totalWait;  // 排队时间之和
+        std::chrono::nanoseconds waitP50;  // 排队时间的中位数
+        std::chrono::nanoseconds waitP99;
+        std::chrono::nanoseconds waitMax;
+        std::chrono::nanoseconds runP50;  // 执行时间的中位数
+        std::chrono::nanoseconds runP99;
+        std::chrono::nanoseconds runMax;
+    };
+
+    namespace detail {
+        typedef std::chrono::steady_clock label_clock;
+
+        /**
+         * @brief 当前线程上正在执行的任务的标签编号所在的位置，工作线程启动时设置，其他线程为nullptr
+         *
+         * 看门狗（ctpl_watchdog.h）从这里得知卡住的任务的标签，-1表示没有标签
+         */
+        inline std::atomic<int> *& running_label() {
+            static thread_local std::atomic<int> * p = nullptr;
+            return p;
+        }
+
+        /**
+         * @brief 对数-线性分桶的延迟直方图（纳秒）
+         *
+         * 小于2^B的值每个值一个桶；之后每个2的幂区间[2^m, 2^(m+1))分成2^B个等宽的桶
+         */
+        class latency_histogram {
+        public:
+            enum {
+                sub = 1 << _ctplHistogramBits_,  // 每个区间的桶数
+                maxBits = 40,  // 记录的最大值为2^40 - 1纳秒，更大的值计入最后一个桶
+                buckets = (maxBits - _ctplHistogramBits_ + 1) * sub
+            };
+
+            latency_histogram() {
+                for (int i = 0; i < buckets; ++i)
+                    this->counts[i].store(0, std::memory_order_relaxed);
+            }
+
+            void record(std::uint64_t v) { this->counts[index(v)].fetch_add(1, std::memory_order_relaxed); }
+
+            /**
+             * @brief 把计数加到merged上，merged的长度为buckets
+             */
+            void merge_into(std::vector<std::uint64_t> & merged) const {
+                for (int i = 0; i < buckets; ++i)
+                    merged[i] += this->counts[i].load(std::memory_order_relaxed);
+            }
+
+            static int index(std::uint64_t v) {
+                if (v >= (static_cast<std::uint64_t>(1) << maxBits))
+                    v = (static_cast<std::uint64_t>(1) << maxBits) - 1;
+                if (v < sub)
+                    return static_cast<int>(v);
+#if defined(__GNUC__)
+                int msb = 63 - __builtin_clzll(v);
+#else
+                int msb = 0;
+                while ((v >> msb) > 1)
+                    ++msb;
+#endif
+                int shift = msb - _ctplHistogramBits_;
+                return shift * sub + static_cast<int>(v >> shift);
+            }
+
+            /**
+             * @brief 第i个桶中的最大值
+             */
+            static std::uint64_t highest(int i) {
+                if (i < sub)
+                    return static_cast<std::uint64_t>(i);
+                int shift = i / sub - 1;
+                std::uint64_t low = static_cast<std::uint64_t>(i % sub + sub) << shift;
+                return low + (static_cast<std::uint64_t>(1) << shift) - 1;
+            }
+
+            /**
+             * @brief 合并后的直方图中第q分位数（0 < q <= 1）所在桶的最大值
+             */
+            static std::uint64_t percentile(const std::vector<std::uint64_t> & merged, std::uint64_t total, double q) {
+                if (!total)
+                    return 0;
+                std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(total) + 0.5);
+                if (rank < 1)
+                    rank = 1;
+                std::uint64_t seen = 0;
+                for (int i = 0; i < buckets; ++i) {
+                    seen += merged[i];
+                    if (seen >= rank)
+                        return highest(i);
+                }
+                return highest(buckets - 1);
+            }
+
+            static std::uint64_t max_value(const std::vector<std::uint64_t> & merged) {
+                for (int i = buckets - 1; i >= 0; --i)
+                    if (merged[i])
+                        return highest(i);
+                return 0;
+            }
+
+        private:
+            std::atomic<std::uint64_t> counts[buckets];
+        };
+
+        /**
+         * @brief 一个标签在一个线程槽上的计数器
+         */
+        struct label_counters {
+            label_counters() : count(0), waitSum(0), runSum(0) {}
+
+            std::atomic<std::uint64_t> count;
+            std::atomic<std::uint64_t> waitSum;  // 纳秒
+            std::atomic<std::uint64_t> runSum;  // 纳秒
+            latency_histogram wait;
+            latency_histogram run;
+        };
+
+        /**
+         * @brief 一个线程槽上所有标签的计数器，第一次记录某个标签时分配
+         */
+        struct label_slot {
+            label_slot() {
+                for (int i = 0; i < _ctplMaxLabels_; ++i)
+                    this->labels[i].store(nullptr, std::memory_order_relaxed);
+            }
+            ~label_slot() {
+                for (int i = 0; i < _ctplMaxLabels_; ++i)
+                    delete this->labels[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic<label_counters *> labels[_ctplMaxLabels_];
+        };
+
+        /**
+         * @brief 原子指针为空时创建对象，多个线程同时创建时只保留一个
+         */
+        template <typename T>
+        T * lazy_get(std::atomic<T *> & slot) {
+            T * p = slot.load(std::memory_order_acquire);
+            if (p)
+                return p;
+            T * created = new T();
+            if (slot.compare_exchange_strong(p, created, std::memory_order_acq_rel))
+                return created;
+            delete created;
+            return p;
+        }
+
+        /**
+         * @brief 一个线程池的标签统计，第一个带标签的任务提交时创建
+         */
+        class label_profiler {
+        public:
+            label_profiler() {
+                for (int i = 0; i < _ctplProfileSlots_; ++i)
+                    this->slots[i].store(nullptr, std::memory_order_relaxed);
+            }
+            ~label_profiler() {
+                for (int i = 0; i < _ctplProfileSlots_; ++i)
+                    delete this->slots[i].load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief 在线程ID为id的线程上记录一个任务
+             */
+            void record(int id, int lab, label_clock::duration wait, label_clock::duration run) {
+                label_slot * s = lazy_get(this->slots[static_cast<unsigned>(id + 1) % _ctplProfileSlots_]);
+                label_counters * c = lazy_get(s->labels[lab]);
+                std::uint64_t w = to_ns(wait);
+                std::uint64_t r = to_ns(run);
+                c->count.fetch_add(1, std::memory_order_relaxed);
+                c->waitSum.fetch_add(w, std::memory_order_relaxed);
+                c->runSum.fetch_add(r, std::memory_order_relaxed);
+                c->wait.record(w);
+                c->run.record(r);
+            }
+
+            /**
+             * @brief 合并各线程槽，按执行时间之和降序返回前k个标签
+             */
+            std::vector<label_stats> top(std::size_t k) {
+                std::vector<label_stats> result;
+                std::vector<std::uint64_t> wait(latency_histogram::buckets), run(latency_histogram::buckets);
+                for (int lab = 0; lab < _ctplMaxLabels_; ++lab) {
+                    std::fill(wait.begin(), wait.end(), 0);
+                    std::fill(run.begin(), run.end(), 0);
+                    std::uint64_t count = 0, waitSum = 0, runSum = 0;
+                    for (int i = 0; i < _ctplProfileSlots_; ++i) {
+                        label_slot * s = this->slots[i].load(std::memory_order_acquire);
+                        label_counters * c = s ? s->labels[lab].load(std::memory_order_acquire) : nullptr;
+                        if (!c)
+                            continue;
+                        count += c->count.load(std::memory_order_relaxed);
+                        waitSum += c->waitSum.load(std::memory_order_relaxed);
+                        runSum += c->runSum.load(std::memory_order_relaxed);
+                        c->wait.merge_into(wait);
+                        c->run.merge_into(run);
+                    }
+                    if (!count)
+                        continue;
+                    // 计数和直方图分别读取，直方图的总数可能略有不同，按直方图自己的总数求分位数
+                    std::uint64_t waitTotal = 0, runTotal = 0;
+                    for (int b = 0; b < latency_histogram::buckets; ++b) {
+                        waitTotal += wait[b];
+                        runTotal += run[b];
+                    }
+                    label_stats st;
+                    st.name = label_registry::instance().name(lab);
+                    st.count = count;
+                    st.runTime = std::chrono::nanoseconds(runSum);
+                    st.totalWait = std::chrono::nanoseconds(waitSum);
+                    st.waitP50 = std::chrono::nanoseconds(latency_histogram::percentile(wait, waitTotal, 0.50));
+                    st.waitP99 = std::chrono::nanoseconds(latency_histogram::percentile(wait, waitTotal, 0.99));
+                    st.waitMax = std::chrono::nanoseconds(latency_histogram::max_value(wait));
+                    st.runP50 = std::chrono::nanoseconds(latency_histogram::percentile(run, runTotal, 0.50));
+                    st.runP99 = std::chrono::nanoseconds(latency_histogram::percentile(run, runTotal, 0.99));
+                    st.runMax = std::chrono::nanoseconds(latency_histogram::max_value(run));
+                    result.push_back(st);
+                }
+                std::sort(result.begin(), result.end(),
+                          [](const label_stats & a, const label_stats & b) { return a.runTime > b.runTime; });
+                if (result.size() > k)
+                    result.resize(k);
+                return result;
+            }
+
+        private:
+            label_profiler(const label_profiler &);// = delete;
+            label_profiler & operator=(const label_profiler &);// = delete;
+
+            static std::uint64_t to_ns(label_clock::duration d) {
+                long long n = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+                return n > 0 ? static_cast<std::uint64_t>(n) : 0;
+            }
+
+            std::atomic<label_slot *> slots[_ctplProfileSlots_];  // 按线程ID + 1分配的线程槽
+        };
+
+        /**
+         * @brief 带标签的任务：在调用被包装的可调用对象前后计时并记录
+         *
+         * 提交时记下时间，开始执行时得到排队时间；记录在结果写入future之前完成，
+         * 调用者拿到结果后查询统计就能看到这个任务
+         */
+        template <typename F>
+        struct labeled_call {
+            typedef typename F::result_type result_type;
+
+            template <typename... U>
+            labeled_call(label_profiler * prof, int lab, U &&... u)
+                : f(std::forward<U>(u)...), prof(prof), lab(lab), enqueued(label_clock::now()) {}
+
+            result_type operator()(int id) {
+                scope s(*this, id);
+                return this->f(id);
+            }
+
+            /**
+             * @brief 在析构时记录，任务抛出异常时也会记录
+             */
+            struct scope {
+                scope(labeled_call & c, int id) : c(c), id(id), start(label_clock::now()), slot(running_label()), outer(-1) {
+                    if (this->slot) {
+                        this->outer = this->slot->load(std::memory_order_relaxed);  // 任务中的run_pending()可能嵌套执行带标签的任务
+                        this->slot->store(c.lab, std::memory_order_relaxed);
+                    }
+                }
+                ~scope() {
+                    if (this->slot)
+                        this->slot->store(this->outer, std::memory_order_relaxed);
+                    this->c.prof->record(this->id, this->c.lab, this->start - this->c.enqueued, label_clock::now() - this->start);
+                }
+
+                labeled_call & c;
+                int id;
+                label_clock::time_point start;
+                std::atomic<int> * slot;  // 本线程上正在执行的任务的标签
+                int outer;  // 外层任务的标签
+            };
+
+            F f;
+            label_profiler * prof;
+            int lab;  // 标签编号
+            label_clock::time_point enqueued;  // 提交时间
+        };
+
+        /**
+         * @brief 把top_labels()的结果输出为一张表，时间单位为微秒
+         */
+        inline void print_labels(std::ostream & os, const std::vector<label_stats> & stats) {
+            std::ios::fmtflags flags = os.flags();
+            std::streamsize prec = os.precision();
+            os << std::left << std::setw(24) << "label" << std::right << std::setw(12) << "count" << std::setw(14) << "run(us)"
+               << std::setw(12) << "wait p50" << std::setw(12) << "p99" << std::setw(12) << "max"
+               << std::setw(12) << "run p50" << std::setw(12) << "p99" << std::setw(12) << "max" << '\n';
+            os << std::fixed << std::setprecision(1);
+            for (std::size_t i = 0; i < stats.size(); ++i) {
+                const label_stats & s = stats[i];
+                os << std::left << std::setw(24) << s.name << std::right << std::setw(12) << s.count
+                   << std::setw(14) << s.runTime.count() / 1e3
+                   << std::setw(12) << s.waitP50.count() / 1e3 << std::setw(12) << s.waitP99.count() / 1e3 << std::setw(12) << s.waitMax.count() / 1e3
+                   << std::setw(12) << s.runP50.count() / 1e3 << std::setw(12) << s.runP99.count() / 1e3 << std::setw(12) << s.runMax.count() / 1e3 << '\n';
+            }
+            os.flags(flags);
+            os.precision(prec);
+        }
+    }
+
+}
+
+#endif // __ctpl_profile_H__
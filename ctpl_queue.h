@@ -0,0 +1,371 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* basic_thread_pool的其他队列策略
+*
+*      ctpl::basic_thread_pool<ctpl::ring_queue> p(4, 1024);              // 容量1024的环形缓冲区
+*      ctpl::basic_thread_pool<ctpl::work_stealing_queue> p(8);           // 每个工作线程一个双端队列
+*      ctpl::basic_thread_pool<ctpl::mpsc_queue> p(1);                    // 一个工作线程，多个提交者
+*
+* 主要功能和特点：
+* 1. ring_queue：有界MPMC环形缓冲区（Vyukov），容量为构造线程池时的队列大小向上取2的幂；
+*    入队和出队各一次CAS，不分配内存；缓冲区满时放入互斥锁保护的溢出队列，任务不会丢失
+* 2. work_stealing_queue：每个工作线程有自己的双端队列，工作线程提交的任务放入自己的队列并按后进先出执行，
+*    队列为空时从其他线程的队列头部窃取；其他线程提交的任务放入共享的注入队列
+* 3. mpsc_queue：Vyukov的侵入式多生产者单消费者队列，用task_node中的链接指针串起节点，
+*    入队是一次原子交换，出队不需要CAS，也不分配内存；适合每个核心一个单线程线程池的程序。
+*    节点自身就是链表的一部分，同一个节点同一时刻最多在队列中出现一次，出队后才能再次提交
+*
+* 线程安全考量：
+* - ring_queue的每个槽有一个序号，生产者和消费者通过序号交接槽中的指针
+* - work_stealing_queue的每个双端队列由自己的互斥锁保护，拥有者和窃取者很少同时访问同一个队列；
+*   每个队列的长度另存在原子变量中，空队列不加锁就能跳过
+* - mpsc_queue的出队算法只允许一个消费者；run_pending()、stop()和备用线程也会出队，
+*   所以出队前用一个原子标志互斥，只有一个工作线程时这个标志从不竞争
+*
+* 性能考量：
+* - ring_queue的入队位置和出队位置在不同的缓存行上，生产者和消费者互不干扰
+* - work_stealing_queue的双端队列数为硬件线程数，多出来的工作线程按索引共用；
+*   递归提交子任务的程序（分治、并行遍历）大部分任务在提交它的线程上执行，缓存局部性更好；
+*   工作线程提交的任务不再严格按先进先出执行
+* - mpsc_queue有多个工作线程时仍然正确，但消费者之间在出队标志上自旋，应使用其他队列
+*********************************************************/
+
+#ifndef __ctpl_queue_H__
+#define __ctpl_queue_H__
+
+#include "ctpl_pool.h"  // basic_thread_pool和detail::task_node
+
+#include <atomic>      // 用于序号和队列长度
+#include <cassert>     // 用于检查mpsc_queue的节点没有重复入队
+#include <cstddef>     // 用于std::size_t
+#include <deque>       // 用于溢出队列和双端队列
+#include <memory>      // 用于std::unique_ptr
+#include <mutex>       // 用于互斥锁
+#include <thread>      // 用于std::thread::hardware_concurrency和std::this_thread::yield
+
+namespace ctpl {
+
+    /**
+     * @brief 队列策略：有界MPMC环形缓冲区，满时溢出到互斥锁保护的队列
+     */
+    class ring_queue {
+    public:
+        explicit ring_queue(int queueSize) : enqueuePos(0), dequeuePos(0), nOverflow(0) {
+            std::size_t n = 2;
+            while (n < static_cast<std::size_t>(queueSize))
+                n <<= 1;
+            this->mask = n - 1;
+            this->cells.reset(new cell[n]);
+            for (std::size_t i = 0; i < n; ++i)
+                this->cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        bool push(detail::task_node * node) {
+            std::size_t pos = this->enqueuePos.load(std::memory_order_relaxed);
+            cell * c;
+            while (true) {
+                c = &this->cells[pos & this->mask];
+                std::size_t seq = c->seq.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+                if (diff == 0) {
+                    if (this->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0) {  // 缓冲区已满
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->overflow.push_back(node);
+                    ++this->nOverflow;
+                    return true;
+                }
+                else
+                    pos = this->enqueuePos.load(std::memory_order_relaxed);
+            }
+            c->node = node;
+            c->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(detail::task_node *& node) {
+            std::size_t pos = this->dequeuePos.load(std::memory_order_relaxed);
+            cell * c;
+            while (true) {
+                c = &this->cells[pos & this->mask];
+                std::size_t seq = c->seq.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+                if (diff == 0) {
+                    if (this->dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)  // 缓冲区为空
+                    return this->pop_overflow(node);
+                else
+                    pos = this->dequeuePos.load(std::memory_order_relaxed);
+            }
+            node = c->node;
+            c->seq.store(pos + this->mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool empty() {
+            std::size_t pos = this->dequeuePos.load(std::memory_order_relaxed);
+            std::size_t seq = this->cells[pos & this->mask].seq.load(std::memory_order_acquire);
+            return seq != pos + 1 && this->nOverflow.load() == 0;
+        }
+
+        void attach(int) {}
+
+    private:
+        struct cell {
+            std::atomic<std::size_t> seq;  // 等于位置时可写入，等于位置+1时可读取
+            detail::task_node * node;
+        };
+
+        bool pop_overflow(detail::task_node *& node) {
+            if (this->nOverflow.load() == 0)
+                return false;
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (this->overflow.empty())
+                return false;
+            node = this->overflow.front();
+            this->overflow.pop_front();
+            --this->nOverflow;
+            return true;
+        }
+
+        std::unique_ptr<cell[]> cells;
+        std::size_t mask;  // 容量-1
+        char pad0[_ctplCacheLineSize_];
+        std::atomic<std::size_t> enqueuePos;  // 生产者写入
+        char pad1[_ctplCacheLineSize_];
+        std::atomic<std::size_t> dequeuePos;  // 消费者写入
+        char pad2[_ctplCacheLineSize_];
+        std::atomic<std::size_t> nOverflow;  // 溢出队列的长度
+        std::mutex mutex;  // 保护overflow
+        std::deque<detail::task_node *> overflow;  // 缓冲区满时提交的任务
+    };
+
+    /**
+     * @brief 队列策略：每个工作线程一个双端队列，空闲时从其他队列窃取
+     */
+    class work_stealing_queue {
+    public:
+        explicit work_stealing_queue(int) : inject(), nSlots(static_cast<int>(std::thread::hardware_concurrency())), next(0) {
+            if (this->nSlots < 1)
+                this->nSlots = 1;
+            this->slots.reset(new slot[this->nSlots]);
+        }
+
+        bool push(detail::task_node * node) {
+            int s = this->local();
+            slot & d = s >= 0 ? this->slots[s] : this->inject;
+            std::unique_lock<std::mutex> lock(d.mutex);
+            d.q.push_back(node);
+            ++d.size;
+            return true;
+        }
+
+        bool pop(detail::task_node *& node) {
+            int s = this->local();
+            if (s >= 0 && this->take(this->slots[s], node, false))
+                return true;  // 自己的队列，后进先出
+            if (this->take(this->inject, node, true))
+                return true;
+            // 窃取：从下一个队列开始依次尝试，非工作线程轮流选择起点
+            int start = s >= 0 ? s + 1 : static_cast<int>(this->next++ % static_cast<unsigned>(this->nSlots));
+            for (int k = 0; k < this->nSlots; ++k) {
+                int v = (start + k) % this->nSlots;
+                if (v != s && this->take(this->slots[v], node, true))
+                    return true;
+            }
+            return false;
+        }
+
+        bool empty() {
+            if (this->inject.size.load() != 0)
+                return false;
+            for (int k = 0; k < this->nSlots; ++k)
+                if (this->slots[k].size.load() != 0)
+                    return false;
+            return true;
+        }
+
+        /**
+         * @brief 工作线程id使用第id % nSlots个双端队列，备用线程（id为-1）与其他线程一样使用注入队列
+         */
+        void attach(int id) {
+            owner & o = current();
+            o.q = this;
+            o.slot = id >= 0 ? id % this->nSlots : -1;
+        }
+
+    private:
+        struct slot {
+            slot() : size(0) {}
+
+            std::mutex mutex;  // 保护q
+            std::deque<detail::task_node *> q;
+            std::atomic<std::size_t> size;  // q的长度，不加锁跳过空队列
+            char pad[_ctplCacheLineSize_];
+        };
+
+        /**
+         * @brief 当前线程attach()到的队列和双端队列索引
+         */
+        struct owner {
+            work_stealing_queue * q;
+            int slot;
+        };
+
+        static owner & current() {
+            static thread_local owner o = { nullptr, -1 };
+            return o;
+        }
+
+        int local() {
+            owner & o = current();
+            return o.q == this ? o.slot : -1;
+        }
+
+        bool take(slot & d, detail::task_node *& node, bool front) {
+            if (d.size.load() == 0)
+                return false;
+            std::unique_lock<std::mutex> lock(d.mutex);
+            if (d.q.empty())
+                return false;
+            if (front) {
+                node = d.q.front();
+                d.q.pop_front();
+            }
+            else {
+                node = d.q.back();
+                d.q.pop_back();
+            }
+            --d.size;
+            return true;
+        }
+
+        slot inject;  // 非工作线程提交的任务
+        std::unique_ptr<slot[]> slots;  // 每个工作线程的双端队列
+        int nSlots;
+        std::atomic<unsigned> next;  // 非工作线程窃取的起点
+    };
+
+    /**
+     * @brief 队列策略：侵入式MPSC队列（Vyukov），供只有一个工作线程的线程池使用
+     *
+     * 队列中总有一个哨兵节点，tail是下一个要出队的节点。生产者交换head后再把新节点链接到原来的head上，
+     * 两步之间消费者看到的链表是断开的，此时pop()返回false，生产者随后的post()会再次唤醒工作线程。
+     *
+     * 同一个节点同一时刻最多在队列中出现一次：重复入队会让节点链接到自身或截断链表，
+     * 工作线程不再返回或丢失任务。需要多次调度的对象应为每次调度使用单独的节点，
+     * 或者像deadline_scheduler的令牌那样用计数保证出队后才再次提交。
+     * 调试版本（未定义NDEBUG）出队时清除节点的链接，入队时检查节点不是队尾且没有链接到其他节点
+     */
+    class mpsc_queue {
+    public:
+        explicit mpsc_queue(int) : head(&stub), tail(&stub), popping(false) {}
+
+        bool push(detail::task_node * node) {
+            assert(node != this->head.load(std::memory_order_relaxed) &&
+                   node->queueNext.load(std::memory_order_relaxed) == nullptr && "task_node already queued");
+            this->link(node);
+            return true;
+        }
+
+        bool pop(detail::task_node *& node) {
+            while (this->popping.exchange(true, std::memory_order_acquire))
+                std::this_thread::yield();  // 只在run_pending()、stop()或备用线程同时出队时发生
+            bool popped = this->pop_single(node);
+            this->popping.store(false, std::memory_order_release);
+            return popped;
+        }
+
+        bool empty() {
+            return this->tail.load(std::memory_order_acquire) == &this->stub &&
+                this->head.load(std::memory_order_acquire) == &this->stub;
+        }
+
+        void attach(int) {}
+
+    private:
+        /**
+         * @brief 把节点放到队尾
+         */
+        void link(detail::task_node * node) {
+            node->queueNext.store(nullptr, std::memory_order_relaxed);
+            detail::task_node * prev = this->head.exchange(node, std::memory_order_acq_rel);  // 唯一的同步点
+            prev->queueNext.store(node, std::memory_order_release);
+        }
+
+        /**
+         * @brief 取出节点t，next是它之后的节点
+         */
+        bool take(detail::task_node * t, detail::task_node * next, detail::task_node *& node) {
+            this->tail.store(next, std::memory_order_release);
+#ifndef NDEBUG
+            t->queueNext.store(nullptr, std::memory_order_relaxed);  // 生产者不再访问t，供push()检查重复入队
+#endif
+            node = t;
+            return true;
+        }
+
+        /**
+         * @brief 哨兵节点，从不执行
+         */
+        struct stub_node : detail::task_node {
+            void run(int) override {}
+            void discard() override {}
+        };
+
+        /**
+         * @brief 单消费者出队，调用者持有popping
+         */
+        bool pop_single(detail::task_node *& node) {
+            detail::task_node * t = this->tail.load(std::memory_order_relaxed);
+            detail::task_node * next = t->queueNext.load(std::memory_order_acquire);
+            if (t == &this->stub) {  // 跳过哨兵
+                if (!next)
+                    return false;
+                this->tail.store(next, std::memory_order_relaxed);
+                t = next;
+                next = next->queueNext.load(std::memory_order_acquire);
+            }
+            if (next)
+                return this->take(t, next, node);
+            if (t != this->head.load(std::memory_order_acquire))
+                return false;  // 生产者已经交换了head，但还没有链接到t之后
+            this->link(&this->stub);  // t是最后一个节点，放回哨兵后才能把t取出
+            next = t->queueNext.load(std::memory_order_acquire);
+            if (!next)
+                return false;
+            return this->take(t, next, node);
+        }
+
+        char pad0[_ctplCacheLineSize_];
+        std::atomic<detail::task_node *> head;  // 生产者交换
+        char pad1[_ctplCacheLineSize_];
+        std::atomic<detail::task_node *> tail;  // 只有消费者写入，empty()可以在其他线程读取
+        std::atomic<bool> popping;  // 消费者之间的互斥标志
+        stub_node stub;
+    };
+
+}
+
+#endif // __ctpl_queue_H__
@@ -0,0 +1,286 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 套接字就绪事件的reactor (epoll)
+*
+* 单独的epoll线程为每个就绪的套接字调用pool.push()，每个事件都要在两个线程之间交接一次。
+* reactor把epoll_wait()放进线程池的空闲线程：同一时刻一个空闲的工作线程（领导者）阻塞在epoll_wait()中，
+* 代替在条件变量上等待；事件就绪后它把领导者的身份交给另一个空闲线程，自己直接执行处理函数。
+*
+*      ctpl::reactor<ctpl::thread_pool> r(pool);
+*      r.watch(fd, EPOLLIN, [](int id, unsigned events) {
+*          ...  // 读取到EAGAIN为止
+*          return true;  // 继续监视；返回false取消监视
+*      });
+*
+* 主要功能和特点：
+* 1. 领导者/跟随者：一次epoll_wait()返回多个事件时，第一个处理函数在领导者上直接执行，
+*    其余的作为任务放入线程池的队列
+* 2. 每个文件描述符以EPOLLONESHOT注册，处理函数返回后才重新启用，同一个描述符的处理函数不会并发执行
+* 3. 向线程池提交普通任务时，如果唯一的空闲线程正在epoll_wait()中，通过eventfd把它唤醒
+*
+* 线程安全考量：
+* - watch()可以在任意线程（包括处理函数中）调用
+* - 处理函数返回false、抛出异常或者返回true但描述符已经关闭时取消监视，此后不再访问处理函数
+* - reactor销毁时先从线程池取消轮询器，再等待已就绪的处理函数执行完或被丢弃，调用者应保证线程池在此之前不会被销毁
+* - 所有工作线程都在执行任务时没有线程等待事件，事件在有线程空闲后才被处理；没有工作线程时事件不会被处理
+*
+* 性能考量：
+* - 领导者直接执行第一个处理函数，没有线程之间的交接；处理函数节点在watch()时分配一次，之后反复使用
+* - 每次处理函数返回后调用一次epoll_ctl()重新启用描述符
+*
+* 只能在Linux上使用
+*********************************************************/
+
+#ifndef __ctpl_reactor_H__
+#define __ctpl_reactor_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#ifndef __linux__
+#error "ctpl_reactor.h requires Linux epoll"
+#endif
+
+#include <atomic>      // 用于就绪处理函数的计数
+#include <cerrno>      // 用于errno
+#include <cstdint>     // 用于std::uint64_t
+#include <mutex>       // 用于保护处理函数链表
+#include <system_error>  // 用于std::system_error
+#include <thread>      // 用于std::this_thread::yield
+#include <type_traits> // 用于std::decay
+#include <utility>     // 用于std::forward
+#include <sys/epoll.h>  // 用于epoll
+#include <sys/eventfd.h>  // 用于唤醒领导者
+#include <unistd.h>    // 用于read、write和close
+
+#ifndef _ctplReactorEvents_
+#define _ctplReactorEvents_  64  // 每次epoll_wait()最多取出的事件数
+#endif
+
+namespace ctpl {
+
+    /**
+     * @brief 在线程池的空闲线程中等待文件描述符就绪的reactor
+     *
+     * @tparam Pool 线程池类型，需要提供set_idle_poller()方法（ctpl::thread_pool即可）
+     *
+     * reactor不可拷贝或移动，同一个线程池同一时刻只能设置一个reactor
+     */
+    template <typename Pool>
+    class reactor : private detail::idle_poller {
+
+    public:
+
+        /**
+         * @brief 构造函数，创建epoll实例并设置为线程池的轮询器
+         *
+         * @throw std::system_error 创建epoll实例或eventfd失败
+         */
+        explicit reactor(Pool & pool) : pool(pool), epfd(-1), evfd(-1), inflight(0), nWatches(0) {
+            this->head.prev = this->head.next = &this->head;
+            this->epfd = ::epoll_create1(EPOLL_CLOEXEC);
+            if (this->epfd < 0)
+                throw std::system_error(errno, std::system_category(), "ctpl: epoll_create1");
+            this->evfd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.ptr = nullptr;  // 处理函数节点的地址不会为空
+            if (this->evfd < 0 || ::epoll_ctl(this->epfd, EPOLL_CTL_ADD, this->evfd, &ev) != 0) {
+                int err = errno;
+                if (this->evfd >= 0)
+                    ::close(this->evfd);
+                ::close(this->epfd);
+                throw std::system_error(err, std::system_category(), "ctpl: eventfd");
+            }
+            this->pool.set_idle_poller(this);
+        }
+
+        ~reactor() {
+            this->pool.set_idle_poller(nullptr);  // 返回后没有线程在epoll_wait()中
+            while (this->inflight.load(std::memory_order_acquire) != 0)
+                std::this_thread::yield();  // 就绪的处理函数仍在线程池的队列中或正在执行
+            while (this->head.next != &this->head)
+                this->unlink(static_cast<watch_base *>(this->head.next));
+            ::close(this->evfd);
+            ::close(this->epfd);
+        }
+
+        /**
+         * @brief 监视文件描述符
+         *
+         * @param fd 文件描述符，通常是非阻塞的套接字；同一个描述符只能监视一次
+         * @param events 关心的事件，例如EPOLLIN、EPOLLOUT、EPOLLRDHUP；EPOLLONESHOT由reactor添加
+         * @param f 处理函数 bool f(int id, unsigned events)，id是工作线程索引，events是就绪的事件；
+         *          返回true继续监视，返回false取消监视（不关闭描述符）
+         * @throw std::system_error epoll_ctl()失败，例如描述符不支持epoll
+         */
+        template <typename F>
+        void watch(int fd, unsigned events, F && f) {
+            watch_node<typename std::decay<F>::type> * w =
+                new watch_node<typename std::decay<F>::type>(*this, fd, events, std::forward<F>(f));
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                w->prev = this->head.prev;
+                w->next = &this->head;
+                this->head.prev->next = w;
+                this->head.prev = w;
+                ++this->nWatches;
+            }
+            if (!this->arm(w, EPOLL_CTL_ADD)) {
+                int err = errno;
+                this->unlink(w);
+                throw std::system_error(err, std::system_category(), "ctpl: epoll_ctl");
+            }
+        }
+
+        /**
+         * @brief 获取正在监视的文件描述符数量
+         */
+        int size() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            return this->nWatches;
+        }
+
+    private:
+
+        reactor(const reactor &);// = delete;
+        reactor(reactor &&);// = delete;
+        reactor & operator=(const reactor &);// = delete;
+        reactor & operator=(reactor &&);// = delete;
+
+        /**
+         * @brief 双向链表的节点，reactor销毁时释放仍在监视的处理函数
+         */
+        struct link {
+            link * prev;
+            link * next;
+        };
+
+        /**
+         * @brief 一个被监视的描述符，同时是线程池的任务节点，就绪时被执行
+         */
+        struct watch_base : link, detail::task_node {
+            watch_base(reactor & r, int fd, unsigned events) : r(r), fd(fd), events(events), revents(0) {}
+
+            void run(int id) override {
+                bool keep;
+                try {
+                    keep = this->handle(id, this->revents);
+                }
+                catch (...) {
+                    keep = false;  // 与io_context的续体一致，异常被丢弃
+                }
+                reactor & r = this->r;
+                if (!keep || !r.arm(this, EPOLL_CTL_MOD)) {
+                    ::epoll_ctl(r.epfd, EPOLL_CTL_DEL, this->fd, nullptr);  // 描述符已关闭时失败，可以忽略
+                    r.unlink(this);
+                }
+                r.inflight.fetch_sub(1, std::memory_order_release);  // 此后不再访问reactor
+            }
+
+            void discard() override {
+                this->r.inflight.fetch_sub(1, std::memory_order_release);  // 线程池停止，节点由reactor销毁时释放
+            }
+
+            virtual bool handle(int id, unsigned events) = 0;
+
+            reactor & r;
+            int fd;
+            unsigned events;  // 关心的事件
+            unsigned revents;  // 就绪的事件，由领导者写入；重新启用描述符的epoll_ctl()先于下一次写入
+        };
+
+        template <typename F>
+        struct watch_node : watch_base {
+            template <typename U>
+            watch_node(reactor & r, int fd, unsigned events, U && f) : watch_base(r, fd, events), f(std::forward<U>(f)) {}
+
+            bool handle(int id, unsigned events) override { return this->f(id, events); }
+
+            F f;  // 处理函数
+        };
+
+        /**
+         * @brief 以EPOLLONESHOT注册或重新启用描述符
+         */
+        bool arm(watch_base * w, int op) {
+            epoll_event ev = {};
+            ev.events = w->events | EPOLLONESHOT;
+            ev.data.ptr = w;
+            return ::epoll_ctl(this->epfd, op, w->fd, &ev) == 0;
+        }
+
+        /**
+         * @brief 从链表中移除并释放处理函数
+         */
+        void unlink(watch_base * w) {
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                w->prev->next = w->next;
+                w->next->prev = w->prev;
+                --this->nWatches;
+            }
+            delete w;
+        }
+
+        /**
+         * @brief 领导者在线程池中调用：等待事件，返回就绪的处理函数节点
+         */
+        int poll(detail::task_node ** & ready) override {
+            int n = ::epoll_wait(this->epfd, this->events, _ctplReactorEvents_, -1);
+            int k = 0;
+            for (int i = 0; i < n; ++i) {
+                if (this->events[i].data.ptr == nullptr) {  // wakeup()
+                    std::uint64_t v;
+                    while (::read(this->evfd, &v, sizeof(v)) < 0 && errno == EINTR) {}
+                    continue;
+                }
+                watch_base * w = static_cast<watch_base *>(this->events[i].data.ptr);
+                w->revents = this->events[i].events;
+                this->ready[k++] = w;
+            }
+            this->inflight.fetch_add(k, std::memory_order_relaxed);  // set_idle_poller(nullptr)返回前完成
+            ready = this->ready;
+            return k;  // epoll_wait()被信号中断时返回0，线程池会再次调用poll()
+        }
+
+        void wakeup() override {
+            std::uint64_t v = 1;
+            while (::write(this->evfd, &v, sizeof(v)) < 0 && errno == EINTR) {}
+        }
+
+        Pool & pool;  // 提供空闲线程的线程池
+        int epfd;  // epoll实例
+        int evfd;  // 唤醒领导者的eventfd
+        std::atomic<long> inflight;  // 已就绪但尚未执行完的处理函数数量
+
+        std::mutex mutex;  // 保护head和nWatches
+        link head;  // 正在监视的处理函数链表
+        int nWatches;  // 正在监视的描述符数量
+
+        // 只由领导者访问
+        epoll_event events[_ctplReactorEvents_];
+        detail::task_node * ready[_ctplReactorEvents_];
+    };
+
+}
+
+#endif // __ctpl_reactor_H__
@@ -0,0 +1,535 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 每核心一个分片的线程池（thread-per-core）
+*
+* thread_pool的所有工作线程共用一个队列和一组计数器，这些共享的缓存行在核心之间来回传递。
+* sharded_pool为每个核心创建一个绑定到该核心的分片线程，分片之间不共享可写的状态，只通过消息通信：
+*
+*      ctpl::sharded_pool sp;                              // 每个硬件线程一个分片
+*      auto f = sp.submit_to(3, [](int shard, int x) { return x * 2; }, 21);
+*      int v = f.get();                                    // 在非分片线程上等待
+*
+*      // 在分片上执行的任务中：
+*      auto g = sp.submit_to(other, work);
+*      sp.wait(g);                                         // 等待时继续处理本分片的消息
+*
+* 主要功能和特点：
+* 1. 每个分片一个线程，Linux上绑定到进程可用的第i个CPU；分片的状态和接收队列由分片线程自己分配，
+*    在NUMA系统上位于该核心的本地内存中
+* 2. 每对分片之间有一个单生产者单消费者的环形缓冲区，分片之间提交任务不需要原子读改写操作
+* 3. submit_to(shard, f, args...)返回ctpl::future，接口与thread_pool::push()一致，f的第一个参数是分片索引；
+*    从分片提交时，任务在目标分片上执行完后把结果作为消息送回原分片，future在原分片上完成，
+*    原分片处理结果时不会和目标分片争用同一个缓存行
+* 4. 非分片线程提交的任务和环形缓冲区满时的任务放入目标分片的侵入式MPSC队列（mpsc_queue）
+*
+* 线程安全考量：
+* - 分片线程上不能用future::get()等待从本分片提交的任务，结果要由本分片自己完成；应使用wait(f)，
+*   它在等待期间继续处理本分片的消息
+* - 分片空闲时先设置睡眠标志再检查所有队列，生产者入队后检查睡眠标志，两边各有一个seq_cst栅栏，不会丢失唤醒
+* - 析构函数等待所有已提交的任务执行完（包括任务中继续提交的任务），然后停止分片线程；
+*   不能在分片线程上销毁sharded_pool，析构期间也不能再从其他线程提交任务
+*
+* 性能考量：
+* - 每个分片统计自己发出和处理的消息数，只在析构时汇总，提交路径上没有全局计数器
+* - 分片每轮依次检查所有接收队列，每个队列最多处理_ctplShardBatch_个消息，分片数很多时检查空队列的开销随之增加
+* - 环形缓冲区共有n*n个，每个_ctplShardRingSize_个槽
+*********************************************************/
+
+#ifndef __ctpl_shard_H__
+#define __ctpl_shard_H__
+
+#include "ctpl_queue.h"  // mpsc_queue、detail::task_node和detail::bound_task
+
+#include <atomic>      // 用于环形缓冲区的位置和睡眠标志
+#include <condition_variable>  // 用于空闲分片的睡眠
+#include <cstddef>     // 用于std::size_t
+#include <cstdint>     // 用于std::uint64_t
+#include <exception>   // 用于std::exception_ptr
+#include <future>      // 用于std::future_error
+#include <memory>      // 用于std::unique_ptr
+#include <mutex>       // 用于互斥锁
+#include <thread>      // 用于分片线程
+#include <type_traits> // 用于std::decay
+#include <utility>     // 用于std::forward
+#include <vector>      // 用于分片和环形缓冲区
+#if defined(__linux__)
+#include <pthread.h>   // 用于pthread_setaffinity_np
+#include <sched.h>     // 用于cpu_set_t
+#endif
+
+#ifndef _ctplShardRingSize_
+#define _ctplShardRingSize_  256  // 每对分片之间环形缓冲区的槽数
+#endif
+
+#ifndef _ctplShardBatch_
+#define _ctplShardBatch_  64  // 每轮从一个接收队列最多处理的消息数
+#endif
+
+namespace ctpl {
+
+    namespace detail {
+        /**
+         * @brief 单生产者单消费者的环形缓冲区
+         *
+         * 生产者和消费者各自缓存对方的位置，只在缓存的位置表明已满或为空时才读取对方的缓存行
+         */
+        class spsc_ring {
+        public:
+            explicit spsc_ring(std::size_t capacity) : tail(0), headCache(0), head(0), tailCache(0) {
+                std::size_t n = 2;
+                while (n < capacity)
+                    n <<= 1;
+                this->mask = n - 1;
+                this->buf.reset(new task_node *[n]);
+            }
+
+            /**
+             * @brief 只能由生产者调用，已满时返回false
+             */
+            bool push(task_node * node) {
+                std::size_t t = this->tail.load(std::memory_order_relaxed);
+                if (t - this->headCache > this->mask) {
+                    this->headCache = this->head.load(std::memory_order_acquire);
+                    if (t - this->headCache > this->mask)
+                        return false;
+                }
+                this->buf[t & this->mask] = node;
+                this->tail.store(t + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+             * @brief 只能由消费者调用，为空时返回false
+             */
+            bool pop(task_node *& node) {
+                std::size_t h = this->head.load(std::memory_order_relaxed);
+                if (h == this->tailCache) {
+                    this->tailCache = this->tail.load(std::memory_order_acquire);
+                    if (h == this->tailCache)
+                        return false;
+                }
+                node = this->buf[h & this->mask];
+                this->head.store(h + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+             * @brief 只能由消费者调用
+             */
+            bool empty() const {
+                return this->head.load(std::memory_order_relaxed) == this->tail.load(std::memory_order_acquire);
+            }
+
+        private:
+            std::unique_ptr<task_node *[]> buf;
+            std::size_t mask;
+            char pad0[_ctplCacheLineSize_];
+            std::atomic<std::size_t> tail;  // 生产者写入
+            std::size_t headCache;  // 生产者看到的head
+            char pad1[_ctplCacheLineSize_];
+            std::atomic<std::size_t> head;  // 消费者写入
+            std::size_t tailCache;  // 消费者看到的tail
+            char pad2[_ctplCacheLineSize_];
+        };
+
+        /**
+         * @brief 在目标分片上调用任务，结果暂存到送回原分片为止
+         */
+        template <typename R>
+        struct shard_invoker {
+            template <typename F>
+            static void run(future_value<R> & v, F & f, int id) { v.set(f(id)); }
+            static void complete(future_state<R> & s, future_value<R> & v) {
+                s.set_value(v.take());
+                v.destroy();
+            }
+        };
+
+        template <typename R>
+        struct shard_invoker<R &> {
+            template <typename F>
+            static void run(future_value<R &> & v, F & f, int id) { v.set(f(id)); }
+            static void complete(future_state<R &> & s, future_value<R &> & v) { s.set_value(v.take()); }
+        };
+
+        template <>
+        struct shard_invoker<void> {
+            template <typename F>
+            static void run(future_value<void> & v, F & f, int id) {
+                f(id);
+                v.set();
+            }
+            static void complete(future_state<void> & s, future_value<void> &) { s.set_value(); }
+        };
+    }
+
+    /**
+     * @brief 每核心一个分片的线程池，分片之间通过单生产者单消费者环形缓冲区传递任务和结果
+     */
+    class sharded_pool {
+
+    public:
+
+        /**
+         * @brief 构造函数，创建并启动分片线程，所有分片初始化完成后返回
+         *
+         * @param nShards 分片数，<= 0时为硬件线程数
+         * @param pin 是否把第i个分片绑定到进程可用的第i个CPU（仅Linux）
+         * @param ringSize 每对分片之间环形缓冲区的槽数，向上取2的幂
+         */
+        explicit sharded_pool(int nShards = 0, bool pin = true, int ringSize = _ctplShardRingSize_)
+            : nShards(nShards > 0 ? nShards : static_cast<int>(std::thread::hardware_concurrency())),
+              ringSize(ringSize > 0 ? ringSize : 1), pin(pin), nReady(0), exiting(false), externalSent(0) {
+            if (this->nShards < 1)
+                this->nShards = 1;
+            this->shards.resize(this->nShards, nullptr);
+            for (int i = 0; i < this->nShards; ++i)
+                this->threads.emplace_back(new std::thread([this, i]() { this->run_shard(i); }));
+            std::unique_lock<std::mutex> lock(this->readyMutex);
+            this->readyCv.wait(lock, [this]() { return this->nReady == this->nShards; });
+        }
+
+        /**
+         * @brief 析构函数，等待所有任务执行完后停止分片线程
+         */
+        ~sharded_pool() {
+            // 先读处理数，再读发出数，再读一次处理数：处理数不变且等于发出数时，没有排队或正在执行的任务
+            while (true) {
+                std::uint64_t r1 = this->total_received();
+                std::uint64_t s = this->total_sent();
+                std::uint64_t r2 = this->total_received();
+                if (r1 == r2 && s == r1)
+                    break;
+                std::this_thread::yield();
+            }
+            this->exiting = true;
+            for (int i = 0; i < this->nShards; ++i)
+                this->wake(*this->shards[i], true);
+            for (std::size_t i = 0; i < this->threads.size(); ++i)
+                this->threads[i]->join();
+            for (int i = 0; i < this->nShards; ++i)
+                delete this->shards[i];
+        }
+
+        /**
+         * @brief 获取分片数
+         */
+        int size() const { return this->nShards; }
+
+        /**
+         * @brief 当前线程是本线程池的第几个分片，非分片线程返回-1
+         */
+        int current_shard() const {
+            const context & c = current();
+            return c.pool == this ? c.index : -1;
+        }
+
+        /**
+         * @brief 在指定分片上执行f(shard, args...)
+         *
+         * @param shard 目标分片的索引，调用者必须确保 0 <= shard < size()
+         * @return future<R> 从分片提交时在本分片上完成，从其他线程提交时在目标分片上完成
+         *
+         * 参数的保存和传递方式与thread_pool::push()相同
+         */
+        template<typename F, typename... Rest>
+        auto submit_to(int shard, F && f, Rest&&... rest)
+            ->future<typename detail::bound_task<typename std::decay<F>::type, typename std::decay<Rest>::type...>::result_type> {
+            typedef detail::bound_task<typename std::decay<F>::type, typename std::decay<Rest>::type...> bound_type;
+            typedef typename bound_type::result_type R;
+
+            int origin = this->current_shard();
+            call_node<R, bound_type> * n = new call_node<R, bound_type>(*this, origin, std::forward<F>(f), std::forward<Rest>(rest)...);
+            future<R> fut(n);
+            this->send(origin, shard, n);
+            return fut;
+        }
+
+        /**
+         * @brief 等待从本线程提交的任务的结果
+         *
+         * 在分片线程上等待时继续处理本分片的消息，结果送回本分片后返回；在其他线程上等同于f.wait()。
+         * 分片线程上只能等待本线程池在本分片上提交的任务，其他future不会由本分片完成
+         */
+        template <typename T>
+        void wait(const future<T> & f) {
+            int i = this->current_shard();
+            if (i < 0) {
+                f.wait();
+                return;
+            }
+            shard & me = *this->shards[i];
+            while (!f.is_ready()) {
+                if (!this->run_once(me, i))
+                    this->idle(me);
+            }
+        }
+
+    private:
+
+        sharded_pool(const sharded_pool &);// = delete;
+        sharded_pool & operator=(const sharded_pool &);// = delete;
+
+        /**
+         * @brief 一个分片的状态，由分片线程分配
+         *
+         * sent和received只由分片线程写入，析构函数汇总它们判断是否还有任务
+         */
+        struct shard {
+            shard(int nShards, std::size_t ringSize) : rings(nShards), inbox(0), sleeping(false), sent(0), received(0) {
+                for (int s = 0; s < nShards; ++s)
+                    this->rings[s].reset(new detail::spsc_ring(ringSize));
+            }
+
+            std::vector<std::unique_ptr<detail::spsc_ring>> rings;  // rings[s]：来自分片s的消息
+            mpsc_queue inbox;  // 来自非分片线程的任务和环形缓冲区满时的消息
+            std::atomic<bool> sleeping;  // 分片线程正在或即将在cv上等待
+            std::mutex mutex;  // 保护睡眠和唤醒
+            std::condition_variable cv;
+            std::atomic<std::uint64_t> sent;  // 本分片发出的消息数
+            std::atomic<std::uint64_t> received;  // 本分片执行完的消息数
+            char pad[_ctplCacheLineSize_];
+        };
+
+        /**
+         * @brief 当前线程所属的线程池和分片索引
+         */
+        struct context {
+            const sharded_pool * pool;
+            int index;
+        };
+
+        static context & current() {
+            static thread_local context c = { nullptr, -1 };
+            return c;
+        }
+
+        /**
+         * @brief submit_to()创建的任务节点，结果的共享状态也在节点中
+         *
+         * 第一次执行在目标分片上调用f并暂存结果，需要时把自身作为消息送回原分片；
+         * 第二次执行在原分片上设置future的结果
+         */
+        template <typename R, typename F>
+        struct call_node : detail::task_node, detail::future_state<R> {
+            template <typename... U>
+            call_node(sharded_pool & pool, int origin, U &&... u)
+                : pool(pool), origin(origin), done(false), f(std::forward<U>(u)...) {}
+
+            void run(int id) override {
+                if (this->done) {
+                    this->complete();
+                    return;
+                }
+                try {
+                    detail::shard_invoker<R>::run(this->result, this->f, id);
+                }
+                catch (...) {
+                    this->error = std::current_exception();
+                }
+                this->done = true;
+                if (this->origin < 0 || this->origin == id)
+                    this->complete();
+                else
+                    this->pool.send(id, this->origin, this);  // 结果送回原分片
+            }
+
+            void discard() override {
+                if (this->done && !this->error)
+                    detail::shard_invoker<R>::complete(*this, this->result);
+                else
+                    this->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+                this->release();
+            }
+
+            void destroy() override { delete this; }
+
+            // 节点从原分片的每线程缓存中分配
+            static void * operator new(std::size_t size) { return detail::cache_allocate(size); }
+            static void operator delete(void * p) noexcept { detail::cache_deallocate(p); }
+
+            void complete() {
+                if (this->error)
+                    this->set_exception(this->error);
+                else
+                    detail::shard_invoker<R>::complete(*this, this->result);
+                this->release();
+            }
+
+            sharded_pool & pool;
+            int origin;  // 提交任务的分片，非分片线程为-1
+            bool done;  // f已经执行
+            F f;  // 可调用对象，签名为R(int shard)
+            detail::future_value<R> result;  // f的返回值，送回原分片前暂存
+            std::exception_ptr error;  // f抛出的异常
+        };
+
+        /**
+         * @brief 把消息从分片from（非分片线程为-1）送到分片to
+         *
+         * 计数在入队之前增加，析构函数看到的发出数不会少于已经入队的消息数
+         */
+        void send(int from, int to, detail::task_node * node) {
+            shard & target = *this->shards[to];
+            if (from >= 0) {
+                shard & me = *this->shards[from];
+                me.sent.store(me.sent.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                if (!target.rings[from]->push(node))
+                    target.inbox.push(node);  // 环形缓冲区已满
+                if (from == to)
+                    return;  // 分片自己不会在睡眠
+            }
+            else {
+                this->externalSent.fetch_add(1, std::memory_order_relaxed);
+                target.inbox.push(node);
+            }
+            this->wake(target, false);
+        }
+
+        /**
+         * @brief 唤醒正在睡眠的分片；force为true时总是通知，用于停止
+         */
+        void wake(shard & target, bool force) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);  // 入队先于读取睡眠标志
+            if (!force && !target.sleeping.load(std::memory_order_relaxed))
+                return;
+            std::unique_lock<std::mutex> lock(target.mutex);
+            target.sleeping.store(false, std::memory_order_relaxed);
+            target.cv.notify_one();
+        }
+
+        /**
+         * @brief 分片线程的主循环
+         */
+        void run_shard(int i) {
+#if defined(__linux__)
+            if (this->pin) {
+                cpu_set_t allowed;
+                CPU_ZERO(&allowed);
+                if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && CPU_COUNT(&allowed) > 0) {
+                    int k = i % CPU_COUNT(&allowed);
+                    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                        if (CPU_ISSET(cpu, &allowed) && k-- == 0) {
+                            cpu_set_t set;
+                            CPU_ZERO(&set);
+                            CPU_SET(cpu, &set);
+                            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                            break;
+                        }
+                    }
+                }
+            }
+#endif
+            // 绑定之后再分配，分片的状态和接收队列位于本核心的本地内存
+            shard * me = new shard(this->nShards, static_cast<std::size_t>(this->ringSize));
+            context & c = current();
+            c.pool = this;
+            c.index = i;
+            {
+                std::unique_lock<std::mutex> lock(this->readyMutex);
+                this->shards[i] = me;
+                if (++this->nReady == this->nShards)
+                    this->readyCv.notify_all();
+            }
+
+            while (!this->exiting) {
+                if (!this->run_once(*me, i))
+                    this->idle(*me);
+            }
+        }
+
+        /**
+         * @brief 依次处理每个接收队列中的消息，返回是否处理了任何消息
+         */
+        bool run_once(shard & me, int i) {
+            bool any = false;
+            detail::task_node * node;
+            for (int s = 0; s < this->nShards; ++s) {
+                detail::spsc_ring & ring = *me.rings[s];
+                for (int k = 0; k < _ctplShardBatch_ && ring.pop(node); ++k) {
+                    node->run(i);
+                    me.received.store(me.received.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                    any = true;
+                }
+            }
+            for (int k = 0; k < _ctplShardBatch_ && me.inbox.pop(node); ++k) {
+                node->run(i);
+                me.received.store(me.received.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                any = true;
+            }
+            return any;
+        }
+
+        /**
+         * @brief 没有消息时睡眠，直到有生产者唤醒或线程池停止
+         */
+        void idle(shard & me) {
+            me.sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);  // 设置睡眠标志先于检查队列
+            if (this->has_work(me) || this->exiting) {
+                me.sleeping.store(false, std::memory_order_relaxed);
+                return;
+            }
+            std::unique_lock<std::mutex> lock(me.mutex);
+            me.cv.wait(lock, [this, &me]() { return !me.sleeping.load(std::memory_order_relaxed) || this->exiting; });
+            me.sleeping.store(false, std::memory_order_relaxed);
+        }
+
+        bool has_work(shard & me) {
+            for (int s = 0; s < this->nShards; ++s)
+                if (!me.rings[s]->empty())
+                    return true;
+            return !me.inbox.empty();
+        }
+
+        std::uint64_t total_sent() {
+            std::uint64_t n = this->externalSent.load(std::memory_order_acquire);
+            for (int i = 0; i < this->nShards; ++i)
+                n += this->shards[i]->sent.load(std::memory_order_acquire);
+            return n;
+        }
+
+        std::uint64_t total_received() {
+            std::uint64_t n = 0;
+            for (int i = 0; i < this->nShards; ++i)
+                n += this->shards[i]->received.load(std::memory_order_acquire);
+            return n;
+        }
+
+        // 只读：构造完成后不再修改
+        int nShards;
+        int ringSize;
+        bool pin;
+        std::vector<shard *> shards;  // 每个分片的状态，由分片线程分配
+        std::vector<std::unique_ptr<std::thread>> threads;
+
+        // 只在构造时使用
+        std::mutex readyMutex;
+        std::condition_variable readyCv;
+        int nReady;  // 已初始化的分片数，由readyMutex保护
+
+        std::atomic<bool> exiting;  // 析构函数让分片线程退出
+        char pad0[_ctplCacheLineSize_];
+        std::atomic<std::uint64_t> externalSent;  // 非分片线程提交的任务数
+    };
+
+}
+
+#endif // __ctpl_shard_H__
@@ -0,0 +1,298 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 串行执行器 (strand)
+*
+* 在线程池之上按"键"串行执行任务：同一个strand上的任务严格按提交顺序(FIFO)执行，
+* 且任何时刻最多只有一个在运行；不同strand之间的任务可以在线程池中并行执行。
+* 典型用途是按连接、按账户等实体保证顺序，而不必在任务内部为每个实体加锁阻塞工作线程。
+*
+* 主要功能和特点：
+* 1. strand<Pool>：单个串行执行器，接口与thread_pool::push一致，返回ctpl::future，
+*    参数按值保存在任务节点中，支持只能移动的参数
+* 2. keyed_strands<Pool, Key>：按键把任务分配到固定数量的strand上，提供push_keyed(key, f)
+* 3. 适用于ctpl.h和ctpl_stl.h中的thread_pool，通过Pool的post方法提交调度节点
+*
+* 线程安全考量：
+* - strand内部使用互斥锁保护待执行队列和运行标志
+* - 只有在队列从空变为非空时才向线程池提交一次调度节点，
+*   因此一个strand最多占用一个工作线程，空闲时不占用任何工作线程；
+*   调度节点同一时刻最多在线程池队列中出现一次，侵入式队列（mpsc_queue）也可以使用
+* - 线程池stop(false)丢弃调度节点时，strand清除运行标志并丢弃排队的任务（future得到broken_promise），
+*   之后的提交会重新调度
+*
+* 性能考量：
+* - 待执行的任务用节点自身的链接指针串成链表，除任务节点本身外不再分配内存
+* - 每次调度最多连续执行_ctplStrandBatch_个任务，然后重新提交到线程池，
+*   既分摊了调度开销，又避免单个繁忙的strand长期独占工作线程
+*********************************************************/
+
+#ifndef __ctpl_strand_H__
+#define __ctpl_strand_H__
+
+#if !defined(__ctpl_thread_pool_H__) && !defined(__ctpl_stl_thread_pool_H__)
+#include "ctpl_stl.h"  // 没有包含任何线程池实现时，默认使用基于STL的版本
+#endif
+
+#include <functional>  // 用于std::hash
+#include <memory>      // 用于智能指针管理资源
+#include <mutex>       // 用于互斥锁
+#include <type_traits> // 用于std::decay
+#include <utility>     // 用于std::move和std::forward
+#include <vector>      // 用于存储strand
+
+#ifndef _ctplStrandBatch_
+#define _ctplStrandBatch_  64  // 每次调度最多连续执行的任务数
+#endif
+
+namespace ctpl {
+
+    /**
+     * @brief 串行执行器，保证提交到同一strand的任务按FIFO顺序、互不重叠地执行
+     *
+     * @tparam Pool 线程池类型，需要提供post(detail::task_node *)方法（ctpl::thread_pool即可）
+     *
+     * strand对象本身可以拷贝，拷贝出的对象共享同一个执行队列。
+     * 销毁strand不会丢弃已提交的任务，它们会在线程池中继续按顺序执行。
+     */
+    template <typename Pool>
+    class strand {
+
+    public:
+
+        /**
+         * @brief 构造函数，将strand绑定到指定的线程池
+         *
+         * @param pool 执行任务的线程池，其生命周期必须长于所有已提交的任务
+         */
+        explicit strand(Pool & pool) : p(std::make_shared<impl>(pool)) {}
+
+        /**
+         * @brief 提交带参数的任务到strand
+         *
+         * @return future<R> 用于获取任务结果的future对象
+         *
+         * 任务的第一个参数是实际执行它的工作线程索引，与thread_pool::push一致；
+         * 函数和参数按值保存在任务节点中，执行时移动给函数
+         */
+        template<typename F, typename... Rest>
+        auto push(F && f, Rest&&... rest)
+            ->future<typename detail::bound_task<typename std::decay<F>::type, typename std::decay<Rest>::type...>::result_type> {
+            typedef detail::bound_task<typename std::decay<F>::type, typename std::decay<Rest>::type...> bound_type;
+            typedef typename bound_type::result_type R;
+
+            typedef detail::future_task<R, bound_type> task_type;
+            task_type * _f = new task_type(std::forward<F>(f), std::forward<Rest>(rest)...);
+            future<R> fut(_f);
+            this->post(_f);
+            return fut;
+        }
+
+        /**
+         * @brief 提交无额外参数的任务到strand
+         *
+         * @return future<decltype(f(0))> 用于获取任务结果的future对象
+         */
+        template<typename F>
+        auto push(F && f) ->future<decltype(f(0))> {
+            typedef decltype(f(0)) R;
+            typedef detail::future_task<R, typename std::decay<F>::type> task_type;
+            task_type * _f = new task_type(std::forward<F>(f));
+            future<R> fut(_f);
+            this->post(_f);
+            return fut;
+        }
+
+        /**
+         * @brief 获取strand中尚未开始执行的任务数量
+         */
+        int n_pending() {
+            std::unique_lock<std::mutex> lock(this->p->mutex);
+            return this->p->n;
+        }
+
+    private:
+
+        /**
+         * @brief strand的共享状态
+         *
+         * 由strand对象和已提交到线程池的调度节点共同持有，
+         * 因此即使strand对象先被销毁，排队中的任务也能安全执行完毕
+         */
+        struct impl {
+            impl(Pool & pool) : pool(pool), head(nullptr), tail(nullptr), n(0), running(false) {}
+
+            /**
+             * @brief 取出第一个待执行的任务；队列为空时清除running并返回nullptr
+             */
+            detail::task_node * take() {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                detail::task_node * node = this->head;
+                if (!node) {
+                    this->running = false;  // 队列已空，下一次提交会重新调度
+                    return nullptr;
+                }
+                this->head = node->queueNext.load(std::memory_order_relaxed);
+                if (!this->head)
+                    this->tail = nullptr;
+                --this->n;
+                return node;
+            }
+
+            Pool & pool;  // 执行任务的线程池
+            std::mutex mutex;  // 保护以下成员
+            detail::task_node * head;  // 待执行的任务，用节点的queueNext按提交顺序串成链表
+            detail::task_node * tail;  // 链表尾部
+            int n;  // 链表中的任务数
+            bool running;  // 是否已有调度节点在线程池中（排队或执行中）
+        };
+
+        /**
+         * @brief 调度节点：在工作线程上依次执行strand中的任务
+         *
+         * 每次最多执行_ctplStrandBatch_个任务；队列为空时释放自身，不再占用工作线程；
+         * 达到上限而队列仍非空时把自身重新提交到线程池，让其他任务有机会执行。
+         * 节点只在running为true期间存在，且同一时刻最多在线程池队列中出现一次
+         */
+        struct dispatch_node : detail::task_node {
+            explicit dispatch_node(const std::shared_ptr<impl> & sp) : sp(sp) {}
+
+            void run(int id) override {
+                for (int k = 0; k < _ctplStrandBatch_; ++k) {
+                    detail::task_node * task = this->sp->take();
+                    if (!task) {
+                        delete this;
+                        return;
+                    }
+                    task->run(id);  // future_task会捕获任务抛出的异常并在执行后释放自身
+                }
+                this->sp->pool.post(this);  // 达到本次上限，running保持为true，重新排队
+            }
+
+            /**
+             * @brief 线程池清空队列时调用：清除running并丢弃排队的任务，之后的提交会重新调度
+             */
+            void discard() override {
+                detail::task_node * node;
+                {
+                    std::unique_lock<std::mutex> lock(this->sp->mutex);
+                    node = this->sp->head;
+                    this->sp->head = this->sp->tail = nullptr;
+                    this->sp->n = 0;
+                    this->sp->running = false;
+                }
+                while (node) {
+                    detail::task_node * next = node->queueNext.load(std::memory_order_relaxed);
+                    node->discard();  // future得到broken_promise
+                    node = next;
+                }
+                delete this;
+            }
+
+            // 节点从每线程缓存中分配，与callable_node相同
+            static void * operator new(std::size_t size) { return detail::cache_allocate(size); }
+            static void operator delete(void * p) noexcept { detail::cache_deallocate(p); }
+
+            std::shared_ptr<impl> sp;  // 保持共享状态有效
+        };
+
+        /**
+         * @brief 将任务加入队列，队列从空闲变为非空时向线程池提交调度节点
+         */
+        void post(detail::task_node * task) {
+            bool schedule = false;
+            task->queueNext.store(nullptr, std::memory_order_relaxed);
+            {
+                std::unique_lock<std::mutex> lock(this->p->mutex);
+                if (this->p->tail)
+                    this->p->tail->queueNext.store(task, std::memory_order_relaxed);
+                else
+                    this->p->head = task;
+                this->p->tail = task;
+                ++this->p->n;
+                if (!this->p->running) {
+                    this->p->running = true;  // 由本次提交负责调度，其他提交者只需入队
+                    schedule = true;
+                }
+            }
+            if (schedule)
+                this->p->pool.post(new dispatch_node(this->p));
+        }
+
+        std::shared_ptr<impl> p;  // 共享状态
+    };
+
+    /**
+     * @brief 按键分配的一组strand，提供push_keyed(key, f)接口
+     *
+     * @tparam Pool 线程池类型
+     * @tparam Key 键类型，需要可以用Hash计算哈希值
+     * @tparam Hash 哈希函数类型，默认为std::hash<Key>
+     *
+     * 键通过哈希映射到固定数量的strand上：相同键的任务总是按FIFO顺序串行执行，
+     * 不同键的任务通常并行执行；哈希到同一个strand的不同键也会被串行化，
+     * 因此nStrands应明显大于线程池中的线程数。
+     * 使用固定数量的strand而不是每个键一个，使内存占用与键的数量无关。
+     */
+    template <typename Pool, typename Key, typename Hash = std::hash<Key>>
+    class keyed_strands {
+
+    public:
+
+        /**
+         * @brief 构造函数
+         *
+         * @param pool 执行任务的线程池
+         * @param nStrands strand的数量，必须 > 0
+         */
+        keyed_strands(Pool & pool, int nStrands) {
+            this->strands.reserve(nStrands);
+            for (int i = 0; i < nStrands; ++i)
+                this->strands.push_back(strand<Pool>(pool));
+        }
+
+        /**
+         * @brief 提交任务，相同key的任务按提交顺序串行执行
+         */
+        template<typename F, typename... Rest>
+        auto push_keyed(const Key & key, F && f, Rest&&... rest)
+            ->decltype(std::declval<strand<Pool> &>().push(std::forward<F>(f), std::forward<Rest>(rest)...)) {
+            return this->get(key).push(std::forward<F>(f), std::forward<Rest>(rest)...);
+        }
+
+        /**
+         * @brief 获取key对应的strand
+         */
+        strand<Pool> & get(const Key & key) {
+            return this->strands[this->hash(key) % this->strands.size()];
+        }
+
+        /**
+         * @brief 获取strand的数量
+         */
+        int size() { return static_cast<int>(this->strands.size()); }
+
+    private:
+        std::vector<strand<Pool>> strands;  // 固定数量的strand
+        Hash hash;  // 键的哈希函数
+    };
+
+}
+
+#endif // __ctpl_strand_H__
@@ -0,0 +1,246 @@
+/*********************************************************
+ *
+ *  Copyright (C) 2014 by Vitaliy Vitsentiy
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *********************************************************/
+
+/*********************************************************
+* 卡住任务的看门狗
+*
+* 某个任务卡住时，线程池只是n_idle()慢慢变少，没有任何报告。
+* 开启看门狗后，一个后台线程定期检查每个工作线程上正在执行的任务已经执行了多久，
+* 超过阈值时调用回调，报告线程ID、任务的标签和已执行的时间，可选地附上该线程的调用栈：
+*
+*      pool.set_watchdog(std::chrono::seconds(5), [](const ctpl::stuck_task & t) {
+*          std::cerr << "worker " << t.id << " [" << t.label << "] stuck for " << t.elapsed.count() << " ms\n";
+*          for (const std::string & frame : t.stack) std::cerr << "    " << frame << '\n';
+*      }, true);
+*
+* 主要功能和特点：
+* 1. 工作线程每开始一个任务只做一次relaxed写：把看门狗维护的粗粒度时间（毫秒）写入自己的控制块，
+*    不读取时钟；队列为空转入等待时写0
+* 2. 看门狗每隔阈值的1/4推进一次时间并检查所有工作线程，同一个任务只报告一次；
+*    只有确定执行时间已超过阈值的任务才报告，报告最多晚一个检查间隔
+* 3. 任务用push(ctpl::label(...), ...)提交时报告中带有标签名，否则为空
+* 4. 需要调用栈时（仅Linux和glibc），看门狗用tgkill向卡住的线程发送_ctplWatchdogSignal_，
+*    该线程在信号处理函数中用backtrace()记录返回地址，看门狗再把地址转换为符号
+*
+* 线程安全考量：
+* - 回调在看门狗线程上调用，回调执行期间不检查其他线程
+* - 信号处理函数先用CAS把请求的线程ID从自己的ID改为"正在写入"，成功后才写入调用栈；
+*   看门狗超时后用CAS撤销请求，撤销失败说明处理函数正在写入，等它写完再开始下一个请求，
+*   因此迟到的处理函数不会把调用栈写进下一个请求
+* - 安装处理函数时保存原来的处理方式，不是看门狗请求的信号（包括看门狗已经撤销的请求）转交给它，
+*   程序自己的_ctplWatchdogSignal_处理函数不受影响；原来是默认动作或忽略时直接返回，
+*   因此_ctplWatchdogSignal_应是默认动作为忽略的信号
+* - backtrace()第一次调用时可能加载libgcc并分配内存，安装处理函数时先调用一次，
+*   之后在信号处理函数中只遍历栈帧
+* - 只检查工作线程；run_pending()的调用者和备用线程不在检查范围内
+*
+* 性能考量：
+* - 已执行时间的精度为检查间隔（阈值的1/4，至少1毫秒）
+* - 关闭看门狗时工作线程仍然写开始时间，但没有线程读取
+*********************************************************/
+
+#ifndef __ctpl_watchdog_H__
+#define __ctpl_watchdog_H__
+
+#include <atomic>      // 用于信号处理函数和看门狗之间的交接
+#include <chrono>      // 用于阈值和已执行时间
+#include <condition_variable>  // 用于看门狗线程的定时等待
+#include <functional>  // 用于报告回调
+#include <mutex>       // 用于串行化调用栈的捕获
+#include <string>      // 用于标签名和栈帧
+#include <thread>      // 用于看门狗线程和等待信号处理函数
+#include <utility>     // 用于std::move
+#include <vector>      // 用于调用栈
+#if defined(__linux__) && defined(__GLIBC__)
+#include <cerrno>      // 用于在信号处理函数中保存errno
+#include <csignal>     // 用于sigaction
+#include <cstdlib>     // 用于free
+#include <execinfo.h>  // 用于backtrace和backtrace_symbols
+#include <sys/syscall.h>  // 用于SYS_gettid和SYS_tgkill
+#include <unistd.h>    // 用于syscall和getpid
+#endif
+
+#ifndef _ctplWatchdogSignal_
+#define _ctplWatchdogSignal_  SIGURG  // 请求捕获调用栈的信号，默认动作为忽略
+#endif
+
+#ifndef _ctplWatchdogFrames_
+#define _ctplWatchdogFrames_  64  // 捕获的最大栈帧数
+#endif
+
+namespace ctpl {
+
+    /**
+     * @brief 看门狗对一个卡住的任务的报告
+     */
+    struct stuck_task {
+        int id;  // 工作线程索引
+        std::string label;  // 任务的标签名，没有标签时为空
+        std::chrono::milliseconds elapsed;  // 已执行时间的上界，从任务开始前最近一次推进的时间算起，通常最多多出一个检查间隔
+        std::vector<std::string> stack;  // 调用栈，每帧一行（backtrace_symbols的格式）；没有捕获时为空
+    };
+
+    namespace detail {
+        /**
+         * @brief 当前线程的内核线程ID，用于定向发送信号；不支持时为0
+         */
+        inline int current_tid() {
+#if defined(__linux__) && defined(__GLIBC__)
+            return static_cast<int>(syscall(SYS_gettid));
+#else
+            return 0;
+#endif
+        }
+
+#if defined(__linux__) && defined(__GLIBC__)
+        /**
+         * @brief 看门狗和信号处理函数之间交接调用栈的区域，同一时刻只有一个请求
+         */
+        struct stack_request {
+            std::atomic<int> tid;  // 请求的线程ID，0表示没有请求，-tid表示处理函数已认领、正在写入frames
+            std::atomic<bool> done;  // 处理函数已写入frames
+            void * frames[_ctplWatchdogFrames_];
+            int n;
+        };
+
+        inline stack_request & stack_slot() {
+            static stack_request r;
+            return r;
+        }
+
+        /**
+         * @brief 安装看门狗的处理函数之前的处理方式
+         */
+        inline struct sigaction & previous_stack_handler() {
+            static struct sigaction old;
+            return old;
+        }
+
+        inline void on_stack_signal(int sig, siginfo_t * info, void * context) {
+            stack_request & r = stack_slot();
+            const int saved = errno;
+            const int tid = current_tid();
+            int expected = tid;
+            if (r.tid.compare_exchange_strong(expected, -tid, std::memory_order_acquire)) {  // 认领发给本线程的请求
+                r.n = backtrace(r.frames, _ctplWatchdogFrames_);
+                r.done.store(true, std::memory_order_release);
+                errno = saved;
+                return;
+            }
+            errno = saved;
+            // 不是看门狗发给本线程的请求，或请求已被撤销：转交给原来的处理函数
+            const struct sigaction & old = previous_stack_handler();
+            if (old.sa_flags & SA_SIGINFO) {
+                if (old.sa_sigaction)
+                    old.sa_sigaction(sig, info, context);
+            }
+            else if (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN) {
+                old.sa_handler(sig);
+            }
+        }
+
+        /**
+         * @brief 安装信号处理函数，只安装一次
+         */
+        inline void install_stack_handler() {
+            static std::once_flag once;
+            std::call_once(once, []() {
+                void * warm[1];
+                backtrace(warm, 1);  // 预先加载libgcc，信号处理函数中不再分配内存
+                struct sigaction sa;
+                sa.sa_sigaction = &on_stack_signal;
+                sigemptyset(&sa.sa_mask);
+                sa.sa_flags = SA_RESTART | SA_SIGINFO;
+                sigaction(_ctplWatchdogSignal_, &sa, &previous_stack_handler());  // 返回前写入原来的处理方式
+            });
+        }
+#endif
+
+        /**
+         * @brief 捕获线程tid的调用栈，等待至多timeout；不支持或超时时返回空
+         */
+        inline std::vector<std::string> capture_stack(int tid, std::chrono::milliseconds timeout) {
+            std::vector<std::string> result;
+#if defined(__linux__) && defined(__GLIBC__)
+            if (!tid)
+                return result;
+            static std::mutex m;  // 多个线程池的看门狗共用一个交接区域
+            std::unique_lock<std::mutex> lock(m);
+            install_stack_handler();
+            stack_request & r = stack_slot();
+            r.done.store(false, std::memory_order_relaxed);
+            r.tid.store(tid, std::memory_order_release);
+            if (syscall(SYS_tgkill, static_cast<int>(getpid()), tid, _ctplWatchdogSignal_) == 0) {
+                std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+                while (!r.done.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < deadline)
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            int expected = tid;
+            if (!r.tid.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) {
+                while (!r.done.load(std::memory_order_acquire))
+                    std::this_thread::yield();  // 处理函数已认领请求，等它写完，backtrace()很快返回
+                r.tid.store(0, std::memory_order_relaxed);
+            }
+            if (r.done.load(std::memory_order_acquire)) {
+                char ** symbols = backtrace_symbols(r.frames, r.n);
+                if (symbols) {
+                    for (int i = 0; i < r.n; ++i)
+                        result.push_back(symbols[i]);
+                    free(symbols);
+                }
+            }
+#else
+            (void)tid;
+            (void)timeout;
+#endif
+            return result;
+        }
+
+        /**
+         * @brief 一个看门狗线程的配置和停止信号
+         */
+        struct watchdog_control {
+            watchdog_control(std::chrono::milliseconds threshold, std::function<void(const stuck_task &)> report, bool captureStack)
+                : threshold(threshold), report(std::move(report)), captureStack(captureStack), quit(false) {}
+
+            /**
+             * @brief 让看门狗线程退出并等待它结束
+             */
+            void shutdown() {
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->quit = true;
+                }
+                this->cv.notify_all();
+                if (this->thread.joinable())
+                    this->thread.join();
+            }
+
+            std::chrono::milliseconds threshold;  // 报告的阈值
+            std::function<void(const stuck_task &)> report;  // 在看门狗线程上调用
+            bool captureStack;  // 是否捕获调用栈
+            std::mutex mutex;  // 保护quit
+            std::condition_variable cv;
+            bool quit;
+            std::thread thread;
+        };
+    }
+
+}
+
+#endif // __ctpl_watchdog_H__
@@ -1,5 +1,6 @@
 #include <ctpl.h>      // 包含线程池头文件，使用基于Boost.Lockfree的实现
 #include <iostream>    // 用于标准输入输出
+#include <memory>      // 用于std::unique_ptr
 #include <string>      // 用于字符串处理
 
 /**
@@ -213,6 +214,11 @@ int main(int argc, char **argv) {
     // 直接传递临时对象，避免了命名对象的构造和析构
     p.push(ugu, Third(200));
 
+    // 参数按值保存在任务节点中，执行时移动给函数，因此可以传递只能移动的参数
+    p.push([](int id, std::unique_ptr<Third> t) {
+        std::cout << "hello from " << id << ", unique_ptr parameter Third " << t->v << '\n';
+    }, std::unique_ptr<Third>(new Third(300)));
+
     //==================================================================
     // 4. Lambda表达式测试
     //==================================================================
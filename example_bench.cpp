@@ -0,0 +1,110 @@
+#include <ctpl_stl.h>  // 包含线程池头文件，使用基于标准库的实现
+#include <atomic>      // 用于完成计数
+#include <chrono>      // 用于计时
+#include <cstdio>      // 用于输出结果
+#include <cstdlib>     // 用于解析命令行参数
+#include <cstring>     // 用于memset
+#include <thread>      // 用于生产者线程
+#include <vector>      // 用于保存生产者线程
+#if defined(__linux__)
+#include <linux/perf_event.h>  // 用于读取缓存未命中计数
+#include <sys/syscall.h>       // 用于SYS_perf_event_open
+#include <unistd.h>            // 用于read和close
+#endif
+
+/**
+ * 多生产者压力测试：测量push()的吞吐量和缓存未命中次数
+ *
+ * 几个生产者线程同时push()空任务，工作线程执行后增加完成计数。
+ * 生产者按批提交并在批之间短暂停顿，使工作线程反复进入和离开等待，
+ * 从而频繁修改nWaiting和各自的控制块。
+ * 线程池共享状态的缓存行布局只有在多个核心上才可能有差别，目前还没有多核上的测量结果，
+ * 在单核上新旧布局的耗时相同；比较布局时应在多核机器上对新旧版本分别运行。
+ *
+ * 编译和运行：
+ *      g++ -std=c++11 -O2 -I. example_bench.cpp -o example_bench -pthread
+ *      ./example_bench [线程数] [生产者数] [每个生产者的任务数]
+ *
+ * 在Linux上通过perf_event_open统计整个进程（包括之后创建的线程）的缓存未命中次数，
+ * 不允许访问性能计数器时（perf_event_paranoid过高或虚拟机不支持）只输出耗时。
+ */
+
+/**
+ * @brief 打开进程的缓存未命中计数器，失败时返回-1
+ *
+ * 设置inherit，计数器也统计之后创建的线程；线程退出时其计数并入此计数器，
+ * 因此必须在创建线程池之前打开，在线程池析构之后读取。
+ */
+static int open_cache_misses() {
+#if defined(__linux__)
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief 读取并关闭计数器，失败时返回-1
+ */
+static long long close_cache_misses(int fd) {
+    long long value = -1;
+#if defined(__linux__)
+    if (fd >= 0) {
+        if (read(fd, &value, sizeof(value)) != static_cast<ssize_t>(sizeof(value)))
+            value = -1;
+        close(fd);
+    }
+#else
+    (void)fd;
+#endif
+    return value;
+}
+
+int main(int argc, char **argv) {
+    unsigned hw = std::thread::hardware_concurrency();
+    int nThreads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(hw ? hw : 4);
+    int nProducers = argc > 2 ? std::atoi(argv[2]) : 4;
+    int perProducer = argc > 3 ? std::atoi(argv[3]) : 200000;
+    const int burst = 64;  // 每批提交的任务数，批之间让出CPU，使工作线程进入等待
+
+    std::atomic<long long> done(0);
+    long long total = static_cast<long long>(nProducers) * perProducer;
+
+    int fd = open_cache_misses();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        ctpl::thread_pool p(nThreads);
+        std::vector<std::thread> producers;
+        for (int k = 0; k < nProducers; ++k) {
+            producers.emplace_back([&p, &done, perProducer, burst]() {
+                for (int i = 0; i < perProducer; ++i) {
+                    p.push([&done](int) { done.fetch_add(1, std::memory_order_relaxed); });
+                    if (i % burst == burst - 1)
+                        std::this_thread::yield();
+                }
+            });
+        }
+        for (std::thread & t : producers)
+            t.join();
+        while (done.load(std::memory_order_relaxed) < total)
+            std::this_thread::yield();
+    }  // 线程池析构，工作线程退出，它们的计数并入计数器
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long long misses = close_cache_misses(fd);
+
+    std::printf("threads=%d producers=%d tasks=%lld\n", nThreads, nProducers, total);
+    std::printf("time: %.3f s, %.0f tasks/s\n", seconds, total / seconds);
+    if (misses >= 0)
+        std::printf("cache-misses: %lld (%.2f per task)\n", misses, static_cast<double>(misses) / total);
+    else
+        std::printf("cache-misses: n/a (perf_event_open not permitted)\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*********************************************************
+* ctpl_alloc.h的基准：每次push()+get()调用全局operator new的次数
+*
+* 替换全局operator new并计数。先预热一轮，再统计稳定运行时每次push()+get()的分配次数。
+* 作为对照，按引入ctpl_alloc.h之前的做法（make_shared<packaged_task>加new std::function）
+* 提交同样的任务：
+*      g++ -std=c++11 -O2 -I. tests/bench_alloc.cpp -o bench_alloc -pthread
+*      ./bench_alloc [每轮的任务数]
+*
+* 任务节点和结果都来自每线程缓存，稳定运行时不再分配；
+* thread_pool（mutex_queue）剩下的分配来自std::deque，每64个任务一次512字节的块。
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_queue.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于分配计数
+#include <cstdio>      // 用于输出结果
+#include <cstdlib>     // 用于malloc、free和解析命令行参数
+#include <functional>  // 用于对照组的std::function
+#include <future>      // 用于对照组的std::packaged_task
+#include <memory>      // 用于对照组的std::make_shared
+#include <new>         // 用于std::bad_alloc
+
+static std::atomic<long long> nNew(0);  // 全局operator new的调用次数
+
+// 不内联替换的operator new/delete，否则GCC看到new表达式和free配对时给出-Wmismatched-new-delete
+#if defined(__GNUC__)
+#define CTPL_TEST_NOINLINE __attribute__((noinline))
+#else
+#define CTPL_TEST_NOINLINE
+#endif
+
+CTPL_TEST_NOINLINE void * operator new(std::size_t n) {
+    nNew.fetch_add(1, std::memory_order_relaxed);
+    void * p = std::malloc(n ? n : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+CTPL_TEST_NOINLINE void operator delete(void * p) noexcept { std::free(p); }
+CTPL_TEST_NOINLINE void operator delete(void * p, std::size_t) noexcept { std::free(p); }
+
+/**
+ * @brief 预热一轮后，返回每次submit(i)的平均分配次数
+ *
+ * @param submit 提交一个任务并等待结果，返回结果
+ */
+template <typename Submit>
+static double allocations_per_push(int n, Submit submit) {
+    for (int round = 0; round < 2; ++round) {
+        long long before = nNew.load();
+        long long sum = 0;
+        for (int i = 0; i < n; ++i)
+            sum += submit(i);
+        CHECK(sum == static_cast<long long>(n) * (n - 1) / 2);
+        if (round == 1)
+            return static_cast<double>(nNew.load() - before) / n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 用线程池的push()提交
+ */
+template <typename Pool>
+static double pool_allocations(Pool & pool, int n) {
+    return allocations_per_push(n, [&pool](int i) { return pool.push([i](int) { return i; }).get(); });
+}
+
+/**
+ * @brief 引入ctpl_alloc.h之前push()的分配方式：共享的packaged_task加一个std::function节点
+ */
+template <typename Pool>
+static double baseline_allocations(Pool & pool, int n) {
+    return allocations_per_push(n, [&pool](int i) {
+        auto pck = std::make_shared<std::packaged_task<int(int)>>([i](int) { return i; });
+        std::future<int> f = pck->get_future();
+        std::function<void(int)> * node = new std::function<void(int)>([pck](int id) { (*pck)(id); });
+        pool.push([node](int id) { (*node)(id); delete node; });
+        return f.get();
+    });
+}
+
+int main(int argc, char ** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    std::printf("%-34s %s\n", "", "operator new per push+get");
+    {
+        ctpl::basic_thread_pool<ctpl::mpsc_queue> pool(1);
+        double before = baseline_allocations(pool, n);
+        double after = pool_allocations(pool, n);
+        std::printf("%-34s %.3f\n", "make_shared + std::function", before);
+        std::printf("%-34s %.3f\n", "push(), mpsc_queue", after);
+        CHECK(after < 0.01);  // 稳定运行时不分配
+        CHECK(before >= 2.0);
+    }
+    {
+        ctpl::basic_thread_pool<ctpl::ring_queue> pool(2);
+        double after = pool_allocations(pool, n);
+        std::printf("%-34s %.3f\n", "push(), ring_queue", after);
+        CHECK(after < 0.01);
+    }
+    {
+        ctpl::thread_pool pool(2);
+        double after = pool_allocations(pool, n);
+        std::printf("%-34s %.3f\n", "push(), thread_pool (std::deque)", after);
+        CHECK(after < 0.05);  // 只有std::deque的块
+    }
+    std::printf("bench_alloc passed\n");
+    return 0;
+}
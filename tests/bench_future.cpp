@@ -0,0 +1,109 @@
+/*********************************************************
+* ctpl_future.h的基准：push()+get()往返的耗时，ctpl::future与std::future对比
+*
+* 对照组按push()返回std::future时的做法提交同样的任务：
+* make_shared<packaged_task>取得std::future，再把执行packaged_task的lambda交给线程池。
+* 两种模式：
+* - 批量：先push()一批任务，再依次get()，测量每个任务的提交、执行和取结果的开销
+* - 同步：每次push()后立即get()，多数时间花在唤醒工作线程和等待者的上下文切换上
+*      g++ -std=c++11 -O2 -I. tests/bench_future.cpp -o bench_future -pthread
+*      ./bench_future [每批的任务数] [批数]
+*
+* 输出每个任务的纳秒数和对照组/ctpl::future的比值，比值与机器和核心数有关，这里不做检查。
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_queue.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <chrono>      // 用于计时
+#include <cstdio>      // 用于输出结果
+#include <cstdlib>     // 用于解析命令行参数
+#include <future>      // 用于对照组的std::packaged_task和std::future
+#include <memory>      // 用于对照组的std::make_shared
+#include <vector>      // 用于保存一批future
+
+/**
+ * @brief 对照组：返回std::future的提交方式
+ */
+template <typename Pool>
+static std::future<int> std_push(Pool & pool, int i) {
+    auto pck = std::make_shared<std::packaged_task<int(int)>>([i](int) { return i; });
+    std::future<int> f = pck->get_future();
+    pool.push([pck](int id) { (*pck)(id); });
+    return f;
+}
+
+template <typename Pool>
+static ctpl::future<int> ctpl_push(Pool & pool, int i) {
+    return pool.push([i](int) { return i; });
+}
+
+/**
+ * @brief 批量模式：每批先提交batch个任务再取结果，返回每个任务的纳秒数
+ */
+template <typename Future, typename Pool, typename Push>
+static double batched(Pool & pool, int batch, int rounds, Push push) {
+    std::vector<Future> fs;
+    fs.reserve(batch);
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < batch; ++i)
+            fs.push_back(push(pool, i));
+        long long sum = 0;
+        for (Future & f : fs)
+            sum += f.get();
+        CHECK(sum == static_cast<long long>(batch) * (batch - 1) / 2);
+        fs.clear();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / (static_cast<double>(batch) * rounds);
+}
+
+/**
+ * @brief 同步模式：每次提交后立即取结果，返回每个任务的纳秒数
+ */
+template <typename Pool, typename Push>
+static double synchronous(Pool & pool, int n, Push push) {
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    long long sum = 0;
+    for (int i = 0; i < n; ++i)
+        sum += push(pool, i).get();
+    CHECK(sum == static_cast<long long>(n) * (n - 1) / 2);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+}
+
+/**
+ * @brief 在一个线程池上比较两种future，每种测两次取较小值
+ */
+template <typename Pool>
+static void compare(const char * name, Pool & pool, int batch, int rounds) {
+    double stdBatch = 0, ctplBatch = 0, stdSync = 0, ctplSync = 0;
+    for (int k = 0; k < 2; ++k) {
+        double a = batched<std::future<int>>(pool, batch, rounds, std_push<Pool>);
+        double b = batched<ctpl::future<int>>(pool, batch, rounds, ctpl_push<Pool>);
+        double c = synchronous(pool, batch, std_push<Pool>);
+        double d = synchronous(pool, batch, ctpl_push<Pool>);
+        if (k == 0 || a < stdBatch) stdBatch = a;
+        if (k == 0 || b < ctplBatch) ctplBatch = b;
+        if (k == 0 || c < stdSync) stdSync = c;
+        if (k == 0 || d < ctplSync) ctplSync = d;
+    }
+    std::printf("%-22s %-12s %12.0f %14.0f %8.2f\n", name, "batched", stdBatch, ctplBatch, stdBatch / ctplBatch);
+    std::printf("%-22s %-12s %12.0f %14.0f %8.2f\n", name, "synchronous", stdSync, ctplSync, stdSync / ctplSync);
+}
+
+int main(int argc, char ** argv) {
+    const int batch = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const int rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    std::printf("%-22s %-12s %12s %14s %8s\n", "pool", "mode", "std ns/task", "ctpl ns/task", "ratio");
+    {
+        ctpl::basic_thread_pool<ctpl::mpsc_queue> pool(1);
+        compare("mpsc_queue, 1 thread", pool, batch, rounds);
+    }
+    {
+        ctpl::thread_pool pool(4);
+        compare("thread_pool, 4 threads", pool, batch, rounds);
+    }
+    std::printf("bench_future passed\n");
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*********************************************************
+* ctpl_io.h的基准：队列深度64的随机4K读
+*
+* 创建一个临时文件，每个4K块的开头写入块号。64个"通道"各保持一个读请求在途，
+* 续体在线程池上检查读到的块号后立即提交本通道的下一个随机读，直到读满指定次数。
+* 依次测量io_uring加注册缓冲区、io_uring普通缓冲区和回退线程三种方式（io_uring不可用时只测回退线程）：
+*      g++ -std=c++11 -O2 -I. tests/bench_io.cpp -o bench_io -pthread
+*      ./bench_io [文件大小MiB] [读次数] [目录] [O_DIRECT: 0或1]
+*
+* 不用O_DIRECT时读请求多数命中页缓存，测到的是提交和完成路径的开销；
+* 测量磁盘时应使用O_DIRECT和比内存大的文件。目录所在的文件系统不支持O_DIRECT（如tmpfs）时退回普通读。
+* ThreadSanitizer看不到经过内核提交队列和完成队列的同步，io_uring路径下的报告是误报。
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_io.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <algorithm>   // 用于std::max
+#include <atomic>      // 用于请求计数
+#include <chrono>      // 用于计时
+#include <condition_variable>  // 用于等待所有通道结束
+#include <cstdio>      // 用于输出结果
+#include <cstdlib>     // 用于解析命令行参数、posix_memalign和free
+#include <cstring>     // 用于memcpy
+#include <mutex>       // 用于等待所有通道结束
+#include <string>      // 用于临时文件路径
+#include <vector>      // 用于路径缓冲区
+#include <fcntl.h>     // 用于open和O_DIRECT
+#include <sys/uio.h>   // 用于iovec
+#include <unistd.h>    // 用于mkstemp、pwrite、fsync和unlink
+
+static const int depth = 64;  // 队列深度，即同时在途的读请求数
+static const unsigned blockSize = 4096;
+
+/**
+ * @brief 一次测量的共享状态，每个通道持有buffer中自己的一个块
+ */
+struct run_state {
+    ctpl::io_context<ctpl::thread_pool> * io;
+    int fd;
+    bool fixed;  // 是否使用注册缓冲区
+    unsigned long long nBlocks;
+    long long total;  // 总读次数
+    unsigned char * buffer;  // depth个块，按块对齐
+    std::atomic<long long> issued;
+    std::atomic<int> lanesLeft;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+/**
+ * @brief 一个通道：读完一个块后检查块号，再提交下一个随机读
+ */
+struct lane {
+    void issue() {
+        this->rng ^= this->rng << 13;
+        this->rng ^= this->rng >> 7;
+        this->rng ^= this->rng << 17;
+        this->block = this->rng % this->st->nBlocks;
+        unsigned char * buf = this->st->buffer + static_cast<std::size_t>(this->index) * blockSize;
+        lane * self = this;
+        if (this->st->fixed)
+            this->st->io->async_read_fixed(this->st->fd, 0, buf, blockSize, this->block * blockSize, [self](int, long res) { self->done(res); });
+        else
+            this->st->io->async_read(this->st->fd, buf, blockSize, this->block * blockSize, [self](int, long res) { self->done(res); });
+    }
+
+    void done(long res) {
+        CHECK(res == static_cast<long>(blockSize));
+        unsigned long long seen;
+        std::memcpy(&seen, this->st->buffer + static_cast<std::size_t>(this->index) * blockSize, sizeof(seen));
+        CHECK(seen == this->block);
+        if (this->st->issued.fetch_add(1) < this->st->total) {
+            this->issue();
+            return;
+        }
+        if (this->st->lanesLeft.fetch_sub(1) == 1) {
+            std::unique_lock<std::mutex> lock(this->st->mutex);
+            this->st->cv.notify_all();
+        }
+    }
+
+    run_state * st;
+    int index;
+    unsigned long long rng;  // xorshift64的状态
+    unsigned long long block;  // 正在读的块号
+};
+
+/**
+ * @brief 以队列深度64读total次，返回每秒读次数；useUring为true但io_uring不可用时返回-1
+ */
+static double run(ctpl::thread_pool & pool, int fd, unsigned long long nBlocks, long long total,
+                  unsigned char * buffer, bool useUring, bool fixed) {
+    ctpl::io_context<ctpl::thread_pool> io(pool, 256, useUring);
+    if (useUring && !io.is_uring())
+        return -1;
+    if (fixed) {
+        iovec iov;
+        iov.iov_base = buffer;
+        iov.iov_len = static_cast<std::size_t>(depth) * blockSize;
+        CHECK(io.register_buffers(&iov, 1));
+    }
+    run_state st;
+    st.io = &io;
+    st.fd = fd;
+    st.fixed = fixed;
+    st.nBlocks = nBlocks;
+    st.total = total;
+    st.buffer = buffer;
+    st.issued = depth;  // 每个通道的第一个读
+    st.lanesLeft = depth;
+    std::vector<lane> lanes(depth);
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < depth; ++i) {
+        lanes[i].st = &st;
+        lanes[i].index = i;
+        lanes[i].rng = 0x9E3779B97F4A7C15ull * (i + 1);
+        lanes[i].issue();
+    }
+    {
+        std::unique_lock<std::mutex> lock(st.mutex);
+        st.cv.wait(lock, [&st]() { return st.lanesLeft.load() == 0; });
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (fixed)
+        CHECK(io.unregister_buffers());
+    return static_cast<double>(std::max<long long>(total, depth)) / seconds;
+}
+
+int main(int argc, char ** argv) {
+    const long long mib = argc > 1 ? std::atoll(argv[1]) : 64;
+    const long long total = argc > 2 ? std::atoll(argv[2]) : 200000;
+    const std::string dir = argc > 3 ? argv[3] : "/tmp";
+    const bool direct = argc > 4 && std::atoi(argv[4]) != 0;
+    const unsigned long long nBlocks = static_cast<unsigned long long>(mib) * 1024 * 1024 / blockSize;
+    CHECK(nBlocks > 0);
+
+    // 创建文件：每块的开头是块号
+    std::string path = dir + "/ctpl_bench_io_XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    int wfd = mkstemp(name.data());
+    CHECK(wfd >= 0);
+    void * mem = nullptr;
+    CHECK(posix_memalign(&mem, blockSize, static_cast<std::size_t>(depth) * blockSize) == 0);
+    unsigned char * buffer = static_cast<unsigned char *>(mem);
+    std::vector<unsigned char> block(blockSize, 0xA5);
+    for (unsigned long long b = 0; b < nBlocks; ++b) {
+        std::memcpy(block.data(), &b, sizeof(b));
+        CHECK(pwrite(wfd, block.data(), blockSize, static_cast<off_t>(b * blockSize)) == static_cast<ssize_t>(blockSize));
+    }
+    CHECK(fsync(wfd) == 0);
+    int fd = wfd;
+#if defined(O_DIRECT)
+    if (direct) {
+        fd = open(name.data(), O_RDONLY | O_DIRECT);
+        if (fd < 0) {
+            std::printf("O_DIRECT not supported in %s, using buffered reads\n", dir.c_str());
+            fd = wfd;
+        }
+    }
+#endif
+    unlink(name.data());
+
+    ctpl::thread_pool pool(4);
+    std::printf("random 4K reads, queue depth %d, %lld MiB file, %lld reads%s\n",
+                depth, mib, total, fd != wfd ? ", O_DIRECT" : "");
+    double uringFixed = run(pool, fd, nBlocks, total, buffer, true, true);
+    if (uringFixed < 0)
+        std::printf("%-26s unavailable\n", "io_uring");
+    else {
+        std::printf("%-26s %10.0f IOPS\n", "io_uring, fixed buffers", uringFixed);
+        std::printf("%-26s %10.0f IOPS\n", "io_uring", run(pool, fd, nBlocks, total, buffer, true, false));
+    }
+    std::printf("%-26s %10.0f IOPS\n", "fallback threads", run(pool, fd, nBlocks, total, buffer, false, false));
+
+    if (fd != wfd)
+        close(fd);
+    close(wfd);
+    std::free(mem);
+    std::printf("bench_io passed\n");
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*********************************************************
+* ctpl_queue.h的基准：单工作线程多生产者时，mpsc_queue与多消费者队列的对比
+*
+* 线程池只有一个工作线程，若干生产者线程同时post()预先分配的任务节点，
+* 工作线程执行节点（计数加一）。分别统计生产者的提交耗时和全部执行完的总耗时，
+* 队列依次为mpsc_queue、mutex_queue、ring_queue，以及Boost可用时的lockfree_queue（ctpl.h）：
+*      g++ -std=c++11 -O2 -I. tests/bench_mpsc.cpp -o bench_mpsc -pthread
+*      ./bench_mpsc [每个生产者的任务数]
+*
+* 生产者数多于核心数时，提交耗时主要取决于调度，而不是队列本身。
+* ThreadSanitizer在Boost.Lockfree的空闲链表中的报告来自它有意的无同步读取，与本库无关。
+*********************************************************/
+
+#if defined(__has_include)
+#if __has_include(<boost/lockfree/queue.hpp>)
+#define CTPL_BENCH_BOOST 1
+#endif
+#endif
+
+#if defined(CTPL_BENCH_BOOST)
+#include <ctpl.h>      // 提供lockfree_queue
+#else
+#include <ctpl_stl.h>
+#endif
+#include <ctpl_queue.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于执行计数
+#include <chrono>      // 用于计时
+#include <cstdio>      // 用于输出结果
+#include <cstdlib>     // 用于解析命令行参数
+#include <thread>      // 用于生产者线程
+#include <vector>      // 用于任务节点和生产者线程
+
+/**
+ * @brief 执行时只增加计数的任务节点，由测试持有，不释放自己
+ */
+struct count_node : ctpl::detail::task_node {
+    void run(int) override { this->count->fetch_add(1, std::memory_order_relaxed); }
+    void discard() override {}
+
+    std::atomic<long> * count;
+};
+
+/**
+ * @brief 用nProducers个生产者各提交n个节点，输出每个任务的提交耗时和端到端耗时（纳秒）
+ */
+template <typename Queue>
+static void run(const char * name, int nProducers, int n) {
+    ctpl::basic_thread_pool<Queue> pool(1, 1 << 16);
+    std::atomic<long> count(0);
+    std::vector<count_node> nodes(static_cast<std::size_t>(nProducers) * n);
+    for (count_node & x : nodes)
+        x.count = &count;
+    std::atomic<int> ready(0);
+    std::atomic<long long> pushNs(0);
+    std::vector<std::thread> producers;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int p = 0; p < nProducers; ++p) {
+        producers.emplace_back([&, p]() {
+            ++ready;
+            while (ready != nProducers)
+                std::this_thread::yield();  // 所有生产者同时开始
+            std::chrono::steady_clock::time_point s = std::chrono::steady_clock::now();
+            count_node * mine = &nodes[static_cast<std::size_t>(p) * n];
+            for (int i = 0; i < n; ++i)
+                pool.post(mine + i);
+            pushNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s).count();
+        });
+    }
+    for (std::thread & t : producers)
+        t.join();
+    pool.wait_idle();
+    double total = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    const long expected = static_cast<long>(nProducers) * n;
+    CHECK(count.load() == expected);
+    std::printf("%-16s %9d %12.1f %12.1f\n", name, nProducers,
+                static_cast<double>(pushNs.load()) / expected, total / expected);
+}
+
+int main(int argc, char ** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    std::printf("%-16s %9s %12s %12s\n", "queue", "producers", "post ns", "total ns");
+    const int producers[] = { 1, 2, 4, 8 };
+    for (int p : producers) {
+        run<ctpl::mpsc_queue>("mpsc_queue", p, n);
+        run<ctpl::mutex_queue>("mutex_queue", p, n);
+        run<ctpl::ring_queue>("ring_queue", p, n);
+#if defined(CTPL_BENCH_BOOST)
+        run<ctpl::lockfree_queue>("lockfree_queue", p, n);
+#endif
+    }
+    std::printf("bench_mpsc passed\n");
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*********************************************************
+* ctpl_reactor.h的测试和基准：socketpair上的回显和往返延迟
+*
+* 服务端是socketpair的一端，由处理函数把读到的数据原样写回；客户端线程在另一端发送一个字节并阻塞读取回显。
+* 检查每次回显的内容，对端关闭后处理函数返回false、监视被取消，以及领导者在epoll_wait()中时
+* push()的普通任务仍能执行。再与"单独的epoll线程加push()"对比单字节往返延迟：
+*      g++ -std=c++11 -O2 -I. tests/bench_reactor.cpp -o bench_reactor -pthread
+*      ./bench_reactor [往返次数]
+*
+* 只能在Linux上使用。单核机器上多个工作线程时，交接领导者的唤醒也是一次上下文切换。
+* ThreadSanitizer报告的revents交接由内核中的epoll_ctl()排序，是误报。
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_reactor.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <algorithm>   // 用于std::sort
+#include <atomic>      // 用于停止标志和计数
+#include <cerrno>      // 用于EAGAIN
+#include <chrono>      // 用于计时
+#include <cstdio>      // 用于输出结果
+#include <cstdlib>     // 用于解析命令行参数
+#include <thread>      // 用于客户端线程和对照组的epoll线程
+#include <vector>      // 用于延迟样本
+#include <fcntl.h>     // 用于O_NONBLOCK
+#include <sys/epoll.h> // 用于对照组
+#include <sys/socket.h> // 用于socketpair
+#include <unistd.h>    // 用于read、write和close
+
+/**
+ * @brief 读完所有数据并原样写回，对端关闭或出错时返回false
+ */
+static bool echo(int fd) {
+    char buf[256];
+    for (;;) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n > 0) {
+            CHECK(::write(fd, buf, static_cast<std::size_t>(n)) == n);
+            continue;
+        }
+        return n < 0 && errno == EAGAIN;  // n == 0：对端已关闭
+    }
+}
+
+/**
+ * @brief 客户端：发送n个字节，每个等待回显，返回往返延迟的中位数和99分位（微秒）
+ */
+static void ping(int fd, int n, double & median, double & p99) {
+    std::vector<double> us(n);
+    for (int i = 0; i < n; ++i) {
+        char out = static_cast<char>(i), in = 0;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        CHECK(::write(fd, &out, 1) == 1);
+        CHECK(::read(fd, &in, 1) == 1);
+        us[i] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        CHECK(in == out);
+    }
+    std::sort(us.begin(), us.end());
+    median = us[n / 2];
+    p99 = us[n * 99 / 100];
+}
+
+/**
+ * @brief 创建socketpair，服务端sv[0]为非阻塞
+ */
+static void make_pair(int sv[2]) {
+    CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    CHECK(::fcntl(sv[0], F_SETFL, ::fcntl(sv[0], F_GETFL) | O_NONBLOCK) == 0);
+}
+
+/**
+ * @brief 经过reactor的往返延迟
+ */
+static void via_reactor(int nThreads, int n) {
+    ctpl::thread_pool pool(nThreads);
+    ctpl::reactor<ctpl::thread_pool> r(pool);
+    int sv[2];
+    make_pair(sv);
+    r.watch(sv[0], EPOLLIN, [](int, unsigned) { return true; });  // 不活动的描述符，关闭回显端后它仍被监视
+    int pv[2];
+    make_pair(pv);
+    r.watch(pv[0], EPOLLIN, [&pv](int, unsigned) { return echo(pv[0]); });
+    double median, p99;
+    ping(pv[1], n, median, p99);
+    std::printf("%-30s %2d %10.1f %10.1f\n", "reactor", nThreads, median, p99);
+    ::close(pv[1]);  // 处理函数读到0后返回false，取消监视
+    while (r.size() != 1)
+        std::this_thread::yield();
+    ::close(pv[0]);
+    ::close(sv[0]);
+    ::close(sv[1]);
+}
+
+/**
+ * @brief 对照组：单独的epoll线程在描述符就绪时push()处理函数，处理完后重新启用
+ */
+static void via_epoll_thread(int nThreads, int n) {
+    ctpl::thread_pool pool(nThreads);
+    int pv[2];
+    make_pair(pv);
+    int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+    CHECK(epfd >= 0);
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = pv[0];
+    CHECK(::epoll_ctl(epfd, EPOLL_CTL_ADD, pv[0], &ev) == 0);
+    std::atomic<bool> quit(false);
+    std::thread poller([&]() {
+        epoll_event e;
+        while (!quit) {
+            if (::epoll_wait(epfd, &e, 1, 10) != 1)
+                continue;
+            pool.push([&, epfd](int) {
+                if (echo(pv[0])) {
+                    epoll_event again = {};
+                    again.events = EPOLLIN | EPOLLONESHOT;
+                    again.data.fd = pv[0];
+                    ::epoll_ctl(epfd, EPOLL_CTL_MOD, pv[0], &again);
+                }
+            });
+        }
+    });
+    double median, p99;
+    ping(pv[1], n, median, p99);
+    std::printf("%-30s %2d %10.1f %10.1f\n", "epoll thread + push()", nThreads, median, p99);
+    quit = true;
+    poller.join();
+    pool.stop(true);
+    ::close(epfd);
+    ::close(pv[0]);
+    ::close(pv[1]);
+}
+
+int main(int argc, char ** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 20000;
+
+    {
+        // 领导者阻塞在epoll_wait()中时，push()的任务仍然执行；多个描述符的回显互不干扰
+        ctpl::thread_pool pool(2);
+        ctpl::reactor<ctpl::thread_pool> r(pool);
+        const int nPairs = 8;
+        int sv[nPairs][2];
+        for (int i = 0; i < nPairs; ++i) {
+            make_pair(sv[i]);
+            int fd = sv[i][0];
+            r.watch(fd, EPOLLIN, [fd](int, unsigned) { return echo(fd); });
+        }
+        CHECK(r.size() == nPairs);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));  // 让一个工作线程进入epoll_wait()
+        std::atomic<int> done(0);
+        for (int i = 0; i < 1000; ++i)
+            pool.push([&done](int) { ++done; });
+        for (int round = 0; round < 100; ++round) {
+            for (int i = 0; i < nPairs; ++i) {
+                char out[3] = { static_cast<char>(i), static_cast<char>(round), 'x' };
+                CHECK(::write(sv[i][1], out, sizeof(out)) == static_cast<ssize_t>(sizeof(out)));
+            }
+            for (int i = 0; i < nPairs; ++i) {
+                char in[3];
+                std::size_t got = 0;
+                while (got < sizeof(in)) {
+                    ssize_t k = ::read(sv[i][1], in + got, sizeof(in) - got);
+                    CHECK(k > 0);
+                    got += static_cast<std::size_t>(k);
+                }
+                CHECK(in[0] == static_cast<char>(i) && in[1] == static_cast<char>(round) && in[2] == 'x');
+            }
+        }
+        while (done != 1000)
+            std::this_thread::yield();
+        for (int i = 0; i < nPairs; ++i)
+            ::close(sv[i][1]);
+        while (r.size() != 0)
+            std::this_thread::yield();  // 对端关闭后全部取消监视
+        for (int i = 0; i < nPairs; ++i)
+            ::close(sv[i][0]);
+    }
+
+    std::printf("%-30s %2s %10s %10s\n", "1-byte round trip", "th", "median us", "p99 us");
+    const int threads[] = { 1, 2, 4 };
+    for (int t : threads) {
+        via_reactor(t, n);
+        via_epoll_thread(t, n);
+    }
+    std::printf("bench_reactor passed\n");
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*********************************************************
+* ctpl_algorithm.h的基准：parallel_sort随线程数的扩展性
+*
+* 线程数从1翻倍到硬件线程数（最后一档正好是硬件线程数），每档排序同一份随机数据，
+* 输出相对std::sort的加速比。整数键走基数排序，std::greater走分块排序加归并路径归并。
+* 每次排序后检查结果有序，因此也可以当作测试运行：
+*      g++ -std=c++11 -O2 -I. tests/bench_sort.cpp -o bench_sort -pthread
+*      ./bench_sort [元素数] [最大线程数]
+*
+* 加速比只有在多核机器上才有意义；只有一个核心时各档耗时相近。
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_algorithm.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <algorithm>   // 用于std::sort、std::is_sorted和std::min
+#include <chrono>      // 用于计时
+#include <cstdio>      // 用于输出结果
+#include <cstdlib>     // 用于解析命令行参数
+#include <functional>  // 用于std::greater
+#include <random>      // 用于生成随机数据
+#include <thread>      // 用于hardware_concurrency
+#include <vector>      // 用于数据
+
+/**
+ * @brief 对data的副本排序三次，返回最短耗时（毫秒）
+ *
+ * @param sort 排序函数 sort(std::vector<int> &)
+ */
+template <typename Sort, typename Compare>
+static double best_of_three(const std::vector<int> & data, Sort sort, Compare comp) {
+    double best = 0;
+    for (int round = 0; round < 3; ++round) {
+        std::vector<int> v(data);
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        sort(v);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        CHECK(std::is_sorted(v.begin(), v.end(), comp));
+        if (round == 0 || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+/**
+ * @brief 按comp排序，输出每档线程数的耗时和加速比
+ */
+template <typename Compare>
+static void scale(const char * name, const std::vector<int> & data, int maxThreads, Compare comp) {
+    double base = best_of_three(data, [comp](std::vector<int> & v) { std::sort(v.begin(), v.end(), comp); }, comp);
+    std::printf("%s, %zu elements: std::sort %.1f ms\n", name, data.size(), base);
+    std::printf("%8s %10s %8s\n", "threads", "ms", "speedup");
+    for (int t = 1; ; t = std::min(t * 2, maxThreads)) {
+        ctpl::thread_pool pool(t);
+        double ms = best_of_three(data, [&pool, comp](std::vector<int> & v) { ctpl::parallel_sort(pool, v.begin(), v.end(), comp); }, comp);
+        std::printf("%8d %10.1f %8.2f\n", t, ms, base / ms);
+        if (t == maxThreads)
+            break;
+    }
+}
+
+int main(int argc, char ** argv) {
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1 << 22;
+    int maxThreads = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    if (maxThreads < 1)
+        maxThreads = 1;
+
+    std::mt19937 rng(12345);
+    std::vector<int> data(n);
+    for (int & x : data)
+        x = static_cast<int>(rng());
+
+    scale("radix (std::less<int>)", data, maxThreads, std::less<int>());
+    scale("merge (std::greater<int>)", data, maxThreads, std::greater<int>());
+    std::printf("bench_sort passed\n");
+    return 0;
+}
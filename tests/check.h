@@ -0,0 +1,27 @@
+/*********************************************************
+* 测试用的检查宏
+*
+* 与assert不同，CHECK不受NDEBUG影响，以-DNDEBUG编译时条件表达式（包括其中的push()和get()）仍然执行：
+*      CHECK(p.push(f).get() == 1);
+*********************************************************/
+
+#ifndef __ctpl_test_check_H__
+#define __ctpl_test_check_H__
+
+#include <cstdio>      // 用于输出失败的条件
+#include <cstdlib>     // 用于std::abort
+
+namespace ctpl_test {
+    /**
+     * @brief 输出失败的条件和位置并终止程序
+     */
+    inline void check_failed(const char * expr, const char * file, int line) {
+        std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expr);
+        std::fflush(stderr);
+        std::abort();
+    }
+}
+
+#define CHECK(cond) ((cond) ? static_cast<void>(0) : ::ctpl_test::check_failed(#cond, __FILE__, __LINE__))
+
+#endif // __ctpl_test_check_H__
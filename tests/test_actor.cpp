@@ -0,0 +1,112 @@
+/*********************************************************
+* ctpl_actor.h的测试：激活被线程池丢弃后actor仍能继续工作
+*
+* 激活是嵌入在actor中的任务节点；线程池丢弃它时actor释放已发送的消息并清零计数，
+* 之后的send()重新调度。也检查消息按发送顺序处理，以及只有一个工作线程的侵入式队列：
+*      g++ -std=c++11 -O2 -I. tests/test_actor.cpp -o test_actor -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_queue.h>
+#include <ctpl_actor.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于计数和阻塞工作线程的标志
+#include <chrono>      // 用于sleep_for
+#include <cstdio>      // 用于输出结果
+#include <functional>  // 用于std::function
+#include <thread>      // 用于生产者线程
+#include <utility>     // 用于std::pair
+#include <vector>      // 用于保存生产者线程
+
+/**
+ * @brief 按发送者检查消息顺序的状态
+ */
+struct ordered {
+    ordered() : last(4, -1), count(0) {}
+
+    void operator()(int, const std::pair<int, int> & m) {
+        CHECK(m.second == this->last[m.first] + 1);  // 同一发送者的消息按发送顺序处理
+        this->last[m.first] = m.second;
+        ++this->count;
+    }
+
+    std::vector<int> last;  // 每个发送者最后处理的序号
+    int count;
+};
+
+/**
+ * @brief 几个线程同时发送消息，检查全部按顺序处理
+ */
+template <typename Pool>
+static void run_all(Pool & pool, int perSender) {
+    ctpl::actor<ordered, std::pair<int, int>, Pool> a(pool);
+    std::vector<std::thread> senders;
+    for (int k = 0; k < 4; ++k)
+        senders.emplace_back([&a, k, perSender]() {
+            for (int i = 0; i < perSender; ++i)
+                a.send(std::make_pair(k, i));
+        });
+    for (std::thread & t : senders)
+        t.join();
+    while (!a.idle())
+        std::this_thread::yield();
+    CHECK(a.state().count == 4 * perSender);
+}
+
+/**
+ * @brief 记录消息被处理的次数，析构时记录释放的次数
+ */
+struct tracked {
+    explicit tracked(std::atomic<int> * freed) : freed(freed) {}
+    tracked(tracked && o) : freed(o.freed) { o.freed = nullptr; }
+    ~tracked() { if (this->freed) ++*this->freed; }
+
+    std::atomic<int> * freed;
+};
+
+int main() {
+    {
+        ctpl::thread_pool pool(4);
+        run_all(pool, 20000);
+    }
+    {
+        ctpl::basic_thread_pool<ctpl::mpsc_queue> pool(1);
+        run_all(pool, 5000);
+    }
+    {
+        // 工作线程被占用时丢弃排队中的激活，消息被释放，计数清零，之后的消息重新调度
+        ctpl::thread_pool pool(1);
+        std::atomic<bool> go(false);
+        pool.push([&go](int) { while (!go) std::this_thread::yield(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        std::atomic<int> handled(0), freed(0);
+        ctpl::actor<std::function<void(int, tracked &)>, tracked> a(pool, [&handled](int, tracked &) { ++handled; });
+        for (int i = 0; i < 3; ++i)
+            a.emplace(&freed);
+        CHECK(a.n_pending() == 3);
+        bool popped = static_cast<bool>(pool.pop());  // 丢弃激活
+        bool more = static_cast<bool>(pool.pop());
+        CHECK(popped && !more);  // 队列中只有一次激活
+        CHECK(a.idle());
+        CHECK(freed == 3 && handled == 0);
+
+        a.emplace(&freed);
+        a.emplace(&freed);
+        go = true;
+        while (!a.idle())
+            std::this_thread::yield();
+        CHECK(handled == 2 && freed == 5);
+
+        // 停止线程池时丢弃的激活同样被处理
+        std::atomic<bool> go2(false);
+        pool.push([&go2](int) { while (!go2) std::this_thread::yield(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        a.emplace(&freed);
+        pool.clear_queue();
+        CHECK(a.idle() && freed == 6);
+        go2 = true;
+    }
+    std::printf("test_actor passed\n");
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*********************************************************
+* ctpl_batch.h的测试：map_async()的结果、空区间和异常
+*
+* 结果按元素顺序存放；空区间立即完成；第一个异常由get()重新抛出，
+* 已构造的结果在batch_result析构时被正确销毁（用ASan检查）：
+*      g++ -std=c++17 -O2 -I. tests/test_batch.cpp -o test_batch -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_batch.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于计数
+#include <cstdint>     // 用于std::uintptr_t
+#include <cstdio>      // 用于输出结果
+#include <stdexcept>   // 用于std::runtime_error
+#include <string>      // 用于需要析构的结果
+#include <vector>      // 用于输入区间
+
+/**
+ * @brief 对齐要求大于默认值的结果类型
+ */
+struct alignas(64) wide {
+    int v;
+};
+
+int main() {
+    ctpl::thread_pool pool(4);
+
+    // 结果按元素顺序存放
+    {
+        std::vector<int> in(100000);
+        for (int i = 0; i < static_cast<int>(in.size()); ++i)
+            in[i] = i;
+        ctpl::batch_result<std::string> r = ctpl::map_async(pool, in, [](int, int v) { return std::to_string(v * 2); });
+        r.get();
+        CHECK(r.size() == in.size());
+        for (std::size_t i = 0; i < in.size(); ++i)
+            CHECK(r[i] == std::to_string(static_cast<int>(i) * 2));
+    }
+
+    // 空区间：不提交任务，get()立即返回
+    {
+        std::vector<int> in;
+        std::atomic<int> calls(0);
+        ctpl::batch_result<int> r = ctpl::map_async(pool, in, [&calls](int, int v) { ++calls; return v; });
+        r.get();
+        CHECK(r.size() == 0 && r.empty() && r.begin() == r.end());
+        CHECK(calls == 0);
+    }
+
+    // 过对齐的结果类型
+    {
+        std::vector<int> in(1000, 7);
+        ctpl::batch_result<wide> r = ctpl::map_async(pool, in, [](int, int v) { wide w; w.v = v; return w; });
+        r.get();
+        for (std::size_t i = 0; i < in.size(); ++i) {
+            CHECK(reinterpret_cast<std::uintptr_t>(&r[i]) % alignof(wide) == 0);
+            CHECK(r[i].v == 7);
+        }
+    }
+
+    // 异常：get()重新抛出，部分构造的结果在析构时释放，再次get()仍然抛出
+    for (int round = 0; round < 20; ++round) {
+        std::vector<int> in(10000);
+        for (int i = 0; i < static_cast<int>(in.size()); ++i)
+            in[i] = i;
+        ctpl::batch_result<std::string> r = ctpl::map_async(pool, in, [](int, int v) {
+            if (v == 5000)
+                throw std::runtime_error("bad element");
+            return std::string(64, 'x');  // 分配堆内存，泄漏时ASan报告
+        });
+        int caught = 0;
+        for (int k = 0; k < 2; ++k) {
+            try {
+                r.get();
+            }
+            catch (const std::runtime_error &) {
+                ++caught;
+            }
+        }
+        CHECK(caught == 2);
+    }
+    std::printf("test_batch passed\n");
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*********************************************************
+* blocking_region和备用线程的测试
+*
+* 唯一的工作线程阻塞在blocking_region中时，启用的备用线程以ID -1执行队列中的任务；
+* 上限为0时不补偿；启用数不超过set_max_spare()；阻塞结束后备用线程退役，下一次启用时重复使用；
+* 嵌套的区间只计一次，线程池之外的区间什么也不做：
+*      g++ -std=c++11 -O2 -I. tests/test_blocking.cpp -o test_blocking -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于阻塞任务的释放标志
+#include <chrono>      // 用于超时
+#include <cstdio>      // 用于输出结果
+#include <mutex>       // 用于保护线程ID集合
+#include <set>         // 用于记录备用线程
+#include <thread>      // 用于yield和线程ID
+#include <vector>      // 用于保存future
+
+/**
+ * @brief 等待pred()成立，最多等待ms毫秒
+ */
+template <typename Pred>
+static bool eventually(Pred pred, int ms = 5000) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+/**
+ * @brief 在blocking_region中等待release的任务
+ */
+static void block_until(const std::atomic<bool> & release) {
+    ctpl::blocking_region blocking;
+    while (!release)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+/**
+ * @brief 一个阻塞的任务和一个计算任务：返回计算任务看到的线程ID和执行它的线程
+ */
+static int compensate_once(ctpl::thread_pool & pool, std::thread::id & runner) {
+    std::atomic<bool> release(false);
+    ctpl::future<void> blocked = pool.push([&release](int) { block_until(release); });
+    CHECK(eventually([&pool]() { return pool.n_blocked() == 1; }));
+    ctpl::future<int> work = pool.push([&runner](int id) { runner = std::this_thread::get_id(); return id; });
+    CHECK(work.wait_for(std::chrono::seconds(5)) == std::future_status::ready);  // 工作线程仍在阻塞
+    CHECK(pool.n_spare() == 1);
+    release = true;
+    blocked.get();
+    CHECK(eventually([&pool]() { return pool.n_blocked() == 0 && pool.n_spare() == 0; }));  // 备用线程退役
+    return work.get();
+}
+
+int main() {
+    {
+        // 不设置上限时不补偿：计算任务等到阻塞结束才执行
+        ctpl::thread_pool pool(1);
+        std::atomic<bool> release(false);
+        ctpl::future<void> blocked = pool.push([&release](int) { block_until(release); });
+        CHECK(eventually([&pool]() { return pool.n_blocked() == 1; }));
+        ctpl::future<int> work = pool.push([](int id) { return id; });
+        CHECK(work.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+        CHECK(pool.n_spare() == 0);
+        release = true;
+        blocked.get();
+        CHECK(work.get() == 0);  // 由工作线程执行
+    }
+    {
+        // 启用的备用线程以ID -1执行任务，退役后在下一次启用时重复使用
+        ctpl::thread_pool pool(1);
+        pool.set_max_spare(1);
+        std::thread::id first, second;
+        CHECK(compensate_once(pool, first) == -1);
+        CHECK(compensate_once(pool, second) == -1);
+        CHECK(first == second);  // 同一个后备线程
+    }
+    {
+        // 备用线程执行的任务也可以阻塞；启用数不超过上限
+        ctpl::thread_pool pool(1);
+        pool.set_max_spare(2);
+        std::atomic<bool> release(false);
+        std::vector<ctpl::future<void>> blocked;
+        for (int i = 0; i < 3; ++i)
+            blocked.push_back(pool.push([&release](int) { block_until(release); }));
+        CHECK(eventually([&pool]() { return pool.n_blocked() == 3; }));  // 工作线程和两个备用线程都在阻塞
+        CHECK(pool.n_spare() == 2);
+        ctpl::future<int> work = pool.push([](int id) { return id; });
+        CHECK(work.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+        release = true;
+        for (ctpl::future<void> & f : blocked)
+            f.get();
+        work.get();
+        CHECK(eventually([&pool]() { return pool.n_blocked() == 0 && pool.n_spare() == 0; }));
+    }
+    {
+        // 嵌套的区间只计一次；线程池之外的区间不计入
+        ctpl::thread_pool pool(2);
+        pool.set_max_spare(2);
+        {
+            ctpl::blocking_region outside;
+            CHECK(pool.n_blocked() == 0);
+        }
+        pool.push([&pool](int) {
+            ctpl::blocking_region outer;
+            {
+                ctpl::blocking_region inner;
+                CHECK(pool.n_blocked() == 1);
+            }
+            CHECK(pool.n_blocked() == 1);
+        }).get();
+        CHECK(eventually([&pool]() { return pool.n_blocked() == 0 && pool.n_spare() == 0; }));
+    }
+    {
+        // 线程池停止时后备中的备用线程退出；启用中的备用线程一起执行完队列
+        ctpl::thread_pool pool(1);
+        pool.set_max_spare(1);
+        std::atomic<bool> release(false);
+        std::atomic<int> done(0);
+        pool.push([&release](int) { block_until(release); });
+        CHECK(eventually([&pool]() { return pool.n_spare() == 1; }));
+        for (int i = 0; i < 100; ++i)
+            pool.push([&done](int) { ++done; });
+        CHECK(eventually([&done]() { return done == 100; }));
+        release = true;
+        pool.stop(true);
+        CHECK(done == 100);
+    }
+    std::printf("test_blocking passed\n");
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*********************************************************
+* ctpl_cache.h的测试：并发未命中只计算一次、异常后重新计算、按预算淘汰，以及读写并发时的回收
+*
+* 多个线程同时对同一批键调用get_or_compute()，每个键只计算一次；
+* 预算很小时条目数受限，频繁读取的键和正在计算的键不被淘汰；
+* 读者不加锁地find()时写者不断替换和删除带堆内存的值，回收过早时ASan会报告释放后使用：
+*      g++ -std=c++11 -O2 -I. tests/test_cache.cpp -o test_cache -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_cache.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于计数和标志
+#include <chrono>      // 用于sleep_for
+#include <cstdio>      // 用于输出结果
+#include <future>      // 用于std::shared_future
+#include <stdexcept>   // 用于std::runtime_error
+#include <string>      // 用于带堆内存的值
+#include <thread>      // 用于调用者线程
+#include <vector>      // 用于线程和计数
+
+/**
+ * @brief 每个条目按100字节计
+ */
+struct fixed_weigh {
+    std::size_t operator()(int, const std::string &) const { return 100; }
+};
+
+/**
+ * @brief 键k的第version个值，读者据此检查读到的值是完整的
+ */
+static std::string value_of(int k, int version) {
+    return std::to_string(k) + ":" + std::to_string(version) + std::string(40, 'x');
+}
+
+/**
+ * @brief 检查value是键k的某个版本
+ */
+static bool is_value_of(int k, const std::string & value) {
+    std::string prefix = std::to_string(k) + ":";
+    return value.compare(0, prefix.size(), prefix) == 0 && value.size() > 40;
+}
+
+int main() {
+    {
+        // 8个线程同时未命中同一批键：每个键只计算一次，所有调用者得到相同的值
+        ctpl::thread_pool pool(4);
+        ctpl::concurrent_cache<int, std::string> cache;
+        const int nKeys = 32;
+        std::vector<std::atomic<int>> computed(nKeys);
+        for (std::atomic<int> & c : computed)
+            c = 0;
+        std::atomic<bool> go(false);
+        std::vector<std::thread> callers;
+        for (int t = 0; t < 8; ++t) {
+            callers.emplace_back([&, t]() {
+                while (!go)
+                    std::this_thread::yield();
+                for (int round = 0; round < 4; ++round) {
+                    for (int i = 0; i < nKeys; ++i) {
+                        int k = (i + t) % nKeys;
+                        std::shared_future<std::string> f = cache.get_or_compute(pool, k, [&computed](int, const int & key) {
+                            ++computed[key];
+                            std::this_thread::sleep_for(std::chrono::milliseconds(1));  // 拉长并发未命中的窗口
+                            return value_of(key, 0);
+                        });
+                        CHECK(f.get() == value_of(k, 0));
+                    }
+                }
+            });
+        }
+        go = true;
+        for (std::thread & t : callers)
+            t.join();
+        for (int i = 0; i < nKeys; ++i)
+            CHECK(computed[i] == 1);
+        CHECK(cache.size() == static_cast<std::size_t>(nKeys));
+        std::string v;
+        CHECK(cache.find(5, v) && v == value_of(5, 0));
+        pool.wait_idle();
+    }
+    {
+        // 计算抛出异常：等待者得到异常，条目被删除，之后的调用重新计算
+        ctpl::thread_pool pool(2);
+        ctpl::concurrent_cache<int, std::string> cache;
+        std::atomic<int> calls(0);
+        auto compute = [&calls](int, const int & key) -> std::string {
+            if (calls++ == 0)
+                throw std::runtime_error("compute");
+            return value_of(key, 1);
+        };
+        bool caught = false;
+        try {
+            cache.get_or_compute(pool, 7, compute).get();
+        }
+        catch (const std::runtime_error &) {
+            caught = true;
+        }
+        CHECK(caught);
+        pool.wait_idle();  // 删除条目在计算结束时完成
+        std::string v;
+        CHECK(!cache.find(7, v));
+        CHECK(cache.get_or_compute(pool, 7, compute).get() == value_of(7, 1));
+        CHECK(calls == 2);
+        pool.wait_idle();
+    }
+    {
+        // 预算只够几个条目：条目数和总大小受限，频繁读取的键和正在计算的键不被淘汰
+        ctpl::thread_pool pool(1);
+        const std::size_t budget = 2000;
+        ctpl::concurrent_cache<int, std::string, std::hash<int>, std::equal_to<int>, fixed_weigh> cache(budget, 1);
+        std::atomic<bool> release(false);
+        std::atomic<int> slowCalls(0);
+        auto slow = [&release, &slowCalls](int, const int & key) {
+            ++slowCalls;
+            while (!release)
+                std::this_thread::yield();
+            return value_of(key, 2);
+        };
+        std::shared_future<std::string> pending = cache.get_or_compute(pool, -1, slow);
+        while (slowCalls == 0)
+            std::this_thread::yield();
+        cache.insert(0, value_of(0, 0));
+        std::string v;
+        int hotMisses = 0;
+        for (int k = 1; k < 1000; ++k) {
+            cache.insert(k, value_of(k, 0));
+            CHECK(cache.bytes() <= budget);
+            if (!cache.find(0, v)) {  // 命中时设置引用位
+                ++hotMisses;
+                cache.insert(0, value_of(0, 0));
+            }
+        }
+        CHECK(hotMisses < 10);  // 只有开始时所有条目都带引用位，之后频繁读取的键不被淘汰
+        CHECK(cache.size() < 1000);
+        CHECK(!cache.find(1, v));  // 早期插入又没有读取的键已被淘汰
+        CHECK(cache.find(999, v) && v == value_of(999, 0));
+        std::shared_future<std::string> again = cache.get_or_compute(pool, -1, slow);  // 条目仍在，没有重新提交
+        release = true;
+        CHECK(pending.get() == value_of(-1, 2));
+        CHECK(again.get() == value_of(-1, 2));
+        pool.wait_idle();
+        CHECK(slowCalls == 1);
+    }
+    {
+        // 读者并发find()时，写者替换、删除值并清空缓存；读到的值总是完整的某个版本
+        ctpl::concurrent_cache<int, std::string> cache(0, 4);
+        const int nKeys = 64;
+        for (int k = 0; k < nKeys; ++k)
+            cache.insert(k, value_of(k, 0));
+        std::atomic<bool> quit(false);
+        std::atomic<long> hits(0);
+        std::vector<std::thread> threads;
+        for (int r = 0; r < 4; ++r) {
+            threads.emplace_back([&, r]() {
+                std::string v;
+                for (int i = r; !quit; ++i) {
+                    int k = i % nKeys;
+                    if (cache.find(k, v)) {
+                        CHECK(is_value_of(k, v));
+                        ++hits;
+                    }
+                }
+            });
+        }
+        for (int w = 0; w < 2; ++w) {
+            threads.emplace_back([&, w]() {
+                for (int version = 1; version <= 3000; ++version) {
+                    int k = (version * 7 + w) % nKeys;
+                    if (version % 5 == 0)
+                        cache.erase(k);
+                    else
+                        cache.insert(k, value_of(k, version));
+                    if (w == 0 && version % 1000 == 0)
+                        cache.clear();
+                }
+            });
+        }
+        for (std::size_t i = 4; i < threads.size(); ++i)
+            threads[i].join();
+        quit = true;
+        for (int r = 0; r < 4; ++r)
+            threads[r].join();
+        CHECK(hits.load() > 0);
+        CHECK(cache.size() <= static_cast<std::size_t>(nKeys));
+    }
+    std::printf("test_cache passed\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*********************************************************
+* ctpl_channel.h的测试：数据的构造函数抛出异常时，等待的续体不丢失
+*
+* send()先在续体中构造数据再把续体移出等待链表，构造失败时续体仍然等待之后的数据：
+*      g++ -std=c++11 -O2 -I. tests/test_channel.cpp -o test_channel -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_channel.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于计数
+#include <cstdio>      // 用于输出结果
+#include <stdexcept>   // 用于std::runtime_error
+#include <thread>      // 用于接收线程
+#include <utility>     // 用于std::move
+#include <vector>      // 用于保存线程
+
+/**
+ * @brief 拷贝时可以抛出异常的数据
+ */
+struct fragile {
+    explicit fragile(int v, bool failCopy = false) : v(v), failCopy(failCopy) {}
+    fragile(const fragile & o) : v(o.v), failCopy(o.failCopy) {
+        if (this->failCopy)
+            throw std::runtime_error("copy failed");
+    }
+    fragile(fragile && o) : v(o.v), failCopy(o.failCopy) {}
+    fragile & operator=(fragile && o) { this->v = o.v; this->failCopy = o.failCopy; return *this; }
+
+    int v;
+    bool failCopy;
+};
+
+int main() {
+    ctpl::thread_pool pool(2);
+
+    // 续体等待时发送失败：异常传给调用者，续体得到之后发送的数据
+    {
+        ctpl::channel<fragile> ch;
+        std::atomic<int> got(-1), calls(0);
+        ch.async_recv(pool, [&got, &calls](int, fragile * v) {
+            got = v ? v->v : -2;
+            ++calls;
+        });
+        fragile bad(1, true);
+        bool threw = false;
+        try {
+            ch.send(bad);
+        }
+        catch (const std::runtime_error &) {
+            threw = true;
+        }
+        CHECK(threw);
+        CHECK(ch.send(fragile(2)));
+        while (calls == 0)
+            std::this_thread::yield();
+        CHECK(got == 2 && calls == 1);
+        ch.close();
+    }
+
+    // 关闭通道时等待的续体以nullptr被调用
+    {
+        ctpl::channel<int> ch;
+        std::atomic<int> nulls(0);
+        for (int i = 0; i < 3; ++i)
+            ch.async_recv(pool, [&nulls](int, int * v) { if (!v) ++nulls; });
+        ch.close();
+        while (nulls != 3)
+            std::this_thread::yield();
+        CHECK(!ch.send(1));
+    }
+
+    // 有界通道：多个生产者和消费者，每个数据只被接收一次
+    {
+        ctpl::channel<int> ch(8);
+        const int perProducer = 20000;
+        std::atomic<long long> sum(0);
+        std::vector<std::thread> consumers, producers;
+        for (int k = 0; k < 2; ++k)
+            consumers.emplace_back([&ch, &sum]() {
+                int v;
+                while (ch.recv(v))
+                    sum += v;
+            });
+        for (int k = 0; k < 2; ++k)
+            producers.emplace_back([&ch, perProducer]() {
+                for (int i = 1; i <= perProducer; ++i)
+                    CHECK(ch.send(i));
+            });
+        for (std::thread & t : producers)
+            t.join();
+        ch.close();
+        for (std::thread & t : consumers)
+            t.join();
+        CHECK(sum == 2LL * perProducer * (perProducer + 1) / 2);
+    }
+    std::printf("test_channel passed\n");
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*********************************************************
+* ctpl_deadline.h的测试：调度令牌在线程池队列中最多出现一次
+*
+* 侵入式队列（mpsc_queue）要求同一节点不能重复入队，否则链表成环、工作线程不再返回：
+*      g++ -std=c++11 -O2 -I. tests/test_deadline.cpp -o test_deadline -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_queue.h>
+#include <ctpl_deadline.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于阻塞工作线程的标志
+#include <chrono>      // 用于截止时间
+#include <cstdio>      // 用于输出结果
+#include <future>      // 用于std::future_error
+#include <thread>      // 用于yield和sleep_for
+#include <vector>      // 用于保存future
+
+/**
+ * @brief 一次提交n个任务，截止时间越晚提交的越早，检查全部任务都执行且只执行一次
+ */
+template <typename Pool>
+static void run_all(Pool & pool, int n) {
+    ctpl::deadline_scheduler<Pool> ds(pool, ctpl::expired_policy::run);
+    std::vector<ctpl::future<int>> fs;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+        fs.push_back(ds.push_with_deadline(now + std::chrono::seconds(10) - std::chrono::microseconds(i),
+                                           [i](int) { return i; }));
+    long long sum = 0;
+    for (ctpl::future<int> & f : fs)
+        sum += f.get();
+    CHECK(sum == static_cast<long long>(n) * (n - 1) / 2);
+    while (ds.stats().executed != static_cast<unsigned long long>(n))
+        std::this_thread::yield();  // 计数在future就绪之后才更新
+}
+
+int main() {
+    {
+        ctpl::basic_thread_pool<ctpl::mpsc_queue> pool(1);
+        run_all(pool, 1000);
+    }
+    {
+        ctpl::thread_pool pool(4);
+        run_all(pool, 20000);
+    }
+    {
+        // 线程池丢弃令牌时，所有等待调度的任务都得到broken_promise，之后的提交重新调度
+        ctpl::thread_pool pool(1);
+        std::atomic<bool> go(false);
+        pool.push([&go](int) { while (!go) std::this_thread::yield(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ctpl::deadline_scheduler<ctpl::thread_pool> ds(pool);
+        ctpl::future<int> a = ds.push_with_deadline(std::chrono::steady_clock::now(), [](int) { return 1; });
+        ctpl::future<int> b = ds.push_with_deadline(std::chrono::steady_clock::now(), [](int) { return 2; });
+        bool popped = static_cast<bool>(pool.pop());  // 丢弃令牌
+        bool more = static_cast<bool>(pool.pop());
+        CHECK(popped && !more);  // 队列中只有一个令牌
+        try { a.get(); CHECK(false); } catch (const std::future_error &) {}
+        try { b.get(); CHECK(false); } catch (const std::future_error &) {}
+        ctpl::future<int> c = ds.push_with_deadline(std::chrono::steady_clock::now() + std::chrono::seconds(1),
+                                                    [](int) { return 3; });
+        go = true;
+        CHECK(c.get() == 3);
+    }
+    std::printf("test_deadline: ok\n");
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*********************************************************
+* ctpl_exec.h的测试：stdexec::bulk经过调度器的domain后在多个工作线程上并行执行
+*
+* domain不可用（_ctplExecBulkDomain_为0或不认识bulk_t的数据布局）时，
+* stdexec::bulk按默认方式执行，只检查结果，并输出使用的路径。
+* 需要C++20和stdexec，stdexec不可用时只输出提示：
+*      g++ -std=c++20 -O2 -I. -I<stdexec>/include tests/test_exec.cpp -o test_exec -pthread
+*********************************************************/
+
+#if __has_include(<stdexec/execution.hpp>)
+
+#include <ctpl_exec.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于计数
+#include <cstdio>      // 用于输出结果
+#include <mutex>       // 用于保护线程ID集合
+#include <set>         // 用于记录执行fn的线程
+#include <stdexcept>   // 用于std::runtime_error
+#include <thread>      // 用于std::this_thread::get_id
+#include <vector>      // 用于结果
+
+int main() {
+    ctpl::thread_pool pool(4);
+    auto sch = ctpl::get_scheduler(pool);
+    const int n = 100000;
+
+    // 1. bulk在线程池上完成的sender之后：经过domain换成并行版本，值传给fn并原样传给后继
+    {
+        std::vector<int> out(n, 0);
+        std::mutex m;
+        std::set<std::thread::id> ids;
+        auto work = stdexec::schedule(sch)
+                  | stdexec::then([] { return 3; })
+                  | stdexec::bulk(n, [&](int i, int k) {
+                        out[i] = i * k;
+                        if (i % 1000 == 0) {
+                            std::unique_lock<std::mutex> lock(m);
+                            ids.insert(std::this_thread::get_id());
+                        }
+                    });
+        constexpr bool customized = !stdexec::sender_expr_for<decltype(work), stdexec::bulk_t>;  // domain换掉了bulk
+        auto [k] = stdexec::sync_wait(std::move(work)).value();
+        CHECK(k == 3);
+        for (int i = 0; i < n; ++i)
+            CHECK(out[i] == i * 3);
+        if (customized)
+            CHECK(ids.count(std::this_thread::get_id()) == 0);  // 在工作线程上执行，而不是在调用者线程上
+        std::printf("bulk %s ran on %zu thread(s)\n", customized ? "(pool domain)" : "(default)", ids.size());
+    }
+
+    // 2. fn抛出的第一个异常通过set_error传给接收者
+    {
+        std::atomic<int> calls(0);
+        auto work = stdexec::schedule(sch) | stdexec::bulk(n, [&](int i) {
+            ++calls;
+            if (i == n / 2)
+                throw std::runtime_error("bulk");
+        });
+        bool caught = false;
+        try {
+            stdexec::sync_wait(std::move(work));
+        }
+        catch (const std::runtime_error &) {
+            caught = true;
+        }
+        CHECK(caught);
+        CHECK(calls.load() <= n);
+    }
+
+    // 3. schedule_bulk()不经过domain，结果相同
+    {
+        std::vector<int> out(n, 0);
+        stdexec::sync_wait(sch.schedule_bulk(n, [&](int i) { out[i] = i + 1; }));
+        for (int i = 0; i < n; ++i)
+            CHECK(out[i] == i + 1);
+    }
+
+    std::printf("test_exec passed\n");
+    return 0;
+}
+
+#else
+
+#include <cstdio>
+
+int main() {
+    std::printf("test_exec skipped: <stdexec/execution.hpp> not found\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*********************************************************
+* ctpl_fair.h的测试：调度令牌在线程池队列中最多出现一次
+*
+* 包括提交、受限租户的任务执行完后补回暂存的令牌执行、放宽并发上限三条路径：
+*      g++ -std=c++11 -O2 -I. tests/test_fair.cpp -o test_fair -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_queue.h>
+#include <ctpl_fair.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于计数和阻塞工作线程的标志
+#include <chrono>      // 用于sleep_for
+#include <cstdio>      // 用于输出结果
+#include <future>      // 用于std::future_error
+#include <thread>      // 用于yield和sleep_for
+#include <vector>      // 用于保存future
+
+/**
+ * @brief 两个租户各提交n个任务，其中一个租户最多同时执行一个任务，检查全部任务都执行
+ */
+template <typename Pool>
+static void run_all(Pool & pool, int n) {
+    ctpl::fair_scheduler<Pool> fs(pool);
+    typename ctpl::fair_scheduler<Pool>::tenant open = fs.add_tenant(1);
+    typename ctpl::fair_scheduler<Pool>::tenant capped = fs.add_tenant(2, 1);
+    std::atomic<int> inCapped(0);
+    std::vector<ctpl::future<int>> fut;
+    for (int i = 0; i < n; ++i) {
+        fut.push_back(open.push([i](int) { return i; }));
+        fut.push_back(capped.push([i, &inCapped](int) {
+            CHECK(inCapped.fetch_add(1) == 0);  // 并发上限为1
+            inCapped.fetch_sub(1);
+            return i;
+        }));
+    }
+    long long sum = 0;
+    for (ctpl::future<int> & f : fut)
+        sum += f.get();
+    CHECK(sum == static_cast<long long>(n) * (n - 1));
+}
+
+/**
+ * @brief 受限租户的令牌执行被暂存，放宽上限后补回
+ */
+template <typename Pool>
+static void raise_cap(Pool & pool) {
+    ctpl::fair_scheduler<Pool> fs(pool);
+    typename ctpl::fair_scheduler<Pool>::tenant t = fs.add_tenant(1, 1);
+    std::atomic<bool> go(false);
+    std::atomic<int> done(0);
+    std::vector<ctpl::future<void>> fut;
+    fut.push_back(t.push([&go](int) { while (!go) std::this_thread::yield(); }));
+    for (int i = 0; i < 100; ++i)
+        fut.push_back(t.push([&done](int) { ++done; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(done == 0);  // 第一个任务还在执行，其余任务被上限挡住
+    t.set_max_running(0);
+    while (done != 100)
+        std::this_thread::yield();
+    go = true;
+    for (ctpl::future<void> & f : fut)
+        f.get();
+}
+
+int main() {
+    {
+        ctpl::basic_thread_pool<ctpl::mpsc_queue> pool(1);
+        run_all(pool, 1000);
+    }
+    {
+        ctpl::thread_pool pool(4);
+        run_all(pool, 20000);
+        raise_cap(pool);
+    }
+    {
+        // 线程池丢弃令牌时，所有等待调度的任务都得到broken_promise，之后的提交重新调度
+        ctpl::thread_pool pool(1);
+        std::atomic<bool> go(false);
+        pool.push([&go](int) { while (!go) std::this_thread::yield(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ctpl::fair_scheduler<ctpl::thread_pool> fs(pool);
+        ctpl::fair_scheduler<ctpl::thread_pool>::tenant t = fs.add_tenant();
+        ctpl::future<int> a = t.push([](int) { return 1; });
+        ctpl::future<int> b = t.push([](int) { return 2; });
+        bool popped = static_cast<bool>(pool.pop());  // 丢弃令牌
+        bool more = static_cast<bool>(pool.pop());
+        CHECK(popped && !more);  // 队列中只有一个令牌
+        try { a.get(); CHECK(false); } catch (const std::future_error &) {}
+        try { b.get(); CHECK(false); } catch (const std::future_error &) {}
+        ctpl::future<int> c = t.push([](int) { return 3; });
+        go = true;
+        CHECK(c.get() == 3);
+    }
+    std::printf("test_fair: ok\n");
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*********************************************************
+* ctpl_pipeline.h的测试：顺序、在途数据项上限、串行阶段互斥和异常
+*
+* 并行阶段故意让数据项以不同的快慢完成，检查serial_in_order阶段仍按数据源的顺序看到数据，
+* 同时在流水线中的数据项不超过maxTokens；阶段抛出异常后run()重新抛出，
+* 已在流水线中的数据项被析构，同一个pipeline对象可以再次run()：
+*      g++ -std=c++11 -O2 -I. tests/test_pipeline.cpp -o test_pipeline -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_queue.h>
+#include <ctpl_pipeline.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于计数
+#include <cstdio>      // 用于输出结果
+#include <stdexcept>   // 用于std::runtime_error
+#include <string>      // 用于在阶段之间传递非平凡类型
+#include <thread>      // 用于yield
+#include <vector>      // 用于记录数据项是否出现
+
+static std::atomic<int> nLive(0);  // 存活的tracked对象数
+
+/**
+ * @brief 记录构造和析构次数的数据项
+ */
+struct tracked {
+    explicit tracked(long v) : v(v), s(std::to_string(v)) { ++nLive; }
+    tracked(const tracked & o) : v(o.v), s(o.s) { ++nLive; }
+    tracked(tracked && o) : v(o.v), s(std::move(o.s)) { ++nLive; }
+    ~tracked() { --nLive; }
+
+    long v;
+    std::string s;  // 有堆内存的成员，缓冲区中的对象没有析构时ASan会报告泄漏
+};
+
+/**
+ * @brief 数据源 → 并行平方 → 串行乱序检查互斥 → 按序汇总，检查顺序和在途数据项上限
+ */
+template <typename Pool>
+static void ordered(Pool & pool, std::size_t maxTokens, long n) {
+    long next = 0;
+    std::atomic<long> inFlight(0), maxInFlight(0);
+    std::atomic<int> inSerial(0);
+    std::vector<char> seenOutOfOrder(n, 0);
+    long expected = 0;
+    long long sum = 0;
+    ctpl::pipeline<Pool> p(pool, maxTokens,
+        ctpl::make_filter<void, tracked>(ctpl::filter_mode::serial_in_order, [&](int, ctpl::flow_control & fc) {
+            if (next == n) {
+                fc.stop();
+                return tracked(-1);
+            }
+            long now = ++inFlight;
+            long m = maxInFlight.load();
+            while (now > m && !maxInFlight.compare_exchange_weak(m, now)) {}
+            return tracked(next++);
+        })
+        & ctpl::make_filter<tracked, tracked>(ctpl::filter_mode::parallel, [](int, tracked t) {
+            for (long k = 0; k < t.v % 7 * 3; ++k)
+                std::this_thread::yield();  // 各数据项完成的快慢不同
+            CHECK(t.s == std::to_string(t.v));
+            return tracked(t.v * t.v);
+        })
+        & ctpl::make_filter<tracked, tracked>(ctpl::filter_mode::serial_out_of_order, [&](int, tracked t) {
+            CHECK(inSerial.fetch_add(1) == 0);  // 串行阶段同一时刻只处理一个数据项
+            long root = 0;
+            while (root * root < t.v)
+                ++root;
+            CHECK(root < n && !seenOutOfOrder[root]);
+            seenOutOfOrder[root] = 1;
+            inSerial.fetch_sub(1);
+            return t;
+        })
+        & ctpl::make_filter<tracked, void>(ctpl::filter_mode::serial_in_order, [&](int, tracked t) {
+            CHECK(t.v == expected * expected);  // 按数据源的顺序
+            ++expected;
+            sum += t.v;
+            --inFlight;
+        }));
+    for (int round = 0; round < 2; ++round) {  // 同一个pipeline对象反复执行
+        next = 0;
+        expected = 0;
+        sum = 0;
+        maxInFlight = 0;
+        seenOutOfOrder.assign(n, 0);
+        p.run();
+        CHECK(expected == n);
+        CHECK(sum == (n - 1) * n * (2 * n - 1) / 6);
+        CHECK(maxInFlight.load() <= static_cast<long>(maxTokens));
+        CHECK(inFlight.load() == 0);
+    }
+    CHECK(nLive.load() == 0);
+}
+
+/**
+ * @brief 并行阶段抛出异常：run()重新抛出，数据源停止，在途数据项被析构；之后可以再次run()
+ */
+template <typename Pool>
+static void failing(Pool & pool) {
+    const long n = 10000;
+    long next = 0;
+    long throwAt = 500;
+    std::atomic<long> sunk(0);
+    ctpl::pipeline<Pool> p(pool, 8,
+        ctpl::make_filter<void, tracked>(ctpl::filter_mode::serial_in_order, [&](int, ctpl::flow_control & fc) {
+            if (next == n)
+                fc.stop();
+            return tracked(next++);
+        })
+        & ctpl::make_filter<tracked, tracked>(ctpl::filter_mode::parallel, [&](int, tracked t) {
+            if (t.v == throwAt)
+                throw std::runtime_error("stage");
+            return t;
+        })
+        & ctpl::make_filter<tracked, void>(ctpl::filter_mode::serial_in_order, [&](int, tracked) { ++sunk; }));
+    bool caught = false;
+    try {
+        p.run();
+    }
+    catch (const std::runtime_error &) {
+        caught = true;
+    }
+    CHECK(caught);
+    CHECK(next < n);  // 数据源停止产生新数据
+    CHECK(sunk.load() <= throwAt);  // 按序阶段不会越过失败的数据项
+    CHECK(nLive.load() == 0);  // 丢弃的数据项都已析构
+
+    next = 0;
+    throwAt = -1;
+    sunk = 0;
+    p.run();
+    CHECK(sunk.load() == n);
+    CHECK(nLive.load() == 0);
+}
+
+int main() {
+    {
+        ctpl::basic_thread_pool<ctpl::mpsc_queue> pool(1);
+        ordered(pool, 4, 2000);
+        failing(pool);
+    }
+    {
+        ctpl::thread_pool pool(4);
+        ordered(pool, 1, 500);  // 只有一个令牌时退化为逐项处理
+        ordered(pool, 16, 20000);
+        failing(pool);
+    }
+    std::printf("test_pipeline passed\n");
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*********************************************************
+* ctpl_profile.h的测试：只有字符串字面量按地址缓存标签
+*
+* 同一块缓冲区先后存放不同的名字时，无论以数组还是指针传入，都应得到不同的标签：
+*      g++ -std=c++11 -O2 -I. tests/test_profile.cpp -o test_profile -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <chrono>      // 用于执行时间
+#include <cstdio>      // 用于snprintf和输出结果
+#include <sstream>     // 用于dump_labels()的输出
+#include <string>      // 用于按内容构造的标签
+#include <thread>      // 用于sleep_for
+#include <vector>      // 用于top_labels()的结果
+
+int main() {
+    // 字符串字面量：与按内容登记的同名标签编号相同
+    ctpl::label a("literal_a");
+    CHECK(a.id() == ctpl::label(std::string("literal_a")).id());
+    for (int k = 0; k < 3; ++k)
+        CHECK(ctpl::label("literal_a").id() == a.id());  // 之后命中地址缓存
+    CHECK(a.name() == "literal_a");
+
+    // 可写的字符数组：内容改变后得到新的标签
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "buffer_%d", 1);
+    int first = ctpl::label(buf).id();
+    std::snprintf(buf, sizeof(buf), "buffer_%d", 2);
+    int second = ctpl::label(buf).id();
+    CHECK(first != second);
+    CHECK(ctpl::label(buf).name() == "buffer_2");
+
+    // 指向同一块缓冲区的指针，const和非const都按内容查找
+    std::string s = "pointer_x";
+    const char * cp = s.c_str();
+    int x = ctpl::label(cp).id();
+    s[8] = 'y';
+    int y = ctpl::label(cp).id();
+    CHECK(x != y);
+    char * p = buf;
+    std::snprintf(buf, sizeof(buf), "pointer_x");
+    CHECK(ctpl::label(p).id() == x);
+
+    // 带标签提交的任务按标签统计
+    {
+        ctpl::thread_pool pool(2);
+        for (int i = 0; i < 10; ++i) {
+            std::snprintf(buf, sizeof(buf), "task_%d", i % 2);
+            pool.push(ctpl::label(buf), [](int) {}).get();
+        }
+        std::vector<ctpl::label_stats> top = pool.top_labels(10);
+        int seen = 0;
+        for (std::size_t i = 0; i < top.size(); ++i)
+            if (top[i].name == "task_0" || top[i].name == "task_1") {
+                CHECK(top[i].count == 5);
+                ++seen;
+            }
+        CHECK(seen == 2);
+
+        // 排在前面的是执行时间之和最大的标签，表头标明是执行时间而不是CPU时间
+        pool.push(ctpl::label("sleepy"), [](int) { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }).get();
+        top = pool.top_labels(1);
+        CHECK(top.size() == 1 && top[0].name == "sleepy");
+        CHECK(top[0].runTime >= std::chrono::milliseconds(20));
+        std::ostringstream os;
+        pool.dump_labels(os, 1);
+        CHECK(os.str().find("run(us)") != std::string::npos);
+    }
+    std::printf("test_profile passed\n");
+    return 0;
+}
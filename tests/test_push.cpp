@@ -0,0 +1,123 @@
+/*********************************************************
+* push()的参数转发测试：统计example.cpp中Third和Second的拷贝和移动次数
+*
+* 函数和参数只在构造任务节点时拷贝或移动一次，调用时再把保存的参数移动给函数一次：
+*      g++ -std=c++11 -O2 -I. tests/test_push.cpp -o test_push -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于计数器
+#include <cstdio>      // 用于输出结果
+#include <memory>      // 用于std::unique_ptr
+#include <string>      // 用于Second中的字符串
+#include <utility>     // 用于std::move
+
+static std::atomic<int> thirdCopies(0), thirdMoves(0);    // Third的拷贝和移动次数
+static std::atomic<int> secondCopies(0), secondMoves(0);  // Second的拷贝和移动次数
+
+/**
+ * @brief 参数类型，与example.cpp中的Third相同，但只计数不打印
+ */
+struct Third {
+    Third(int v) : v(v) {}
+    Third(Third && c) : v(c.v) { ++thirdMoves; }
+    Third(const Third & c) : v(c.v) { ++thirdCopies; }
+
+    int v;
+};
+
+/**
+ * @brief 函数对象，与example.cpp中的Second相同，但只计数不打印
+ */
+struct Second {
+    Second(const std::string & s) : s(s) {}
+    Second(Second && c) : s(std::move(c.s)) { ++secondMoves; }
+    Second(const Second & c) : s(c.s) { ++secondCopies; }
+
+    int operator()(int) const { return static_cast<int>(this->s.size()); }
+
+    std::string s;
+};
+
+static int by_value(int, Third t) { return t.v; }
+static int by_ref(int, const Third & t) { return t.v; }
+
+/**
+ * @brief 清零计数器
+ */
+static void reset() {
+    thirdCopies = thirdMoves = secondCopies = secondMoves = 0;
+}
+
+/**
+ * @brief 检查并输出一种提交方式的计数
+ */
+static void expect(const char * what, int tc, int tm, int sc, int sm) {
+    std::printf("%-28s Third copy %d move %d, Second copy %d move %d\n", what,
+                thirdCopies.load(), thirdMoves.load(), secondCopies.load(), secondMoves.load());
+    CHECK(thirdCopies == tc && thirdMoves == tm);
+    CHECK(secondCopies == sc && secondMoves == sm);
+    reset();
+}
+
+int main() {
+    ctpl::thread_pool p(2);
+
+    // 1. 左值参数：构造节点时拷贝一次，调用时移动给按值接收的函数
+    {
+        Third t(1);
+        reset();
+        CHECK(p.push(by_value, t).get() == 1);
+        expect("lvalue arg, by value", 1, 1, 0, 0);
+        CHECK(p.push(by_ref, t).get() == 1);
+        expect("lvalue arg, by const ref", 1, 0, 0, 0);
+    }
+
+    // 2. 右值参数：只移动，不拷贝
+    {
+        reset();
+        CHECK(p.push(by_value, Third(2)).get() == 2);
+        expect("rvalue arg, by value", 0, 2, 0, 0);
+        CHECK(p.push(by_ref, Third(3)).get() == 3);
+        expect("rvalue arg, by const ref", 0, 1, 0, 0);
+    }
+
+    // 3. 函数对象：左值拷贝一次，右值移动一次，std::ref不拷贝
+    {
+        Second second("functor");
+        reset();
+        CHECK(p.push(second).get() == 7);
+        expect("functor lvalue", 0, 0, 1, 0);
+        CHECK(p.push(const_cast<const Second &>(second)).get() == 7);
+        expect("functor const lvalue", 0, 0, 1, 0);
+        CHECK(p.push(std::ref(second)).get() == 7);
+        expect("functor std::ref", 0, 0, 0, 0);
+        CHECK(p.push(std::move(second)).get() == 7);
+        expect("functor rvalue", 0, 0, 0, 1);
+        CHECK(p.push(Second("temp")).get() == 4);
+        expect("functor temporary", 0, 0, 0, 1);
+    }
+
+    // 4. lambda：捕获的对象随lambda拷贝或移动一次
+    {
+        Third t(5);
+        auto f = [t](int) { return t.v; };
+        reset();
+        CHECK(p.push(f).get() == 5);
+        expect("lambda lvalue", 1, 0, 0, 0);
+        CHECK(p.push(std::move(f)).get() == 5);
+        expect("lambda rvalue", 0, 1, 0, 0);
+    }
+
+    // 5. 只能移动的参数
+    {
+        std::unique_ptr<Third> u(new Third(6));
+        reset();
+        CHECK(p.push([](int, std::unique_ptr<Third> x) { return x->v; }, std::move(u)).get() == 6);
+        expect("unique_ptr arg", 0, 0, 0, 0);
+    }
+
+    std::printf("test_push passed\n");
+    return 0;
+}
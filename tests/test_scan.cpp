@@ -0,0 +1,84 @@
+/*********************************************************
+* ctpl_algorithm.h的测试：前缀扫描的结果与线程数无关
+*
+* 浮点加法不满足结合律，只有各线程数下使用相同的分块方式，结果才会逐位相同：
+*      g++ -std=c++11 -O2 -I. tests/test_scan.cpp -o test_scan -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include <ctpl_algorithm.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <cstdio>      // 用于输出结果
+#include <cstring>     // 用于memcmp
+#include <functional>  // 用于std::multiplies
+#include <vector>      // 用于输入和输出
+
+/**
+ * @brief 用nThreads个线程的线程池做一次包含当前元素的浮点扫描
+ */
+static std::vector<float> inclusive_with(int nThreads, const std::vector<float> & in) {
+    ctpl::thread_pool pool(nThreads);
+    std::vector<float> out(in.size());
+    ctpl::parallel_inclusive_scan(pool, in.begin(), in.end(), out.begin());
+    return out;
+}
+
+/**
+ * @brief 用nThreads个线程的线程池做一次不包含当前元素的浮点扫描
+ */
+static std::vector<float> exclusive_with(int nThreads, const std::vector<float> & in) {
+    ctpl::thread_pool pool(nThreads);
+    std::vector<float> out(in.size());
+    ctpl::parallel_exclusive_scan(pool, in.begin(), in.end(), out.begin(), 0.5f);
+    return out;
+}
+
+int main() {
+    const int n = 1 << 20;
+    std::vector<float> in(n);
+    for (int i = 0; i < n; ++i)
+        in[i] = 1.0f + static_cast<float>(i % 7) * 0.1f / 3.0f;  // 多数值不能精确表示，舍入顺序会影响结果
+
+    // 1. 浮点扫描在1、2、4个线程下逐位相同
+    std::vector<float> inc1 = inclusive_with(1, in);
+    std::vector<float> exc1 = exclusive_with(1, in);
+    const int sizes[] = { 2, 3, 4 };
+    for (int k : sizes) {
+        std::vector<float> inc = inclusive_with(k, in);
+        std::vector<float> exc = exclusive_with(k, in);
+        CHECK(std::memcmp(inc.data(), inc1.data(), n * sizeof(float)) == 0);
+        CHECK(std::memcmp(exc.data(), exc1.data(), n * sizeof(float)) == 0);
+    }
+    std::printf("inclusive scan total: %.3f, exclusive scan last: %.3f\n", inc1.back(), exc1.back());
+
+    // 2. 非交换但满足结合律的运算：整数取模的乘法按顺序组合
+    {
+        ctpl::thread_pool pool(1);
+        std::vector<unsigned> v(n), out(n), ref(n);
+        for (int i = 0; i < n; ++i)
+            v[i] = static_cast<unsigned>(i) * 2654435761u | 1u;
+        ctpl::parallel_inclusive_scan(pool, v.begin(), v.end(), out.begin(), std::multiplies<unsigned>());
+        unsigned acc = 1;
+        for (int i = 0; i < n; ++i)
+            ref[i] = acc *= v[i];
+        CHECK(out == ref);
+    }
+
+    // 3. 原地扫描与单线程时的排序
+    {
+        ctpl::thread_pool pool(1);
+        std::vector<int> v(n, 1);
+        ctpl::parallel_exclusive_scan(pool, v.begin(), v.end(), v.begin(), 0);
+        for (int i = 0; i < n; ++i)
+            CHECK(v[i] == i);
+        std::vector<double> d(n);
+        for (int i = 0; i < n; ++i)
+            d[i] = static_cast<double>((static_cast<long long>(i) * 7919) % n);
+        ctpl::parallel_sort(pool, d.begin(), d.end());
+        for (int i = 1; i < n; ++i)
+            CHECK(d[i - 1] <= d[i]);
+    }
+
+    std::printf("test_scan passed\n");
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*********************************************************
+* ctpl_shard.h的测试：结果和异常、分片上的wait()、环形缓冲区溢出，以及析构时等待所有任务
+*
+* 分片上的任务用wait(f)等待提交到其他分片（包括本分片）的任务；
+* 小环形缓冲区迫使分片之间的消息溢出到MPSC队列；不保存future的扇出任务在析构函数返回前全部执行完：
+*      g++ -std=c++11 -O2 -I. tests/test_shard.cpp -o test_shard -pthread
+*********************************************************/
+
+#include <ctpl_shard.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于计数
+#include <cstdio>      // 用于输出结果
+#include <stdexcept>   // 用于std::runtime_error
+#include <thread>      // 用于yield
+#include <vector>      // 用于保存future
+
+/**
+ * @brief 从分片上向其他分片提交任务并用wait()等待
+ */
+static void round_trips(ctpl::sharded_pool & sp, int perShard) {
+    const int n = sp.size();
+    std::vector<ctpl::future<long long>> fs;
+    for (int i = 0; i < n; ++i) {
+        fs.push_back(sp.submit_to(i, [&sp, perShard](int self) {
+            CHECK(sp.current_shard() == self);
+            long long sum = 0;
+            for (int k = 0; k < perShard; ++k) {
+                int target = (self + k) % sp.size();  // k == 0时提交到本分片
+                ctpl::future<int> g = sp.submit_to(target, [&sp](int shard, int x) {
+                    CHECK(sp.current_shard() == shard);
+                    return x + shard;
+                }, k);
+                sp.wait(g);  // 等待期间继续处理本分片的消息
+                CHECK(g.is_ready());
+                sum += g.get() - target;
+            }
+            return sum;
+        }));
+    }
+    for (ctpl::future<long long> & f : fs)
+        CHECK(f.get() == static_cast<long long>(perShard) * (perShard - 1) / 2);
+}
+
+/**
+ * @brief 扇出：每个任务向其他分片提交下一层任务，不保存future
+ */
+static void fan_out(ctpl::sharded_pool & sp, std::atomic<long> & count, int depth) {
+    sp.submit_to(depth % sp.size(), [&sp, &count, depth](int) {
+        ++count;
+        if (depth > 0) {
+            fan_out(sp, count, depth - 1);
+            fan_out(sp, count, depth - 1);
+        }
+    });
+}
+
+int main() {
+    {
+        ctpl::sharded_pool sp(4, false);
+        CHECK(sp.size() == 4);
+        CHECK(sp.current_shard() == -1);
+        for (int i = 0; i < sp.size(); ++i)
+            CHECK(sp.submit_to(i, [](int shard, int x) { return shard * 100 + x; }, 7).get() == i * 100 + 7);
+
+        // 异常通过future传给等待者
+        ctpl::future<int> bad = sp.submit_to(2, [](int) -> int { throw std::runtime_error("shard"); });
+        bool caught = false;
+        try {
+            bad.get();
+        }
+        catch (const std::runtime_error &) {
+            caught = true;
+        }
+        CHECK(caught);
+
+        // 非分片线程上的wait()等同于future::wait()
+        ctpl::future<int> f = sp.submit_to(1, [](int shard) { return shard; });
+        sp.wait(f);
+        CHECK(f.get() == 1);
+
+        round_trips(sp, 2000);
+    }
+    {
+        // 每个环形缓冲区只有2个槽：分片之间的消息大多溢出到MPSC队列
+        ctpl::sharded_pool sp(3, false, 2);
+        round_trips(sp, 500);
+        std::atomic<long> burst(0);
+        sp.submit_to(0, [&sp, &burst](int) {
+            for (int k = 0; k < 10000; ++k)
+                sp.submit_to(1 + k % 2, [&burst](int) { ++burst; });
+        }).get();
+        while (burst.load() != 10000)
+            std::this_thread::yield();  // 溢出的消息也都被执行
+    }
+    {
+        // 析构函数等待任务中继续提交的任务全部执行完
+        std::atomic<long> count(0);
+        const int depth = 14;
+        {
+            ctpl::sharded_pool sp(4, false, 16);
+            fan_out(sp, count, depth);
+        }
+        CHECK(count.load() == (1L << (depth + 1)) - 1);
+    }
+    {
+        // 绑定CPU：分片数多于可用的CPU时循环使用；默认分片数为硬件线程数
+        ctpl::sharded_pool sp(8);
+        round_trips(sp, 100);
+        ctpl::sharded_pool byCores;
+        CHECK(byCores.size() >= 1);
+        CHECK(byCores.submit_to(byCores.size() - 1, [](int shard) { return shard; }).get() == byCores.size() - 1);
+    }
+    std::printf("test_shard passed\n");
+    return 0;
+}
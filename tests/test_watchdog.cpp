@@ -0,0 +1,119 @@
+/*********************************************************
+* ctpl_watchdog.h的测试：只报告超过阈值的任务，捕获调用栈不影响程序自己的信号处理函数
+*
+* 执行时间略低于阈值的任务不被报告。
+* 程序先为_ctplWatchdogSignal_安装自己的处理函数，看门狗捕获调用栈之后它仍然收到不是看门狗发出的信号；
+* 看门狗已经放弃的请求由迟到的处理函数转交给程序，不会写进下一个请求（仅Linux和glibc）：
+*      g++ -std=c++11 -O2 -I. tests/test_watchdog.cpp -o test_watchdog -pthread
+*********************************************************/
+
+#include <ctpl_stl.h>
+#include "check.h"     // 用于CHECK，不受NDEBUG影响
+#include <atomic>      // 用于计数和线程之间的标志
+#include <chrono>      // 用于阈值和等待
+#include <cstdio>      // 用于输出结果
+#include <mutex>       // 用于保护报告
+#include <string>      // 用于栈帧
+#include <thread>      // 用于阻塞信号的线程
+#include <vector>      // 用于调用栈
+
+#if defined(__linux__) && defined(__GLIBC__)
+#include <csignal>     // 用于sigaction和pthread_sigmask
+#include <pthread.h>   // 用于pthread_sigmask
+#include <sys/syscall.h>  // 用于SYS_tgkill
+#include <unistd.h>    // 用于syscall和getpid
+
+static std::atomic<int> appSignals(0);  // 程序自己的处理函数收到的信号数
+
+static void on_app_signal(int) {
+    appSignals.fetch_add(1, std::memory_order_relaxed);
+}
+
+int main() {
+    struct sigaction sa;
+    sa.sa_handler = &on_app_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(_ctplWatchdogSignal_, &sa, nullptr);
+
+    // 执行时间略低于阈值的任务不报告，超过阈值的任务报告一次，elapsed不小于阈值
+    {
+        ctpl::thread_pool pool(1);
+        std::mutex m;
+        std::vector<std::chrono::milliseconds> reports;
+        pool.set_watchdog(std::chrono::milliseconds(100), [&m, &reports](const ctpl::stuck_task & t) {
+            std::unique_lock<std::mutex> lock(m);
+            reports.push_back(t.elapsed);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        for (int i = 0; i < 10; ++i)  // 开始时间相对检查间隔的相位各不相同
+            pool.push([](int) { std::this_thread::sleep_for(std::chrono::milliseconds(80)); }).get();
+        {
+            std::unique_lock<std::mutex> lock(m);
+            CHECK(reports.empty());
+        }
+        pool.push([](int) { std::this_thread::sleep_for(std::chrono::milliseconds(300)); }).get();
+        pool.set_watchdog(std::chrono::milliseconds(0), nullptr);
+        std::unique_lock<std::mutex> lock(m);
+        CHECK(reports.size() == 1);
+        CHECK(reports[0] >= std::chrono::milliseconds(100));
+    }
+
+    // 看门狗报告卡住的任务并附上调用栈
+    {
+        ctpl::thread_pool pool(2);
+        std::mutex m;
+        std::vector<std::string> stack;
+        pool.set_watchdog(std::chrono::milliseconds(40), [&m, &stack](const ctpl::stuck_task & t) {
+            std::unique_lock<std::mutex> lock(m);
+            stack = t.stack;
+        }, true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));  // 看门狗推进第一个时间之前开始的任务不被检查
+        pool.push([](int) { std::this_thread::sleep_for(std::chrono::milliseconds(400)); }).get();
+        pool.set_watchdog(std::chrono::milliseconds(0), nullptr);
+        std::unique_lock<std::mutex> lock(m);
+        CHECK(!stack.empty());
+        CHECK(appSignals == 0);
+
+        // 工作线程和其他线程收到的信号转交给程序
+        pool.push([](int) { raise(_ctplWatchdogSignal_); }).get();
+        raise(_ctplWatchdogSignal_);
+        CHECK(appSignals == 2);
+    }
+
+    // 目标线程阻塞信号，请求超时；之后迟到的处理函数不认领已撤销的请求，信号转交给程序
+    {
+        std::atomic<int> tid(0);
+        std::atomic<bool> unblock(false);
+        std::thread t([&tid, &unblock]() {
+            sigset_t set;
+            sigemptyset(&set);
+            sigaddset(&set, _ctplWatchdogSignal_);
+            pthread_sigmask(SIG_BLOCK, &set, nullptr);
+            tid = ctpl::detail::current_tid();
+            while (!unblock)
+                std::this_thread::yield();
+            pthread_sigmask(SIG_UNBLOCK, &set, nullptr);  // 挂起的信号在这里递送
+        });
+        while (!tid)
+            std::this_thread::yield();
+        std::vector<std::string> late = ctpl::detail::capture_stack(tid, std::chrono::milliseconds(50));
+        CHECK(late.empty());
+        unblock = true;
+        t.join();
+        CHECK(appSignals == 3);
+        CHECK(!ctpl::detail::stack_slot().done.load());
+
+        std::vector<std::string> own = ctpl::detail::capture_stack(ctpl::detail::current_tid(), std::chrono::milliseconds(500));
+        CHECK(!own.empty());
+        CHECK(appSignals == 3);
+    }
+    std::printf("test_watchdog passed\n");
+    return 0;
+}
+#else
+int main() {
+    std::printf("test_watchdog skipped: stack capture needs Linux and glibc\n");
+    return 0;
+}
+#endif